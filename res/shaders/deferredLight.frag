@@ -0,0 +1,135 @@
+#version 430 core
+
+in layout(location = 0) vec2 screenCoordinates;
+
+layout(binding = 0) uniform sampler2D gAlbedo;
+layout(binding = 1) uniform sampler2D gNormalSpecular;
+layout(binding = 2) uniform sampler2D gDepth;
+layout(binding = 3) uniform samplerCubeArray shadowMaps;
+
+out vec4 color;
+
+uniform mat4 inverseVP;
+uniform vec3 cameraPos;
+
+// The ambient pass runs once before the lights, which are then added on top one at a time
+uniform bool ambientPass;
+uniform int lightIndex;
+uniform vec3 lightPosition;
+uniform vec3 lightColor;
+
+uniform float ballRadius;
+uniform vec3 ballPos;
+uniform bool useShadowMaps;
+uniform float shadowFarPlane;
+
+float rand(vec2 co)
+{
+    return fract(sin(dot(co.xy, vec2(12.9898, 78.233))) * 43758.5453);
+}
+float dither(vec2 uv)
+{
+    return (rand(uv) * 2.0 - 1.0) / 256.0;
+}
+vec3 reject(vec3 from, vec3 onto)
+{
+    return from - onto * dot(from, onto) / dot(onto, onto);
+}
+
+vec2 signNotZero(vec2 v)
+{
+    return vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+vec3 decodeNormal(vec2 e)
+{
+    vec3 n = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0)
+    {
+        n.xy = (1.0 - abs(n.yx)) * signNotZero(n.xy);
+    }
+    return normalize(n);
+}
+
+// Same filter as in simple.frag
+float shadowMapFactor(int light, vec3 fromLight)
+{
+    float fragmentDistance = length(fromLight);
+    float bias = 0.3 + 0.005 * fragmentDistance;
+
+    vec3 side = normalize(cross(fromLight, abs(fromLight.y) < 0.9 * fragmentDistance ? vec3(0, 1, 0) : vec3(1, 0, 0)));
+    vec3 up = cross(normalize(fromLight), side);
+    float filterRadius = 0.004 * fragmentDistance;
+    vec2 taps[4] = vec2[](vec2(-0.7, -0.7), vec2(0.7, -0.7), vec2(-0.7, 0.7), vec2(0.7, 0.7));
+
+    float lit = 0.0;
+    for (int i = 0; i < 4; i++)
+    {
+        vec3 direction = fromLight + (side * taps[i].x + up * taps[i].y) * filterRadius;
+        float closest = texture(shadowMaps, vec4(direction, light)).r * shadowFarPlane;
+        lit += fragmentDistance - bias > closest ? 0.0 : 1.0;
+    }
+    return lit / 4.0;
+}
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    float depth = texelFetch(gDepth, pixel, 0).r;
+    if (depth == 1.0)
+    {
+        // Nothing was drawn here, keep the clear colour
+        discard;
+    }
+
+    vec3 albedo = texelFetch(gAlbedo, pixel, 0).rgb;
+    if (ambientPass)
+    {
+        vec3 ambientColor = vec3(0.1, 0.1, 0.1);
+        color = vec4(ambientColor * albedo + dither(screenCoordinates), 1.0);
+        return;
+    }
+
+    vec3 normalSpecular = texelFetch(gNormalSpecular, pixel, 0).xyz;
+    vec3 normal = decodeNormal(normalSpecular.xy);
+    float specularIntensity = normalSpecular.z;
+
+    vec4 world = inverseVP * vec4(screenCoordinates * 2.0 - 1.0, depth * 2.0 - 1.0, 1.0);
+    vec3 fragPos = world.xyz / world.w;
+
+    float l_a = 1;
+    float l_b = 0.01009;
+    float l_c = 0.00107;
+    float softShadowRadius = 1.0;
+
+    vec3 toLight = lightPosition - fragPos;
+    float lightDist = length(toLight);
+    vec3 lightDir = toLight / lightDist;
+
+    float shadowFactor = 1.0;
+    if (useShadowMaps)
+    {
+        shadowFactor = shadowMapFactor(lightIndex, -toLight);
+    }
+    else
+    {
+        vec3 toBall = ballPos - fragPos;
+        float ballDist = length(toBall);
+        float rejection = length(reject(toBall, toLight));
+        if (lightDist > ballDist && dot(toLight, toBall) > 0.0 && rejection < ballRadius + softShadowRadius)
+        {
+            shadowFactor = (rejection < ballRadius) ? 0.0 : mix(0.0, 1.0, (rejection - ballRadius) / softShadowRadius);
+        }
+    }
+
+    float diff = max(dot(normal, lightDir), 0.0);
+    vec3 diffuse = diff * lightColor;
+
+    vec3 reflection = reflect(-lightDir, normal);
+    vec3 viewDir = normalize(cameraPos - fragPos);
+    float spec = pow(max(dot(viewDir, reflection), 0.0), 32);
+    vec3 specular = specularIntensity * spec * lightColor;
+
+    float attenuation = 1.0 / (l_a + l_b * lightDist + l_c * lightDist * lightDist);
+
+    color = vec4((diffuse + specular) * attenuation * shadowFactor * albedo, 1.0);
+}
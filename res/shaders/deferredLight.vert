@@ -0,0 +1,10 @@
+#version 430 core
+
+out layout(location = 0) vec2 screenCoordinates;
+
+// A single triangle covering the whole screen, without any vertex buffer
+void main()
+{
+    screenCoordinates = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    gl_Position = vec4(screenCoordinates * 2.0 - 1.0, 0.0, 1.0);
+}
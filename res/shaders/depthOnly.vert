@@ -0,0 +1,15 @@
+#version 430 core
+
+in layout(location = 0) vec3 position;
+
+// Must give exactly the same depth as simple.vert
+invariant gl_Position;
+
+uniform mat4 M;
+uniform mat4 VP;
+
+void main()
+{
+    vec4 modelPos = M * vec4(position, 1.0f);
+    gl_Position = VP * modelPos;
+}
@@ -0,0 +1,53 @@
+#version 430 core
+
+in layout(location = 0) vec2 screenCoordinates;
+
+// The scene fills the bottom left renderedSize pixels of the texture
+layout(binding = 0) uniform sampler2D scene;
+uniform vec2 renderedSize;
+
+out vec4 color;
+
+// Edges with less contrast than this are left alone
+const float reduceMinimum = 1.0 / 128.0;
+const float reduceMultiplier = 1.0 / 8.0;
+// Longest blur along an edge, in pixels
+const float spanMaximum = 8.0;
+
+float luma(vec3 rgb)
+{
+    return dot(rgb, vec3(0.299, 0.587, 0.114));
+}
+
+void main()
+{
+    vec2 texelSize = 1.0 / vec2(textureSize(scene, 0));
+    vec2 lowest = 0.5 * texelSize;
+    vec2 highest = (renderedSize - 0.5) * texelSize;
+    // The pass is drawn with the scene's viewport, so the fragment lines up with its pixel
+    vec2 uv = gl_FragCoord.xy * texelSize;
+
+    vec3 center = texture(scene, uv).rgb;
+    float lumaCenter = luma(center);
+    float lumaNW = luma(texture(scene, clamp(uv + vec2(-1.0, -1.0) * texelSize, lowest, highest)).rgb);
+    float lumaNE = luma(texture(scene, clamp(uv + vec2(1.0, -1.0) * texelSize, lowest, highest)).rgb);
+    float lumaSW = luma(texture(scene, clamp(uv + vec2(-1.0, 1.0) * texelSize, lowest, highest)).rgb);
+    float lumaSE = luma(texture(scene, clamp(uv + vec2(1.0, 1.0) * texelSize, lowest, highest)).rgb);
+    float lumaMinimum = min(lumaCenter, min(min(lumaNW, lumaNE), min(lumaSW, lumaSE)));
+    float lumaMaximum = max(lumaCenter, max(max(lumaNW, lumaNE), max(lumaSW, lumaSE)));
+
+    // Points along the edge, across the steepest change in brightness
+    vec2 direction = vec2(-((lumaNW + lumaNE) - (lumaSW + lumaSE)), (lumaNW + lumaSW) - (lumaNE + lumaSE));
+    float directionReduce = max((lumaNW + lumaNE + lumaSW + lumaSE) * 0.25 * reduceMultiplier, reduceMinimum);
+    float inverseSmallest = 1.0 / (min(abs(direction.x), abs(direction.y)) + directionReduce);
+    direction = clamp(direction * inverseSmallest, -spanMaximum, spanMaximum) * texelSize;
+
+    // Two blurs along the edge, a short one and a longer one. The longer one is used unless it reaches past the edge,
+    // which shows as a brightness outside the local range.
+    vec3 near = 0.5 * (texture(scene, clamp(uv + direction * (1.0 / 3.0 - 0.5), lowest, highest)).rgb +
+                       texture(scene, clamp(uv + direction * (2.0 / 3.0 - 0.5), lowest, highest)).rgb);
+    vec3 far = 0.5 * near + 0.25 * (texture(scene, clamp(uv - direction * 0.5, lowest, highest)).rgb +
+                                    texture(scene, clamp(uv + direction * 0.5, lowest, highest)).rgb);
+    float lumaFar = luma(far);
+    color = vec4(lumaFar < lumaMinimum || lumaFar > lumaMaximum ? near : far, 1.0);
+}
@@ -0,0 +1,43 @@
+#version 430 core
+
+in layout(location = 0) vec3 normal_in;
+in layout(location = 1) vec2 textureCoordinates;
+in layout(location = 2) vec3 fragPos;
+in layout(location = 3) mat3 TBN;
+
+layout(binding = 0) uniform sampler2D sampler;
+layout(binding = 1) uniform sampler2D normalMap;
+layout(binding = 2) uniform sampler2D roughnessMap;
+
+uniform bool useNM;
+
+out layout(location = 0) vec4 albedo;
+out layout(location = 1) vec3 normalSpecular;
+
+// Octahedral normal encoding, see "A Survey of Efficient Representations for Independent Unit Vectors"
+vec2 signNotZero(vec2 v)
+{
+    return vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+vec2 encodeNormal(vec3 n)
+{
+    vec2 p = n.xy / (abs(n.x) + abs(n.y) + abs(n.z));
+    return n.z <= 0.0 ? (1.0 - abs(p.yx)) * signNotZero(p) : p;
+}
+
+void main()
+{
+    vec3 normal = normalize(normal_in);
+    float specularIntensity = 0.3;
+    albedo = vec4(1.0);
+
+    if (useNM)
+    {
+        normal = normalize(TBN * (texture(normalMap, textureCoordinates).xyz * 2.0 - 1.0));
+        float roughness = length(texture(roughnessMap, textureCoordinates));
+        specularIntensity = 5.0 / (roughness * roughness);
+        albedo = vec4(texture(sampler, textureCoordinates).xyz, 1.0);
+    }
+
+    normalSpecular = vec3(encodeNormal(normal), specularIntensity);
+}
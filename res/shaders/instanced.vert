@@ -0,0 +1,37 @@
+#version 430 core
+
+in layout(location = 0) vec3 position;
+in layout(location = 1) vec3 normal_in;
+in layout(location = 2) vec2 textureCoordinates_in;
+in layout(location = 3) vec3 tangent_in;
+in layout(location = 4) vec3 bitangent_in;
+
+out layout(location = 0) vec3 normal_out;
+out layout(location = 1) vec2 textureCoordinates_out;
+out layout(location = 2) vec3 fragPos_out;
+out layout(location = 3) mat3 TBN;
+
+invariant gl_Position;
+
+// Center and radius of every instance, written by BallSimulation::writeInstances()
+layout(std430, binding = 0) readonly buffer BallInstances
+{
+    vec4 balls[];
+};
+
+uniform mat4 VP;
+
+void main()
+{
+    vec4 ball = balls[gl_InstanceID];
+
+    // Instances are only translated and uniformly scaled, so the normals stay as they are
+    normal_out = normalize(normal_in);
+    textureCoordinates_out = textureCoordinates_in;
+    TBN = mat3(normalize(tangent_in), normalize(bitangent_in), normal_out);
+
+    vec4 modelPos = vec4(ball.xyz + position * ball.w, 1.0f);
+    fragPos_out = vec3(modelPos);
+
+    gl_Position = VP * modelPos;
+}
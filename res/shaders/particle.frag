@@ -0,0 +1,22 @@
+#version 430 core
+
+in layout(location = 0) vec2 corner;
+in layout(location = 1) vec4 color_in;
+
+// Depth of the scene when it is not in the bound depth buffer, e.g. in the G-buffer of the deferred path
+layout(binding = 0) uniform sampler2D sceneDepth;
+uniform bool useSceneDepth;
+
+out vec4 color;
+
+void main()
+{
+    if (useSceneDepth && gl_FragCoord.z > texelFetch(sceneDepth, ivec2(gl_FragCoord.xy), 0).r)
+    {
+        discard;
+    }
+
+    // Round, with a soft edge
+    float falloff = 1.0 - smoothstep(0.0, 1.0, dot(corner, corner));
+    color = vec4(color_in.rgb, color_in.a * falloff);
+}
@@ -0,0 +1,32 @@
+#version 430 core
+
+struct Particle
+{
+    vec4 positionSize;
+    vec4 color;
+};
+
+// Written by ParticleSystem::writeInstances()
+layout(std430, binding = 0) readonly buffer Particles
+{
+    Particle particles[];
+};
+
+uniform mat4 VP;
+uniform vec3 cameraRight;
+uniform vec3 cameraUp;
+
+out layout(location = 0) vec2 corner;
+out layout(location = 1) vec4 color_out;
+
+void main()
+{
+    // Corners of a quad as a triangle strip, from -1 to 1
+    corner = vec2(gl_VertexID & 1, gl_VertexID >> 1) * 2.0 - 1.0;
+
+    Particle particle = particles[gl_InstanceID];
+    color_out = particle.color;
+
+    vec3 offset = (cameraRight * corner.x + cameraUp * corner.y) * particle.positionSize.w;
+    gl_Position = VP * vec4(particle.positionSize.xyz + offset, 1.0);
+}
@@ -0,0 +1,12 @@
+#version 430 core
+
+in vec3 fragPos;
+
+uniform vec3 lightPos;
+uniform float farPlane;
+
+void main()
+{
+    // Linear distance, so the map can be compared against without knowing which face it came from
+    gl_FragDepth = length(fragPos - lightPos) / farPlane;
+}
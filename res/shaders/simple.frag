@@ -10,6 +10,7 @@ in layout(location = 3) mat3 TBN;
 layout(binding = 0) uniform sampler2D sampler;
 layout(binding = 1) uniform sampler2D normalMap;
 layout(binding = 2) uniform sampler2D roughnessMap;
+layout(binding = 3) uniform samplerCubeArray shadowMaps;
 
 out vec4 color;
 
@@ -39,9 +40,34 @@ uniform vec3 cameraPos;
 uniform float ballRadius;
 uniform vec3 ballPos;
 
+// When false, only the ball casts a shadow, computed analytically
+uniform bool useShadowMaps;
+uniform float shadowFarPlane;
+
 uniform bool is2D;
 uniform bool useNM;
 
+// Fraction of the light reaching the fragment, filtered over a few taps around the direction to the light
+float shadowMapFactor(int light, vec3 fromLight)
+{
+    float fragmentDistance = length(fromLight);
+    float bias = 0.3 + 0.005 * fragmentDistance;
+
+    vec3 side = normalize(cross(fromLight, abs(fromLight.y) < 0.9 * fragmentDistance ? vec3(0, 1, 0) : vec3(1, 0, 0)));
+    vec3 up = cross(normalize(fromLight), side);
+    float filterRadius = 0.004 * fragmentDistance;
+    vec2 taps[4] = vec2[](vec2(-0.7, -0.7), vec2(0.7, -0.7), vec2(-0.7, 0.7), vec2(0.7, 0.7));
+
+    float lit = 0.0;
+    for (int i = 0; i < 4; i++)
+    {
+        vec3 direction = fromLight + (side * taps[i].x + up * taps[i].y) * filterRadius;
+        float closest = texture(shadowMaps, vec4(direction, light)).r * shadowFarPlane;
+        lit += fragmentDistance - bias > closest ? 0.0 : 1.0;
+    }
+    return lit / 4.0;
+}
+
 void main()
 {
     if (is2D)
@@ -87,10 +113,18 @@ void main()
 
         float shadowFactor = 1.0;
 
-        float rejection = length(reject(toBall, toLight));
-        if (lightDist > ballDist && dot(toLight, toBall) > 0.0 && rejection < ballRadius + softShadowRadius)
+        if (useShadowMaps)
+        {
+            shadowFactor = shadowMapFactor(i, -toLight);
+        }
+        else
         {
-            shadowFactor = (rejection < ballRadius) ? 0.0 : mix(0.0, 1.0, (rejection - ballRadius) / softShadowRadius);
+            float rejection = length(reject(toBall, toLight));
+            if (lightDist > ballDist && dot(toLight, toBall) > 0.0 && rejection < ballRadius + softShadowRadius)
+            {
+                shadowFactor =
+                    (rejection < ballRadius) ? 0.0 : mix(0.0, 1.0, (rejection - ballRadius) / softShadowRadius);
+            }
         }
 
         float diff = max(dot(normal, lightDir), 0.0);
@@ -11,6 +11,9 @@ out layout(location = 1) vec2 textureCoordinates_out;
 out layout(location = 2) vec3 fragPos_out;
 out layout(location = 3) mat3 TBN;
 
+// Must give exactly the same depth as depthOnly.vert, for the depth pre-pass
+invariant gl_Position;
+
 uniform mat4 M;
 uniform mat4 VP;
 uniform mat3 N;
@@ -0,0 +1,55 @@
+#version 430 core
+
+in layout(location = 0) vec2 screenCoordinates;
+
+// The current frame and its depth fill the bottom left renderedSize pixels of their textures, and the history the
+// bottom left historySize pixels of its texture
+layout(binding = 0) uniform sampler2D current;
+layout(binding = 1) uniform sampler2D history;
+layout(binding = 2) uniform sampler2D depth;
+uniform vec2 renderedSize;
+uniform vec2 historySize;
+
+// From the current clip space to the previous frame's, without jitter
+uniform mat4 reprojection;
+uniform bool historyValid;
+uniform float currentFrameWeight;
+
+out vec4 color;
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    ivec2 lastPixel = ivec2(renderedSize) - 1;
+    vec3 currentColor = texelFetch(current, pixel, 0).rgb;
+
+    // The history is only trusted as far as it stays within the colours around the pixel in the current frame.
+    // That rejects what the reprojection can not follow, like the ball moving on its own or newly uncovered pixels.
+    vec3 minimum = currentColor;
+    vec3 maximum = currentColor;
+    for (int y = -1; y <= 1; y++)
+    {
+        for (int x = -1; x <= 1; x++)
+        {
+            vec3 neighbour = texelFetch(current, clamp(pixel + ivec2(x, y), ivec2(0), lastPixel), 0).rgb;
+            minimum = min(minimum, neighbour);
+            maximum = max(maximum, neighbour);
+        }
+    }
+
+    vec4 previousClip = reprojection * vec4(screenCoordinates * 2.0 - 1.0, texelFetch(depth, pixel, 0).r * 2.0 - 1.0,
+                                            1.0);
+    vec2 previousCoordinates = previousClip.xy / previousClip.w * 0.5 + 0.5;
+    if (!historyValid || previousClip.w <= 0.0 || any(lessThan(previousCoordinates, vec2(0.0))) ||
+        any(greaterThan(previousCoordinates, vec2(1.0))))
+    {
+        color = vec4(currentColor, 1.0);
+        return;
+    }
+
+    vec2 historyTexelSize = 1.0 / vec2(textureSize(history, 0));
+    vec2 historyCoordinates = clamp(previousCoordinates * historySize * historyTexelSize, 0.5 * historyTexelSize,
+                                    (historySize - 0.5) * historyTexelSize);
+    vec3 historyColor = clamp(texture(history, historyCoordinates).rgb, minimum, maximum);
+    color = vec4(mix(historyColor, currentColor, currentFrameWeight), 1.0);
+}
@@ -0,0 +1,19 @@
+#version 430 core
+
+in layout(location = 0) vec2 textureCoordinates;
+in layout(location = 1) vec4 textColor;
+
+layout(binding = 0) uniform sampler2D distanceField;
+
+out vec4 color;
+
+void main()
+{
+    // The glyph edge is at 0.5. Smoothing over the screen space rate of change keeps the edge about one pixel wide at
+    // every text size.
+    float distance = texture(distanceField, textureCoordinates).r;
+    float smoothing = max(fwidth(distance), 1e-4);
+    float alpha = smoothstep(0.5 - smoothing, 0.5 + smoothing, distance);
+
+    color = vec4(textColor.rgb, textColor.a * alpha);
+}
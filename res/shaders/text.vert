@@ -0,0 +1,17 @@
+#version 430 core
+
+in layout(location = 0) vec2 position;
+in layout(location = 1) vec2 textureCoordinates_in;
+in layout(location = 2) vec4 color_in;
+
+out layout(location = 0) vec2 textureCoordinates_out;
+out layout(location = 1) vec4 color_out;
+
+uniform mat4 projection;
+
+void main()
+{
+    textureCoordinates_out = textureCoordinates_in;
+    color_out = color_in;
+    gl_Position = projection * vec4(position, 0.0, 1.0);
+}
@@ -0,0 +1,33 @@
+#version 430 core
+
+in layout(location = 0) vec2 screenCoordinates;
+
+// The scene fills the bottom left renderedSize pixels of the texture
+layout(binding = 0) uniform sampler2D scene;
+uniform vec2 renderedSize;
+// 0 for a plain bilinear upscale
+uniform float sharpness;
+
+out vec4 color;
+
+void main()
+{
+    vec2 texelSize = 1.0 / vec2(textureSize(scene, 0));
+    // Filtering must not blend in anything outside the rendered part
+    vec2 lowest = 0.5 * texelSize;
+    vec2 highest = (renderedSize - 0.5) * texelSize;
+    vec2 uv = clamp(screenCoordinates * renderedSize * texelSize, lowest, highest);
+
+    vec3 center = texture(scene, uv).rgb;
+    vec3 left = texture(scene, clamp(uv - vec2(texelSize.x, 0.0), lowest, highest)).rgb;
+    vec3 right = texture(scene, clamp(uv + vec2(texelSize.x, 0.0), lowest, highest)).rgb;
+    vec3 down = texture(scene, clamp(uv - vec2(0.0, texelSize.y), lowest, highest)).rgb;
+    vec3 up = texture(scene, clamp(uv + vec2(0.0, texelSize.y), lowest, highest)).rgb;
+
+    // Unsharp mask with the neighbours one rendered pixel away, which restores the edges the upscale blurred. Staying
+    // within the range of the neighbourhood keeps it from ringing around hard edges.
+    vec3 sharpened = center + sharpness * (4.0 * center - left - right - down - up);
+    vec3 minimum = min(center, min(min(left, right), min(down, up)));
+    vec3 maximum = max(center, max(max(left, right), max(down, up)));
+    color = vec4(clamp(sharpened, minimum, maximum), 1.0);
+}
@@ -0,0 +1,190 @@
+#include "antiAliasing.hpp"
+#include <glm/gtc/type_ptr.hpp>
+#include <iostream>
+
+// The jitter repeats after this many frames
+static const int jitterPhases = 8;
+// Weight of the current frame in the temporal blend. Lower is smoother, but takes longer to converge after motion.
+static const float currentFrameWeight = 0.1f;
+
+bool parseAntiAliasingMode(const std::string &name, AntiAliasingMode &mode)
+{
+    for (int i = 0; i < antiAliasingModeCount; i++)
+    {
+        if (name == antiAliasingModeName(AntiAliasingMode(i)))
+        {
+            mode = AntiAliasingMode(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+const char *antiAliasingModeName(AntiAliasingMode mode)
+{
+    switch (mode)
+    {
+    case AntiAliasingMode::Off:
+        return "off";
+    case AntiAliasingMode::Msaa2:
+        return "msaa2";
+    case AntiAliasingMode::Msaa4:
+        return "msaa4";
+    case AntiAliasingMode::Msaa8:
+        return "msaa8";
+    case AntiAliasingMode::Fxaa:
+        return "fxaa";
+    case AntiAliasingMode::Taa:
+        return "taa";
+    }
+    return "";
+}
+
+int antiAliasingSamples(AntiAliasingMode mode)
+{
+    switch (mode)
+    {
+    case AntiAliasingMode::Msaa2:
+        return 2;
+    case AntiAliasingMode::Msaa4:
+        return 4;
+    case AntiAliasingMode::Msaa8:
+        return 8;
+    default:
+        return 1;
+    }
+}
+
+// Low discrepancy sequence in [0, 1), which spreads the jitter evenly over the pixel
+static float halton(int index, int base)
+{
+    float result = 0;
+    float fraction = 1;
+    while (index > 0)
+    {
+        fraction /= base;
+        result += fraction * (index % base);
+        index /= base;
+    }
+    return result;
+}
+
+AntiAliasing::~AntiAliasing()
+{
+    delete fxaaShader;
+    delete taaShader;
+}
+
+void AntiAliasing::init(AntiAliasingMode mode)
+{
+    // Same full screen triangle as the deferred lighting
+    fxaaShader = new Gloom::Shader(GPU_HERE);
+    fxaaShader->makeBasicShader("../res/shaders/deferredLight.vert", "../res/shaders/fxaa.frag");
+    taaShader = new Gloom::Shader(GPU_HERE);
+    taaShader->makeBasicShader("../res/shaders/deferredLight.vert", "../res/shaders/taa.frag");
+
+    emptyVertexArray = GLVertexArray("anti-aliasing", GPU_HERE);
+    setMode(mode);
+}
+
+void AntiAliasing::setMode(AntiAliasingMode newMode)
+{
+    currentMode = newMode;
+    historyValid = false;
+}
+
+glm::vec2 AntiAliasing::projectionJitter(int renderWidth, int renderHeight) const
+{
+    if (currentMode != AntiAliasingMode::Taa || renderWidth <= 0 || renderHeight <= 0)
+    {
+        return glm::vec2(0);
+    }
+    int phase = int(frameIndex % jitterPhases) + 1;
+    glm::vec2 pixelOffset(halton(phase, 2) - 0.5f, halton(phase, 3) - 0.5f);
+    // One pixel is two over the size in normalized device coordinates
+    return 2.0f * pixelOffset / glm::vec2(renderWidth, renderHeight);
+}
+
+void AntiAliasing::resize(int width, int height)
+{
+    allocatedWidth = width;
+    allocatedHeight = height;
+    for (int i = 0; i < 2; i++)
+    {
+        outputs[i] = GLTexture("anti-aliasing output", GPU_HERE);
+        glBindTexture(GL_TEXTURE_2D, outputs[i].id());
+        // Half floats, so the small steps of the temporal blend do not get rounded away
+        glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA16F, width, height);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        outputs[i].setBytes(std::size_t(width) * height * 8);
+
+        outputTargets[i] = GLFramebuffer("anti-aliasing output", GPU_HERE);
+        glNamedFramebufferTexture(outputTargets[i].id(), GL_COLOR_ATTACHMENT0, outputs[i].id(), 0);
+        if (glCheckNamedFramebufferStatus(outputTargets[i].id(), GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        {
+            std::cerr << "The anti-aliasing framebuffer is incomplete" << std::endl;
+        }
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    historyValid = false;
+}
+
+GLuint AntiAliasing::apply(GLuint sceneColor, GLuint sceneDepth, int width, int height, int sceneAllocatedWidth,
+                           int sceneAllocatedHeight, const glm::mat4 &viewProjection)
+{
+    frameIndex++;
+    if (currentMode != AntiAliasingMode::Fxaa && currentMode != AntiAliasingMode::Taa)
+    {
+        return sceneColor;
+    }
+    if (sceneAllocatedWidth != allocatedWidth || sceneAllocatedHeight != allocatedHeight)
+    {
+        resize(sceneAllocatedWidth, sceneAllocatedHeight);
+    }
+
+    int history = currentOutput;
+    currentOutput = 1 - currentOutput;
+    glBindFramebuffer(GL_FRAMEBUFFER, outputTargets[currentOutput].id());
+    glViewport(0, 0, width, height);
+    glDisable(GL_DEPTH_TEST);
+    glBindVertexArray(emptyVertexArray.id());
+    glBindTextureUnit(0, sceneColor);
+    glm::vec2 size(width, height);
+
+    if (currentMode == AntiAliasingMode::Fxaa)
+    {
+        fxaaShader->activate();
+        glUniform2fv(fxaaShader->getUniformFromName("renderedSize"), 1, glm::value_ptr(size));
+    }
+    else
+    {
+        // From the current frame's clip space to the previous frame's, through the world
+        glm::mat4 reprojection = previousViewProjection * glm::inverse(viewProjection);
+
+        taaShader->activate();
+        glBindTextureUnit(1, outputs[history].id());
+        glBindTextureUnit(2, sceneDepth);
+        glUniformMatrix4fv(taaShader->getUniformFromName("reprojection"), 1, GL_FALSE, glm::value_ptr(reprojection));
+        glUniform2fv(taaShader->getUniformFromName("renderedSize"), 1, glm::value_ptr(size));
+        glUniform2fv(taaShader->getUniformFromName("historySize"), 1, glm::value_ptr(previousSize));
+        glUniform1i(taaShader->getUniformFromName("historyValid"), historyValid);
+        glUniform1f(taaShader->getUniformFromName("currentFrameWeight"), currentFrameWeight);
+
+        previousViewProjection = viewProjection;
+        previousSize = size;
+        historyValid = true;
+    }
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+
+    glEnable(GL_DEPTH_TEST);
+    return outputs[currentOutput].id();
+}
+
+void AntiAliasing::recordGpuTime(AntiAliasingMode frameMode, double seconds)
+{
+    stats.gpuSeconds[int(frameMode)] += seconds;
+    stats.frames[int(frameMode)]++;
+}
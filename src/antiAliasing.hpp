@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstdint>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <string>
+#include <utilities/gpuResource.h>
+#include <utilities/shader.hpp>
+
+enum class AntiAliasingMode
+{
+    Off,
+    Msaa2,
+    Msaa4,
+    Msaa8,
+    // Blurs along the edges it finds in the finished image, in one pass
+    Fxaa,
+    // Jitters the projection by a fraction of a pixel every frame, and blends each frame into the reprojected history
+    Taa,
+};
+const int antiAliasingModeCount = 6;
+
+// Accepts "off", "msaa2", "msaa4", "msaa8", "fxaa" and "taa". Returns false for anything else.
+bool parseAntiAliasingMode(const std::string &name, AntiAliasingMode &mode);
+const char *antiAliasingModeName(AntiAliasingMode mode);
+// Samples per pixel of the scene target, 1 for the post processing modes
+int antiAliasingSamples(AntiAliasingMode mode);
+
+// The post processing anti-aliasing passes, which run on the resolved scene before it is scaled up to the window.
+// Their output goes to textures allocated at the same size as the scene target, into the same bottom left corner.
+class AntiAliasing
+{
+  public:
+    struct Statistics
+    {
+        // GPU time of whole frames rendered in each mode, so the modes can be compared
+        double gpuSeconds[antiAliasingModeCount] = {};
+        std::uint64_t frames[antiAliasingModeCount] = {};
+    };
+
+    AntiAliasing() = default;
+    ~AntiAliasing();
+
+    // Needs an OpenGL context
+    void init(AntiAliasingMode mode);
+
+    void setMode(AntiAliasingMode newMode);
+    AntiAliasingMode mode() const
+    {
+        return currentMode;
+    }
+
+    // Offset to add to the x and y of the third column of the projection matrix, which moves the image by a fraction
+    // of a pixel that changes every frame. Zero unless the mode is temporal.
+    glm::vec2 projectionJitter(int renderWidth, int renderHeight) const;
+
+    // Filters the scene in the bottom left width x height pixels of sceneColor, and returns the texture to scale up.
+    // That is sceneColor itself if the mode has no post processing. The temporal mode reprojects its history with
+    // the depth and the view projection without jitter.
+    GLuint apply(GLuint sceneColor, GLuint sceneDepth, int width, int height, int allocatedWidth, int allocatedHeight,
+                 const glm::mat4 &viewProjection);
+
+    void recordGpuTime(AntiAliasingMode frameMode, double seconds);
+    const Statistics &statistics() const
+    {
+        return stats;
+    }
+
+  private:
+    AntiAliasing(AntiAliasing const &) = delete;
+    AntiAliasing &operator=(AntiAliasing const &) = delete;
+
+    void resize(int width, int height);
+
+    AntiAliasingMode currentMode = AntiAliasingMode::Msaa4;
+
+    Gloom::Shader *fxaaShader = nullptr;
+    Gloom::Shader *taaShader = nullptr;
+    GLVertexArray emptyVertexArray;
+
+    // Ping-ponged by the temporal mode, which reads the previous frame from one while writing the other
+    GLTexture outputs[2];
+    GLFramebuffer outputTargets[2];
+    int allocatedWidth = 0;
+    int allocatedHeight = 0;
+    int currentOutput = 0;
+
+    std::uint64_t frameIndex = 0;
+    bool historyValid = false;
+    glm::mat4 previousViewProjection = glm::mat4(1);
+    glm::vec2 previousSize = glm::vec2(0);
+
+    Statistics stats;
+};
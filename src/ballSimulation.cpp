@@ -0,0 +1,363 @@
+#include "ballSimulation.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <utilities/simd.h>
+
+static const float gravity = 98.0f;
+static const float wallRestitution = 0.9f;
+static const float ballRestitution = 0.8f;
+// After a long frame the simulation falls behind instead of trying to catch up, which would only make the next frame
+// take longer still
+static const unsigned int maxStepsPerUpdate = 8;
+// Balls per task. A multiple of four, so a block never splits a group of four balls.
+static const std::size_t blockSize = 1024;
+// Limits the memory and clearing cost of the grid for small balls in a large box. Cells grow beyond the diameter of
+// a ball instead, which only means more pairs to test.
+static const std::size_t maxCellsPerBall = 8;
+
+void BallSimulation::State::resize(std::size_t size)
+{
+    for (std::vector<float> *component : {&x, &y, &z, &vx, &vy, &vz})
+    {
+        component->assign(size, 0.0f);
+    }
+}
+
+void BallSimulation::init(ThreadPool &threadPool, std::size_t ballCount, float radius, glm::vec3 minimum,
+                          glm::vec3 maximum, std::uint32_t seed)
+{
+    pool = &threadPool;
+    count = ballCount;
+    paddedCount = (count + 3) / 4 * 4;
+    ballRadius = radius;
+    boundsMin = minimum;
+    boundsMax = maximum;
+    accumulatedSeconds = 0;
+    stats = Statistics();
+
+    // Four more than needed, so four balls can always be loaded starting at any ball
+    current.resize(paddedCount + 4);
+    next.resize(paddedCount + 4);
+    ballCells.assign(count, 0);
+
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    glm::vec3 spawnMin = glm::vec3(boundsMin.x, (boundsMin.y + boundsMax.y) / 2, boundsMin.z) + glm::vec3(radius);
+    glm::vec3 spawnMax = boundsMax - glm::vec3(radius);
+    const float maxSpeed = 30.0f;
+    for (std::size_t i = 0; i < count; i++)
+    {
+        current.x[i] = spawnMin.x + unit(random) * (spawnMax.x - spawnMin.x);
+        current.y[i] = spawnMin.y + unit(random) * (spawnMax.y - spawnMin.y);
+        current.z[i] = spawnMin.z + unit(random) * (spawnMax.z - spawnMin.z);
+        current.vx[i] = (unit(random) * 2 - 1) * maxSpeed;
+        current.vy[i] = (unit(random) * 2 - 1) * maxSpeed;
+        current.vz[i] = (unit(random) * 2 - 1) * maxSpeed;
+    }
+
+    glm::vec3 extent = glm::max(boundsMax - boundsMin, glm::vec3(2 * radius));
+    float cellSize = 2 * radius;
+    float cellLimit = float(std::max<std::size_t>(count * maxCellsPerBall, 4096));
+    float cellCount = std::ceil(extent.x / cellSize) * std::ceil(extent.y / cellSize) * std::ceil(extent.z / cellSize);
+    if (cellCount > cellLimit)
+    {
+        cellSize *= std::cbrt(cellCount / cellLimit);
+    }
+    // Rounded down, since the cells are stretched to fill the bounds exactly. Rounding up would make them narrower
+    // than a ball, and the search of the neighbouring cells would miss overlapping pairs.
+    gridSize = glm::max(glm::ivec3(glm::floor(extent / cellSize)), glm::ivec3(1));
+    cellStart.assign(std::size_t(gridSize.x) * gridSize.y * gridSize.z + 1, 0);
+}
+
+void BallSimulation::setPad(glm::vec3 topMin, glm::vec3 topMax)
+{
+    padMin = topMin;
+    padMax = topMax;
+}
+
+void BallSimulation::setObstacle(glm::vec3 center, float radius)
+{
+    obstacleCenter = center;
+    obstacleRadius = radius;
+}
+
+void BallSimulation::update(double deltaSeconds)
+{
+    const double stepSeconds = 1.0 / stepsPerSecond;
+    accumulatedSeconds = std::min(accumulatedSeconds + deltaSeconds, maxStepsPerUpdate * stepSeconds);
+
+    stats.steps = 0;
+    stats.pairsTested = 0;
+    stats.collisions = 0;
+    auto start = std::chrono::steady_clock::now();
+    while (accumulatedSeconds >= stepSeconds)
+    {
+        step(float(stepSeconds));
+        accumulatedSeconds -= stepSeconds;
+        stats.steps++;
+    }
+    if (stats.steps > 0)
+    {
+        stats.stepSeconds =
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / stats.steps;
+    }
+}
+
+void BallSimulation::step(float dt)
+{
+    if (count == 0)
+    {
+        return;
+    }
+    std::size_t blockCount = (count + blockSize - 1) / blockSize;
+
+    sortIntoGrid();
+
+    std::vector<std::size_t> blockPairs(blockCount, 0);
+    std::vector<std::size_t> blockCollisions(blockCount, 0);
+    pool->parallelFor(blockCount,
+                      [&](std::size_t block) { collideBalls(block, blockPairs[block], blockCollisions[block]); });
+    std::swap(current, next);
+    std::size_t collisions = 0;
+    for (std::size_t block = 0; block < blockCount; block++)
+    {
+        stats.pairsTested += blockPairs[block];
+        collisions += blockCollisions[block];
+    }
+    // Every pair is found from both balls
+    stats.collisions += collisions / 2;
+
+    pool->parallelFor(blockCount, [&](std::size_t block) { integrate(block, dt); });
+}
+
+// Counting sort by cell. The state is reordered along with it, so balls that are close together are also close
+// together in memory.
+void BallSimulation::sortIntoGrid()
+{
+    glm::vec3 inverseCellSize = glm::vec3(gridSize) / glm::max(boundsMax - boundsMin, glm::vec3(2 * ballRadius));
+    std::fill(cellStart.begin(), cellStart.end(), 0);
+    for (std::size_t i = 0; i < count; i++)
+    {
+        glm::vec3 position(current.x[i], current.y[i], current.z[i]);
+        glm::ivec3 cell = glm::ivec3((position - boundsMin) * inverseCellSize);
+        cell = glm::clamp(cell, glm::ivec3(0), gridSize - glm::ivec3(1));
+        ballCells[i] = std::uint32_t(cell.x + gridSize.x * (cell.y + gridSize.y * cell.z));
+        cellStart[ballCells[i] + 1]++;
+    }
+    for (std::size_t cell = 1; cell < cellStart.size(); cell++)
+    {
+        cellStart[cell] += cellStart[cell - 1];
+    }
+
+    // Scattering moves every start to the start of the next cell, which is undone afterwards
+    std::vector<std::uint32_t> sortedCells(count);
+    for (std::size_t i = 0; i < count; i++)
+    {
+        std::uint32_t target = cellStart[ballCells[i]]++;
+        sortedCells[target] = ballCells[i];
+        next.x[target] = current.x[i];
+        next.y[target] = current.y[i];
+        next.z[target] = current.z[i];
+        next.vx[target] = current.vx[i];
+        next.vy[target] = current.vy[i];
+        next.vz[target] = current.vz[i];
+    }
+    for (std::size_t cell = cellStart.size() - 1; cell > 0; cell--)
+    {
+        cellStart[cell] = cellStart[cell - 1];
+    }
+    cellStart[0] = 0;
+
+    ballCells.swap(sortedCells);
+    std::swap(current, next);
+}
+
+// Reads the sorted state from current and writes the state after collisions to next
+void BallSimulation::collideBalls(std::size_t block, std::size_t &pairsTested, std::size_t &collisions)
+{
+    const float diameter = 2 * ballRadius;
+    const float4 diameterSquared(diameter * diameter);
+    const float4 laneOffsets(0, 1, 2, 3);
+
+    std::size_t end = std::min(count, (block + 1) * blockSize);
+    for (std::size_t i = block * blockSize; i < end; i++)
+    {
+        glm::vec3 position(current.x[i], current.y[i], current.z[i]);
+        glm::vec3 velocity(current.vx[i], current.vy[i], current.vz[i]);
+        glm::vec3 correction(0);
+        glm::vec3 impulse(0);
+
+        const float4 x(position.x), y(position.y), z(position.z);
+        const float4 self = float4(float(i));
+
+        int cell = int(ballCells[i]);
+        int cellX = cell % gridSize.x;
+        int cellY = cell / gridSize.x % gridSize.y;
+        int cellZ = cell / (gridSize.x * gridSize.y);
+        int firstX = std::max(cellX - 1, 0);
+        int lastX = std::min(cellX + 1, gridSize.x - 1);
+        int lastY = std::min(cellY + 1, gridSize.y - 1);
+        int lastZ = std::min(cellZ + 1, gridSize.z - 1);
+        for (int neighbourZ = std::max(cellZ - 1, 0); neighbourZ <= lastZ; neighbourZ++)
+        {
+            for (int neighbourY = std::max(cellY - 1, 0); neighbourY <= lastY; neighbourY++)
+            {
+                // The three cells along x are one run of balls
+                int row = gridSize.x * (neighbourY + gridSize.y * neighbourZ);
+                std::size_t runBegin = cellStart[std::size_t(row + firstX)];
+                std::size_t runEnd = cellStart[std::size_t(row + lastX + 1)];
+                const float4 runEnd4 = float4(float(runEnd));
+                for (std::size_t j = runBegin; j < runEnd; j += 4)
+                {
+                    float4 dx = x - float4::load(&current.x[j]);
+                    float4 dy = y - float4::load(&current.y[j]);
+                    float4 dz = z - float4::load(&current.z[j]);
+                    float4 distanceSquared = dx * dx + dy * dy + dz * dz;
+                    float4 lanes = float4(float(j)) + laneOffsets;
+                    float4 touching = (distanceSquared < diameterSquared) & (lanes < runEnd4) &
+                                      ((lanes < self) | (lanes > self));
+                    pairsTested += std::min<std::size_t>(4, runEnd - j);
+
+                    int hits = moveMask(touching);
+                    for (int lane = 0; hits != 0; lane++, hits >>= 1)
+                    {
+                        if ((hits & 1) == 0)
+                        {
+                            continue;
+                        }
+                        std::size_t other = j + std::size_t(lane);
+                        glm::vec3 offset = position - glm::vec3(current.x[other], current.y[other], current.z[other]);
+                        float distance = glm::length(offset);
+                        // Balls exactly on top of each other are pushed apart vertically, in opposite directions
+                        glm::vec3 normal = distance > 0 ? offset / distance
+                                                        : glm::vec3(0, other < i ? 1.0f : -1.0f, 0);
+                        // Each ball of the pair moves half of the way out
+                        correction += normal * ((diameter - distance) * 0.5f);
+
+                        glm::vec3 otherVelocity(current.vx[other], current.vy[other], current.vz[other]);
+                        float approachSpeed = glm::dot(velocity - otherVelocity, normal);
+                        if (approachSpeed < 0)
+                        {
+                            impulse -= normal * (approachSpeed * (1 + ballRestitution) * 0.5f);
+                        }
+                        collisions++;
+                    }
+                }
+            }
+        }
+
+        next.x[i] = position.x + correction.x;
+        next.y[i] = position.y + correction.y;
+        next.z[i] = position.z + correction.z;
+        next.vx[i] = velocity.x + impulse.x;
+        next.vy[i] = velocity.y + impulse.y;
+        next.vz[i] = velocity.z + impulse.z;
+    }
+}
+
+static float4 absolute(float4 value)
+{
+    return max(value, float4(0.0f) - value);
+}
+
+// Keeps one component within [minimum, maximum], turning the velocity around when it was moving outwards
+static void bounceOffWalls(float4 &position, float4 &velocity, float4 minimum, float4 maximum)
+{
+    float4 restitution(wallRestitution);
+    float4 below = position < minimum;
+    float4 above = position > maximum;
+    position = min(max(position, minimum), maximum);
+    velocity = select(below, velocity, absolute(velocity) * restitution);
+    velocity = select(above, velocity, float4(0.0f) - absolute(velocity) * restitution);
+}
+
+// Moves four balls at a time, and handles everything that is not another simulated ball
+void BallSimulation::integrate(std::size_t block, float dt)
+{
+    const float4 dt4(dt);
+    const float4 gravityStep(-gravity * dt);
+    const float4 minimumX(boundsMin.x + ballRadius), maximumX(boundsMax.x - ballRadius);
+    const float4 minimumY(boundsMin.y + ballRadius), maximumY(boundsMax.y - ballRadius);
+    const float4 minimumZ(boundsMin.z + ballRadius), maximumZ(boundsMax.z - ballRadius);
+
+    const float4 radius(ballRadius);
+    const float4 padTop(padMax.y);
+    const float4 padMinX(padMin.x), padMaxX(padMax.x);
+    const float4 padMinZ(padMin.z), padMaxZ(padMax.z);
+
+    const float obstacleDistance = obstacleRadius + ballRadius;
+    const float4 obstacleX(obstacleCenter.x), obstacleY(obstacleCenter.y), obstacleZ(obstacleCenter.z);
+    const float4 obstacleDistanceSquared(obstacleDistance * obstacleDistance);
+
+    std::size_t end = std::min(paddedCount, (block + 1) * blockSize);
+    for (std::size_t i = block * blockSize; i < end; i += 4)
+    {
+        float4 x = float4::load(&current.x[i]), y = float4::load(&current.y[i]), z = float4::load(&current.z[i]);
+        float4 vx = float4::load(&current.vx[i]), vy = float4::load(&current.vy[i]), vz = float4::load(&current.vz[i]);
+
+        vy += gravityStep;
+        x += vx * dt4;
+        y += vy * dt4;
+        z += vz * dt4;
+
+        bounceOffWalls(x, vx, minimumX, maximumX);
+        bounceOffWalls(y, vy, minimumY, maximumY);
+        bounceOffWalls(z, vz, minimumZ, maximumZ);
+
+        // Balls sinking into the top of the pad from above are put back on top of it
+        float4 onPad = (y < padTop + radius) & (y > padTop - radius) & (x >= padMinX) & (x <= padMaxX) &
+                       (z >= padMinZ) & (z <= padMaxZ);
+        y = select(onPad, y, padTop + radius);
+        vy = select(onPad, vy, absolute(vy) * float4(wallRestitution));
+
+        float4 dx = x - obstacleX, dy = y - obstacleY, dz = z - obstacleZ;
+        float4 distanceSquared = dx * dx + dy * dy + dz * dz;
+        int hits = obstacleRadius > 0 ? moveMask(distanceSquared < obstacleDistanceSquared) : 0;
+
+        x.store(&current.x[i]);
+        y.store(&current.y[i]);
+        z.store(&current.z[i]);
+        vx.store(&current.vx[i]);
+        vy.store(&current.vy[i]);
+        vz.store(&current.vz[i]);
+
+        // Few balls touch the obstacle in any step, so those are handled one at a time
+        for (int lane = 0; hits != 0; lane++, hits >>= 1)
+        {
+            if ((hits & 1) == 0)
+            {
+                continue;
+            }
+            std::size_t ball = i + std::size_t(lane);
+            glm::vec3 offset = glm::vec3(current.x[ball], current.y[ball], current.z[ball]) - obstacleCenter;
+            float distance = glm::length(offset);
+            glm::vec3 normal = distance > 0 ? offset / distance : glm::vec3(0, 1, 0);
+            glm::vec3 position = obstacleCenter + normal * obstacleDistance;
+            glm::vec3 velocity(current.vx[ball], current.vy[ball], current.vz[ball]);
+            float approachSpeed = glm::dot(velocity, normal);
+            if (approachSpeed < 0)
+            {
+                velocity -= normal * (approachSpeed * (1 + wallRestitution));
+            }
+            current.x[ball] = position.x;
+            current.y[ball] = position.y;
+            current.z[ball] = position.z;
+            current.vx[ball] = velocity.x;
+            current.vy[ball] = velocity.y;
+            current.vz[ball] = velocity.z;
+        }
+    }
+}
+
+void BallSimulation::writeInstances(float *instances) const
+{
+    for (std::size_t i = 0; i < count; i++)
+    {
+        instances[4 * i] = current.x[i];
+        instances[4 * i + 1] = current.y[i];
+        instances[4 * i + 2] = current.z[i];
+        instances[4 * i + 3] = ballRadius;
+    }
+}
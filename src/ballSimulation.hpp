@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <utilities/threadPool.h>
+#include <vector>
+
+// Physics for many balls of the same size, bouncing around inside the box, off the pad, off the beat driven ball and
+// off each other. Runs at a fixed rate independent of the frame rate.
+//
+// Ball state is kept as separate arrays per component, so integration and the wall and pad tests handle four balls
+// per instruction. Every step the balls are sorted by the cell of a uniform grid they are in, with cells as wide as a
+// ball. Possible collisions are then only the balls in the 27 surrounding cells, and the balls of three neighbouring
+// cells along x are next to each other in the arrays. Each ball works out its own response to the balls it touches
+// from the state at the start of the step, so the balls can be split over threads without locking.
+class BallSimulation
+{
+  public:
+    static const int stepsPerSecond = 240;
+
+    struct Statistics
+    {
+        // Steps taken by the last update()
+        unsigned int steps = 0;
+        // Average time per step over the last update()
+        double stepSeconds = 0;
+        std::size_t pairsTested = 0;
+        std::size_t collisions = 0;
+    };
+
+    BallSimulation() = default;
+
+    // Scatters count balls with random velocities over the upper half of the interior of the box
+    void init(ThreadPool &pool, std::size_t count, float radius, glm::vec3 boundsMin, glm::vec3 boundsMax,
+              std::uint32_t seed = 1);
+
+    // The top of the pad, which balls bounce off when they come down on it
+    void setPad(glm::vec3 topMin, glm::vec3 topMax);
+    // A ball moved by something else, which the simulated balls bounce off
+    void setObstacle(glm::vec3 center, float radius);
+
+    // Runs as many fixed steps as fit in the elapsed time. Time left over is carried over to the next update.
+    void update(double deltaSeconds);
+
+    std::size_t size() const
+    {
+        return count;
+    }
+    float radius() const
+    {
+        return ballRadius;
+    }
+    // Writes center and radius of every ball as four floats
+    void writeInstances(float *instances) const;
+
+    const Statistics &statistics() const
+    {
+        return stats;
+    }
+
+  private:
+    BallSimulation(BallSimulation const &) = delete;
+    BallSimulation &operator=(BallSimulation const &) = delete;
+
+    // Components of position and velocity. The arrays are padded to a multiple of four balls.
+    struct State
+    {
+        std::vector<float> x, y, z;
+        std::vector<float> vx, vy, vz;
+
+        void resize(std::size_t size);
+    };
+
+    void step(float dt);
+    void integrate(std::size_t block, float dt);
+    void sortIntoGrid();
+    void collideBalls(std::size_t block, std::size_t &pairsTested, std::size_t &collisions);
+
+    ThreadPool *pool = nullptr;
+    std::size_t count = 0;
+    std::size_t paddedCount = 0;
+    float ballRadius = 1;
+
+    glm::vec3 boundsMin;
+    glm::vec3 boundsMax;
+    glm::vec3 padMin = glm::vec3(0);
+    glm::vec3 padMax = glm::vec3(0);
+    glm::vec3 obstacleCenter = glm::vec3(0);
+    float obstacleRadius = 0;
+
+    State current;
+    // Where the sorted and then the collided state is written to, before it is swapped with current
+    State next;
+
+    glm::ivec3 gridSize;
+    std::vector<std::uint32_t> ballCells;
+    // Index of the first ball in each cell, and one past the last ball in the last cell
+    std::vector<std::uint32_t> cellStart;
+
+    double accumulatedSeconds = 0;
+    Statistics stats;
+};
@@ -0,0 +1,173 @@
+#include "beatmap.hpp"
+#include "timestamps.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+// Keyframes further ahead than this are found with a binary search instead of stepping through them one by one
+static const std::size_t maxLinearCursorSteps = 8;
+
+Beatmap::Beatmap(const double *timestamps, const uint8_t *directionBits, std::size_t keyFrameCount)
+    : timestamps(timestamps), directionBits(directionBits), keyFrameCount(keyFrameCount)
+{
+}
+
+bool Beatmap::loadFromFile(const std::string &fileName)
+{
+    MappedFile mapped;
+    if (!mapped.open(fileName))
+    {
+        std::cerr << "Could not open beatmap file " << fileName << std::endl;
+        return false;
+    }
+
+    BeatmapFileHeader header;
+    if (mapped.size() < sizeof(header))
+    {
+        std::cerr << "Beatmap file " << fileName << " is truncated" << std::endl;
+        return false;
+    }
+    std::memcpy(&header, mapped.data(), sizeof(header));
+
+    if (std::memcmp(header.magic, beatmapFileMagic, sizeof(beatmapFileMagic)) != 0 ||
+        header.version != beatmapFileVersion)
+    {
+        std::cerr << fileName << " is not a supported beatmap file" << std::endl;
+        return false;
+    }
+
+    // Checked against what fits in the file before multiplying, so a huge count can not wrap the sizes around
+    std::size_t bodySize = mapped.size() - sizeof(header);
+    if (header.keyFrameCount < 2 || header.keyFrameCount > SIZE_MAX / sizeof(double) ||
+        header.keyFrameCount > bodySize / sizeof(double))
+    {
+        std::cerr << "Beatmap file " << fileName << " is truncated" << std::endl;
+        return false;
+    }
+    std::size_t keyFrames = std::size_t(header.keyFrameCount);
+    std::size_t timestampsSize = keyFrames * sizeof(double);
+    std::size_t directionBitsSize = (keyFrames + 7) / 8;
+    if (bodySize - timestampsSize < directionBitsSize)
+    {
+        std::cerr << "Beatmap file " << fileName << " is truncated" << std::endl;
+        return false;
+    }
+
+    // The keyframe search and the cursor rely on both of these
+    const double *fileTimestamps = reinterpret_cast<const double *>(mapped.data() + sizeof(header));
+    for (std::size_t i = 1; i < keyFrames; i++)
+    {
+        // Also rejects NaN
+        if (!(fileTimestamps[i - 1] <= fileTimestamps[i]))
+        {
+            std::cerr << "Beatmap file " << fileName << " has keyframes out of order at keyframe " << i << std::endl;
+            return false;
+        }
+    }
+    if (fileTimestamps[keyFrames - 1] < endOfSongTimestamp)
+    {
+        std::cerr << "Beatmap file " << fileName << " does not end with the end of song keyframe" << std::endl;
+        return false;
+    }
+
+    file = std::move(mapped);
+    ownedTimestamps.clear();
+    ownedDirectionBits.clear();
+    timestamps = reinterpret_cast<const double *>(file.data() + sizeof(header));
+    directionBits = file.data() + sizeof(header) + timestampsSize;
+    keyFrameCount = keyFrames;
+    return true;
+}
+
+bool Beatmap::saveToFile(const std::string &fileName) const
+{
+    std::ofstream out(fileName, std::ios::binary);
+    if (!out)
+    {
+        std::cerr << "Could not open " << fileName << " for writing" << std::endl;
+        return false;
+    }
+
+    BeatmapFileHeader header;
+    std::memcpy(header.magic, beatmapFileMagic, sizeof(beatmapFileMagic));
+    header.version = beatmapFileVersion;
+    header.keyFrameCount = keyFrameCount;
+
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char *>(timestamps), keyFrameCount * sizeof(double));
+    out.write(reinterpret_cast<const char *>(directionBits), (keyFrameCount + 7) / 8);
+    return bool(out);
+}
+
+void Beatmap::makeOwned()
+{
+    if (!ownedTimestamps.empty() || keyFrameCount == 0)
+    {
+        return;
+    }
+    ownedTimestamps.assign(timestamps, timestamps + keyFrameCount);
+    ownedDirectionBits.assign(directionBits, directionBits + (keyFrameCount + 7) / 8);
+    file.close();
+}
+
+void Beatmap::append(double timestamp, KeyFrameAction direction)
+{
+    makeOwned();
+
+    ownedTimestamps.push_back(timestamp);
+    if (keyFrameCount % 8 == 0)
+    {
+        ownedDirectionBits.push_back(0);
+    }
+    if (direction == TOP)
+    {
+        ownedDirectionBits.back() |= uint8_t(1 << (keyFrameCount % 8));
+    }
+    keyFrameCount++;
+
+    timestamps = ownedTimestamps.data();
+    directionBits = ownedDirectionBits.data();
+}
+
+std::size_t Beatmap::findKeyFrame(double time) const
+{
+    const double *next = std::upper_bound(timestamps, timestamps + keyFrameCount, time);
+    return next == timestamps ? 0 : std::size_t(next - timestamps) - 1;
+}
+
+bool loadBeatmap(const std::string &fileName, Beatmap &beatmap)
+{
+    if (fileName.empty())
+    {
+        beatmap = Beatmap(keyFrameTimeStamps.data(), keyFrameDirectionBits.data(), keyFrameTimeStamps.size());
+        return true;
+    }
+    return beatmap.loadFromFile(fileName);
+}
+
+void BeatmapCursor::seek(const Beatmap &beatmap, double time)
+{
+    index = beatmap.findKeyFrame(time);
+}
+
+void BeatmapCursor::update(const Beatmap &beatmap, double time)
+{
+    if (index >= beatmap.size() || time < beatmap.timestamp(index))
+    {
+        seek(beatmap, time);
+        return;
+    }
+
+    for (std::size_t step = 0; step < maxLinearCursorSteps; step++)
+    {
+        if (index + 1 >= beatmap.size() || time < beatmap.timestamp(index + 1))
+        {
+            return;
+        }
+        index++;
+    }
+
+    seek(beatmap, time);
+}
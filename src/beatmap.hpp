@@ -0,0 +1,135 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utilities/mappedFile.h>
+#include <utility>
+#include <vector>
+
+enum KeyFrameAction
+{
+    BOTTOM,
+    TOP
+};
+
+// Binary beatmap layout (little endian). Every section starts on an 8 byte boundary, so a memory mapped file can be
+// used directly without any parsing:
+//
+//   BeatmapFileHeader
+//   double  timestamps[keyFrameCount]            sorted, in seconds from the start of the track
+//   uint8_t directionBits[(keyFrameCount + 7) / 8]  bit (i % 8) of byte (i / 8) is set if keyframe i is TOP
+struct BeatmapFileHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint64_t keyFrameCount;
+};
+
+const char beatmapFileMagic[4] = {'G', 'B', 'M', 'P'};
+const uint32_t beatmapFileVersion = 1;
+
+// Every beatmap ends with a keyframe this late, so there is always a next keyframe to move the ball towards. The
+// song itself ends at the keyframe before it.
+constexpr double endOfSongTimestamp = 9999999.0;
+
+class Beatmap
+{
+  public:
+    Beatmap() = default;
+    // Creates a view of keyframes stored elsewhere (such as the embedded default track). Nothing is copied.
+    Beatmap(const double *timestamps, const uint8_t *directionBits, std::size_t keyFrameCount);
+
+    Beatmap(Beatmap &&) = default;
+    Beatmap &operator=(Beatmap &&) = default;
+
+    bool loadFromFile(const std::string &fileName);
+    bool saveToFile(const std::string &fileName) const;
+
+    // Adds a keyframe at the end of the beatmap. Timestamps must be appended in increasing order.
+    void append(double timestamp, KeyFrameAction direction);
+
+    std::size_t size() const
+    {
+        return keyFrameCount;
+    }
+    double timestamp(std::size_t index) const
+    {
+        return timestamps[index];
+    }
+    KeyFrameAction direction(std::size_t index) const
+    {
+        return (directionBits[index / 8] >> (index % 8)) & 1 ? TOP : BOTTOM;
+    }
+
+    // Index of the last keyframe at or before the given time, found by binary search
+    std::size_t findKeyFrame(double time) const;
+
+  private:
+    Beatmap(Beatmap const &) = delete;
+    Beatmap &operator=(Beatmap const &) = delete;
+
+    void makeOwned();
+
+    MappedFile file;
+    std::vector<double> ownedTimestamps;
+    std::vector<uint8_t> ownedDirectionBits;
+
+    const double *timestamps = nullptr;
+    const uint8_t *directionBits = nullptr;
+    std::size_t keyFrameCount = 0;
+};
+
+// Loads a beatmap from a file, or gives a view of the embedded default track if no file name is given
+bool loadBeatmap(const std::string &fileName, Beatmap &beatmap);
+
+// Tracks the current keyframe while the game time moves forward. Stepping to the next keyframe is amortized O(1) per
+// frame, and jumping around (seeking, restarting) falls back to a binary search.
+struct BeatmapCursor
+{
+    std::size_t index = 0;
+
+    void seek(const Beatmap &beatmap, double time);
+    void update(const Beatmap &beatmap, double time);
+};
+
+// Compile time packing of keyframe directions into the bit layout used by Beatmap
+template <std::size_t N>
+constexpr uint8_t packKeyFrameDirectionByte(const std::array<KeyFrameAction, N> &directions, std::size_t byte)
+{
+    uint8_t bits = 0;
+    for (std::size_t bit = 0; bit < 8 && byte * 8 + bit < N; bit++)
+    {
+        if (directions[byte * 8 + bit] == TOP)
+        {
+            bits |= uint8_t(1 << bit);
+        }
+    }
+    return bits;
+}
+
+template <std::size_t N, std::size_t... Bytes>
+constexpr std::array<uint8_t, sizeof...(Bytes)> packKeyFrameDirections(const std::array<KeyFrameAction, N> &directions,
+                                                                       std::index_sequence<Bytes...>)
+{
+    return {{packKeyFrameDirectionByte(directions, Bytes)...}};
+}
+
+template <std::size_t N>
+constexpr std::array<uint8_t, (N + 7) / 8> packKeyFrameDirections(const std::array<KeyFrameAction, N> &directions)
+{
+    return packKeyFrameDirections(directions, std::make_index_sequence<(N + 7) / 8>());
+}
+
+template <std::size_t N> constexpr bool keyFramesAreSorted(const std::array<double, N> &timestamps)
+{
+    for (std::size_t i = 1; i < N; i++)
+    {
+        if (timestamps[i - 1] > timestamps[i])
+        {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,191 @@
+#include "deferredRenderer.hpp"
+#include <algorithm>
+#include <cmath>
+#include <glm/gtc/type_ptr.hpp>
+#include <iostream>
+
+// Light attenuation, as in simple.frag
+static const float attenuationConstant = 1.0f;
+static const float attenuationLinear = 0.01009f;
+static const float attenuationQuadratic = 0.00107f;
+// Lights are cut off where they contribute less than one step of an 8 bit colour channel
+static const float lightCutoff = 1.0f / 256.0f;
+
+DeferredRenderer::~DeferredRenderer()
+{
+    delete geometryShader;
+    delete lightShader;
+}
+
+void DeferredRenderer::init()
+{
+    geometryShader = new Gloom::Shader(GPU_HERE);
+    geometryShader->makeBasicShader("../res/shaders/simple.vert", "../res/shaders/gbuffer.frag");
+    gpuResources().setTag(GpuResourceType::Program, geometryShader->get(), "gbuffer.frag");
+
+    lightShader = new Gloom::Shader(GPU_HERE);
+    lightShader->makeBasicShader("../res/shaders/deferredLight.vert", "../res/shaders/deferredLight.frag");
+
+    emptyVertexArray = GLVertexArray("deferred lighting", GPU_HERE);
+}
+
+void DeferredRenderer::resize(int newWidth, int newHeight)
+{
+    allocatedWidth = newWidth;
+    allocatedHeight = newHeight;
+
+    auto createTarget = [&](GLTexture &texture, GLenum format, std::size_t bytesPerPixel, const char *tag) {
+        texture = GLTexture(tag, GPU_HERE);
+        glBindTexture(GL_TEXTURE_2D, texture.id());
+        glTexStorage2D(GL_TEXTURE_2D, 1, format, allocatedWidth, allocatedHeight);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        texture.setBytes(std::size_t(allocatedWidth) * allocatedHeight * bytesPerPixel);
+    };
+    createTarget(albedo, GL_RGBA8, 4, "G-buffer albedo");
+    createTarget(normalSpecular, GL_RGB16F, 6, "G-buffer normals");
+    createTarget(depth, GL_DEPTH_COMPONENT32F, 4, "G-buffer depth");
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    framebuffer = GLFramebuffer("G-buffer", GPU_HERE);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer.id());
+    glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, albedo.id(), 0);
+    glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, normalSpecular.id(), 0);
+    glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depth.id(), 0);
+    const GLenum drawBuffers[2] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+    glDrawBuffers(2, drawBuffers);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        std::cerr << "The G-buffer framebuffer is incomplete" << std::endl;
+    }
+}
+
+Gloom::Shader *DeferredRenderer::beginGeometryPass(int newWidth, int newHeight)
+{
+    if (newWidth > allocatedWidth || newHeight > allocatedHeight)
+    {
+        resize(std::max(newWidth, allocatedWidth), std::max(newHeight, allocatedHeight));
+    }
+    width = newWidth;
+    height = newHeight;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer.id());
+    glViewport(0, 0, width, height);
+    // Only the part drawn into is ever read
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(0, 0, width, height);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glDisable(GL_SCISSOR_TEST);
+
+    geometryShader->activate();
+    return geometryShader;
+}
+
+bool DeferredRenderer::lightScissor(const glm::mat4 &viewProjection, glm::vec3 position, float range,
+                                    glm::ivec4 &scissor) const
+{
+    // Project the corners of the box around the light's range
+    glm::vec2 minimum(1.0f);
+    glm::vec2 maximum(-1.0f);
+    for (int corner = 0; corner < 8; corner++)
+    {
+        glm::vec3 offset((corner & 1) ? range : -range, (corner & 2) ? range : -range, (corner & 4) ? range : -range);
+        glm::vec4 clip = viewProjection * glm::vec4(position + offset, 1.0f);
+        if (clip.w <= 0.0f)
+        {
+            // Part of the box is behind the camera, where the projection is meaningless
+            scissor = glm::ivec4(0, 0, width, height);
+            return true;
+        }
+        glm::vec2 ndc = glm::vec2(clip.x, clip.y) / clip.w;
+        minimum = glm::min(minimum, ndc);
+        maximum = glm::max(maximum, ndc);
+    }
+
+    minimum = glm::max(minimum, glm::vec2(-1.0f));
+    maximum = glm::min(maximum, glm::vec2(1.0f));
+    if (minimum.x >= maximum.x || minimum.y >= maximum.y)
+    {
+        return false;
+    }
+
+    int x0 = int(std::floor((minimum.x * 0.5f + 0.5f) * width));
+    int y0 = int(std::floor((minimum.y * 0.5f + 0.5f) * height));
+    int x1 = int(std::ceil((maximum.x * 0.5f + 0.5f) * width));
+    int y1 = int(std::ceil((maximum.y * 0.5f + 0.5f) * height));
+    scissor = glm::ivec4(x0, y0, x1 - x0, y1 - y0);
+    return true;
+}
+
+void DeferredRenderer::lightingPass(const glm::mat4 &viewProjection, glm::vec3 cameraPosition,
+                                    const PointShadowMaps &shadowMaps, bool useShadowMaps, glm::vec3 ballPosition,
+                                    float ballRadius, GLuint targetFramebuffer)
+{
+    stats = Statistics();
+
+    glBindFramebuffer(GL_FRAMEBUFFER, targetFramebuffer);
+    glViewport(0, 0, width, height);
+    glDisable(GL_DEPTH_TEST);
+
+    lightShader->activate();
+    glBindVertexArray(emptyVertexArray.id());
+    glBindTextureUnit(0, albedo.id());
+    glBindTextureUnit(1, normalSpecular.id());
+    glBindTextureUnit(2, depth.id());
+    shadowMaps.bind(3);
+
+    glm::mat4 inverseViewProjection = glm::inverse(viewProjection);
+    glUniformMatrix4fv(lightShader->getUniformFromName("inverseVP"), 1, GL_FALSE,
+                       glm::value_ptr(inverseViewProjection));
+    glUniform3fv(lightShader->getUniformFromName("cameraPos"), 1, glm::value_ptr(cameraPosition));
+    glUniform3fv(lightShader->getUniformFromName("ballPos"), 1, glm::value_ptr(ballPosition));
+    glUniform1f(lightShader->getUniformFromName("ballRadius"), ballRadius);
+    glUniform1f(lightShader->getUniformFromName("shadowFarPlane"), shadowMaps.farPlane());
+
+    // The ambient pass replaces what the target was cleared to, except where nothing was drawn and the clear colour
+    // stays as the sky. Only the lights are added on top.
+    glUniform1i(lightShader->getUniformFromName("ambientPass"), true);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glUniform1i(lightShader->getUniformFromName("ambientPass"), false);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE);
+
+    glEnable(GL_SCISSOR_TEST);
+    for (int light = 0; light < sceneNodePool.lightCount(); light++)
+    {
+        SceneNodeHandle lightNode = sceneNodePool.light(light);
+        glm::vec3 position(lightNode->currentTransformationMatrix[3]);
+        glm::vec3 color = lightNode->lightColor;
+
+        // Distance at which attenuation * brightest channel drops below the cutoff
+        float brightness = std::max(color.r, std::max(color.g, color.b));
+        float c = attenuationConstant - brightness / lightCutoff;
+        float range = (-attenuationLinear + std::sqrt(attenuationLinear * attenuationLinear -
+                                                      4.0f * attenuationQuadratic * c)) /
+                      (2.0f * attenuationQuadratic);
+
+        glm::ivec4 scissor;
+        if (brightness <= 0.0f || !lightScissor(viewProjection, position, range, scissor))
+        {
+            stats.lightsCulled++;
+            continue;
+        }
+        glScissor(scissor.x, scissor.y, scissor.z, scissor.w);
+
+        glUniform1i(lightShader->getUniformFromName("lightIndex"), light);
+        glUniform1i(lightShader->getUniformFromName("useShadowMaps"),
+                    useShadowMaps && light < shadowMaps.lightCapacity());
+        glUniform3fv(lightShader->getUniformFromName("lightPosition"), 1, glm::value_ptr(position));
+        glUniform3fv(lightShader->getUniformFromName("lightColor"), 1, glm::value_ptr(color));
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+
+        stats.lightsDrawn++;
+        stats.lightCoverage += float(scissor.z) * scissor.w / (float(width) * height);
+    }
+    glDisable(GL_SCISSOR_TEST);
+
+    glDisable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glEnable(GL_DEPTH_TEST);
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "sceneGraph.hpp"
+#include "shadowMaps.hpp"
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <utilities/gpuResource.h>
+#include <utilities/shader.hpp>
+
+// Alternative to shading everything in simple.frag. The scene is first drawn into a G-buffer holding only what the
+// lighting needs, and each light is then applied once per covered pixel, so the lighting cost does not grow with
+// overdraw. Every light is drawn as a full screen triangle clipped by a scissor rectangle around its range.
+//
+// G-buffer layout:
+//   0: RGBA8    albedo
+//   1: RGB16F   octahedral encoded normal (xy), specular intensity (z)
+//   depth: 32 bit float, world positions are reconstructed from it
+class DeferredRenderer
+{
+  public:
+    struct Statistics
+    {
+        unsigned int lightsDrawn = 0;
+        unsigned int lightsCulled = 0;
+        // Fraction of the screen covered by light scissor rectangles, summed over all lights
+        float lightCoverage = 0;
+    };
+
+    DeferredRenderer() = default;
+    ~DeferredRenderer();
+
+    void init();
+
+    // Binds and clears the G-buffer, and returns the shader the scene should be drawn with. It takes the same
+    // uniforms and textures as simple.vert/simple.frag. The scene is drawn into the bottom left width x height pixels,
+    // and the G-buffer is only reallocated when it has to grow.
+    Gloom::Shader *beginGeometryPass(int width, int height);
+
+    // Lights the G-buffer into the bottom left corner of the target framebuffer. shadowMaps is only used if
+    // useShadowMaps is set.
+    void lightingPass(const glm::mat4 &viewProjection, glm::vec3 cameraPosition, const PointShadowMaps &shadowMaps,
+                      bool useShadowMaps, glm::vec3 ballPosition, float ballRadius, GLuint targetFramebuffer = 0);
+
+    // Depth of the last geometry pass, for drawing more on top of the lit image
+    GLuint depthTexture() const
+    {
+        return depth.id();
+    }
+
+    const Statistics &statistics() const
+    {
+        return stats;
+    }
+
+  private:
+    DeferredRenderer(DeferredRenderer const &) = delete;
+    DeferredRenderer &operator=(DeferredRenderer const &) = delete;
+
+    void resize(int width, int height);
+    // Pixel rectangle (x, y, width, height) that can receive light from a light at the given position
+    bool lightScissor(const glm::mat4 &viewProjection, glm::vec3 position, float range, glm::ivec4 &scissor) const;
+
+    Gloom::Shader *geometryShader = nullptr;
+    Gloom::Shader *lightShader = nullptr;
+
+    GLFramebuffer framebuffer;
+    GLTexture albedo;
+    GLTexture normalSpecular;
+    GLTexture depth;
+    // The light pass generates its vertices, but a vertex array still has to be bound
+    GLVertexArray emptyVertexArray;
+
+    // Size of the textures, and of the part of them the current frame is drawn into
+    int allocatedWidth = 0;
+    int allocatedHeight = 0;
+    int width = 0;
+    int height = 0;
+
+    Statistics stats;
+};
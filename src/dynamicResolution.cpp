@@ -0,0 +1,171 @@
+#include "dynamicResolution.hpp"
+#include <algorithm>
+#include <cmath>
+#include <glm/glm.hpp>
+#include <iostream>
+
+// The controller aims a little below the budget, and leaves the scale alone while the GPU time is within this band
+// around that, so measurement noise does not make the resolution flicker
+static const double targetLoad = 0.9;
+static const double lowerLoad = 0.8;
+static const double upperLoad = 1.0;
+// Steps are limited, faster downwards than upwards. GPU times arrive a few frames late, and recovering from a spike
+// is worth more than getting the sharpness back early.
+static const float maximumScaleDecrease = 0.1f;
+static const float maximumScaleIncrease = 0.02f;
+// Sharpening at the minimum scale. It fades out towards the full resolution, where there is no blur to undo.
+static const float maximumSharpness = 0.25f;
+
+DynamicResolution::~DynamicResolution()
+{
+    delete upscaleShader;
+}
+
+void DynamicResolution::init(int sampleCount, double budget, float minimum)
+{
+    setSamples(sampleCount);
+    budgetSeconds = budget;
+    minimumScale = budget > 0 ? glm::clamp(minimum, 0.1f, 1.0f) : 1.0f;
+    stats = Statistics();
+
+    // Same full screen triangle as the deferred lighting
+    upscaleShader = new Gloom::Shader(GPU_HERE);
+    upscaleShader->makeBasicShader("../res/shaders/deferredLight.vert", "../res/shaders/upscale.frag");
+
+    emptyVertexArray = GLVertexArray("upscale", GPU_HERE);
+}
+
+void DynamicResolution::setSamples(int sampleCount)
+{
+    GLint maximumSamples = 1;
+    glGetIntegerv(GL_MAX_SAMPLES, &maximumSamples);
+    int newSamples = glm::clamp(sampleCount, 1, int(maximumSamples));
+    if (newSamples != samples)
+    {
+        samples = newSamples;
+        // Makes the next beginScene() allocate the targets again
+        width = 0;
+        height = 0;
+    }
+}
+
+void DynamicResolution::update(double gpuSeconds)
+{
+    stats.gpuSeconds = gpuSeconds;
+    if (budgetSeconds <= 0)
+    {
+        return;
+    }
+
+    double load = gpuSeconds / budgetSeconds;
+    if (load >= lowerLoad && load <= upperLoad)
+    {
+        return;
+    }
+    // The GPU time grows about with the number of pixels, which is the square of the scale
+    float wantedScale = stats.scale * float(std::sqrt(targetLoad / std::max(load, 1e-3)));
+    float step = glm::clamp(wantedScale - stats.scale, -maximumScaleDecrease, maximumScaleIncrease);
+    stats.scale = glm::clamp(stats.scale + step, minimumScale, 1.0f);
+}
+
+void DynamicResolution::resize(int newWidth, int newHeight)
+{
+    width = newWidth;
+    height = newHeight;
+
+    auto createTarget = [&](GLTexture &texture, GLenum format, std::size_t bytesPerPixel, int targetSamples,
+                            const char *tag) {
+        texture = GLTexture(tag, GPU_HERE);
+        if (targetSamples > 1)
+        {
+            glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, texture.id());
+            glTexStorage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, targetSamples, format, width, height, GL_TRUE);
+            glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, 0);
+        }
+        else
+        {
+            glBindTexture(GL_TEXTURE_2D, texture.id());
+            glTexStorage2D(GL_TEXTURE_2D, 1, format, width, height);
+            // Sampled by the upscale, which filters and never reads past the rendered part
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glBindTexture(GL_TEXTURE_2D, 0);
+        }
+        texture.setBytes(std::size_t(width) * height * bytesPerPixel * targetSamples);
+    };
+    auto checkComplete = [](GLuint framebuffer, const char *name) {
+        if (glCheckNamedFramebufferStatus(framebuffer, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        {
+            std::cerr << "The " << name << " framebuffer is incomplete" << std::endl;
+        }
+    };
+
+    createTarget(sceneColor, GL_RGBA8, 4, samples, "scene colour");
+    createTarget(sceneDepth, GL_DEPTH_COMPONENT32F, 4, samples, "scene depth");
+    sceneTarget = GLFramebuffer("scene", GPU_HERE);
+    glNamedFramebufferTexture(sceneTarget.id(), GL_COLOR_ATTACHMENT0, sceneColor.id(), 0);
+    glNamedFramebufferTexture(sceneTarget.id(), GL_DEPTH_ATTACHMENT, sceneDepth.id(), 0);
+    checkComplete(sceneTarget.id(), "scene");
+
+    if (samples > 1)
+    {
+        createTarget(resolvedColor, GL_RGBA8, 4, 1, "resolved scene colour");
+        resolveTarget = GLFramebuffer("scene resolve", GPU_HERE);
+        glNamedFramebufferTexture(resolveTarget.id(), GL_COLOR_ATTACHMENT0, resolvedColor.id(), 0);
+        checkComplete(resolveTarget.id(), "scene resolve");
+    }
+}
+
+void DynamicResolution::beginScene(int windowWidth, int windowHeight)
+{
+    if (windowWidth != width || windowHeight != height)
+    {
+        resize(windowWidth, windowHeight);
+    }
+    stats.renderWidth = std::max(int(std::lround(width * stats.scale)), 1);
+    stats.renderHeight = std::max(int(std::lround(height * stats.scale)), 1);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, sceneTarget.id());
+    glViewport(0, 0, stats.renderWidth, stats.renderHeight);
+    // Only the rendered part is ever read
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(0, 0, stats.renderWidth, stats.renderHeight);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glDisable(GL_SCISSOR_TEST);
+}
+
+GLuint DynamicResolution::resolve()
+{
+    if (samples == 1)
+    {
+        return sceneColor.id();
+    }
+    glBlitNamedFramebuffer(sceneTarget.id(), resolveTarget.id(), 0, 0, stats.renderWidth, stats.renderHeight, 0, 0,
+                           stats.renderWidth, stats.renderHeight, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    return resolvedColor.id();
+}
+
+void DynamicResolution::upscale(GLuint sceneTexture)
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, width, height);
+    glDisable(GL_DEPTH_TEST);
+
+    float sharpness = 0;
+    if (minimumScale < 1)
+    {
+        sharpness = maximumSharpness * (1 - stats.scale) / (1 - minimumScale);
+    }
+
+    upscaleShader->activate();
+    glBindVertexArray(emptyVertexArray.id());
+    glBindTextureUnit(0, sceneTexture);
+    glUniform2f(upscaleShader->getUniformFromName("renderedSize"), float(stats.renderWidth),
+                float(stats.renderHeight));
+    glUniform1f(upscaleShader->getUniformFromName("sharpness"), sharpness);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+
+    glEnable(GL_DEPTH_TEST);
+}
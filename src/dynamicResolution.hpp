@@ -0,0 +1,106 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <utilities/gpuResource.h>
+#include <utilities/shader.hpp>
+
+// Renders the 3D scene into an offscreen target at a fraction of the window size, and scales it up to the window
+// with a sharpening filter. The fraction follows the GPU time of recent frames, so a scene that gets too heavy for the
+// GPU costs resolution instead of frame rate. The scene is rendered into the bottom left corner of targets allocated
+// at the full window size, so changing the resolution never reallocates anything.
+//
+// Targets:
+//   RGBA8 colour and 32 bit float depth, rendered into, multisampled unless there is a single sample
+//   single sampled RGBA8 colour, the samples resolved for the upscale, only when multisampled
+class DynamicResolution
+{
+  public:
+    struct Statistics
+    {
+        float scale = 1;
+        int renderWidth = 0;
+        int renderHeight = 0;
+        // Most recent GPU time the controller was given
+        double gpuSeconds = 0;
+    };
+
+    DynamicResolution() = default;
+    ~DynamicResolution();
+
+    // Without a GPU time budget, the scene is always rendered at the full window size
+    void init(int samples, double budgetSeconds, float minimumScale);
+    // Multisampling of the scene target from the next beginScene() on, which reallocates the targets
+    void setSamples(int sampleCount);
+
+    // Feeds the GPU time of a finished frame to the controller, which picks the scale of the next frames
+    void update(double gpuSeconds);
+
+    // Binds and clears the offscreen target, with the viewport set to the part the scene is rendered into
+    void beginScene(int windowWidth, int windowHeight);
+    // The target beginScene() binds, for passes that have to bind it again
+    GLuint sceneFramebuffer() const
+    {
+        return sceneTarget.id();
+    }
+    int renderWidth() const
+    {
+        return stats.renderWidth;
+    }
+    int renderHeight() const
+    {
+        return stats.renderHeight;
+    }
+    // Size of the targets, of which the scene fills the bottom left renderWidth() x renderHeight() pixels
+    int allocatedWidth() const
+    {
+        return width;
+    }
+    int allocatedHeight() const
+    {
+        return height;
+    }
+    // Only single sampled depth can be read by a post processing pass
+    GLuint sceneDepthTexture() const
+    {
+        return sceneDepth.id();
+    }
+
+    // Resolves the samples of the scene, and returns the single sampled colour texture it ends up in
+    GLuint resolve();
+    // Draws the scene in the bottom left corner of the texture over the whole default framebuffer, which stays bound
+    void upscale(GLuint sceneTexture);
+
+    double budget() const
+    {
+        return budgetSeconds;
+    }
+    const Statistics &statistics() const
+    {
+        return stats;
+    }
+
+  private:
+    DynamicResolution(DynamicResolution const &) = delete;
+    DynamicResolution &operator=(DynamicResolution const &) = delete;
+
+    void resize(int width, int height);
+
+    int samples = 1;
+    double budgetSeconds = 0;
+    float minimumScale = 1;
+
+    int width = 0;
+    int height = 0;
+
+    GLFramebuffer sceneTarget;
+    GLTexture sceneColor;
+    GLTexture sceneDepth;
+    GLFramebuffer resolveTarget;
+    GLTexture resolvedColor;
+
+    Gloom::Shader *upscaleShader = nullptr;
+    // The upscale pass generates its vertices, but a vertex array still has to be bound
+    GLVertexArray emptyVertexArray;
+
+    Statistics stats;
+};
@@ -0,0 +1,257 @@
+#include "gameState.hpp"
+#include <algorithm>
+#include <limits>
+
+static const float ballSpeed = 60.0f;
+
+// Time until a point moving with the given speed reaches either end of [minimum, maximum]
+static double timeToWall(double position, double speed, double minimum, double maximum)
+{
+    if (speed > 0)
+    {
+        return std::max((maximum - position) / speed, 0.0);
+    }
+    if (speed < 0)
+    {
+        return std::max((minimum - position) / speed, 0.0);
+    }
+    return std::numeric_limits<double>::infinity();
+}
+
+// Moves the ball by travel times its direction along x and z, bouncing off the walls the center of the ball is kept
+// between. Every wall is hit at its time of impact and the rest of the travel continues from there, so no distance
+// is lost to clamping and a long step can not carry the ball through a wall, however often it bounces on the way.
+static void sweepBallHorizontally(glm::vec3 &position, glm::vec3 &direction, double travel, glm::vec2 minimum,
+                                  glm::vec2 maximum)
+{
+    // Only a few bounces fit in any sensible step, the limit just guards against a box too small for the ball
+    for (int bounce = 0; bounce < 64 && travel > 0; bounce++)
+    {
+        double hitX = timeToWall(position.x, direction.x, minimum.x, maximum.x);
+        double hitZ = timeToWall(position.z, direction.z, minimum.y, maximum.y);
+        double step = std::min(travel, std::min(hitX, hitZ));
+
+        position.x += step * direction.x;
+        position.z += step * direction.z;
+        travel -= step;
+
+        if (hitX <= step)
+        {
+            position.x = direction.x > 0 ? maximum.x : minimum.x;
+            direction.x *= -1;
+        }
+        if (hitZ <= step)
+        {
+            position.z = direction.z > 0 ? maximum.y : minimum.y;
+            direction.z *= -1;
+        }
+    }
+    position.x = glm::clamp(position.x, minimum.x, maximum.x);
+    position.z = glm::clamp(position.z, minimum.y, maximum.y);
+}
+
+bool ballIsAbovePad(const GameState &state)
+{
+    double padLeftX =
+        boxPosition.x - (boxDimensions.x / 2) + (1 - state.padPositionX) * (boxDimensions.x - padDimensions.x);
+    double padRightX = padLeftX + padDimensions.x;
+    double padFrontZ =
+        boxPosition.z - (boxDimensions.z / 2) + (1 - state.padPositionZ) * (boxDimensions.z - padDimensions.z);
+    double padBackZ = padFrontZ + padDimensions.z;
+
+    return state.ballPosition.x >= padLeftX && state.ballPosition.x <= padRightX &&
+           state.ballPosition.z >= padFrontZ && state.ballPosition.z <= padBackZ;
+}
+
+bool gameIsRunning(const GameState &state)
+{
+    return state.hasStarted && !state.hasLost && !state.isPaused;
+}
+
+GameEvents updateGameState(GameState &state, const Beatmap &beatmap, const GameRules &rules, const FrameInput &input)
+{
+    GameEvents events;
+    double timeDelta = input.timeDeltaNanoseconds / 1e9;
+
+    const float ballBottomY = boxPosition.y - (boxDimensions.y / 2) + ballRadius + padDimensions.y;
+    const float ballTopY = boxPosition.y + (boxDimensions.y / 2) - ballRadius;
+    const float BallVerticalTravelDistance = ballTopY - ballBottomY;
+
+    const float ballMinX = boxPosition.x - (boxDimensions.x / 2) + ballRadius;
+    const float ballMaxX = boxPosition.x + (boxDimensions.x / 2) - ballRadius;
+    const float ballMinZ = boxPosition.z - (boxDimensions.z / 2) + ballRadius;
+    const float ballMaxZ = boxPosition.z + (boxDimensions.z / 2) - ballRadius - cameraWallOffset;
+
+    state.padPositionX -=
+        rules.mouseSensitivity * input.mouseDeltaX / (double(mouseDeltaSubpixels) * rules.windowWidth);
+    state.padPositionZ -=
+        rules.mouseSensitivity * input.mouseDeltaY / (double(mouseDeltaSubpixels) * rules.windowHeight);
+    state.padPositionX = glm::clamp(state.padPositionX, 0.0, 1.0);
+    state.padPositionZ = glm::clamp(state.padPositionZ, 0.0, 1.0);
+
+    bool mouseLeftWasPressed = state.mouseLeftPressed;
+    if (input.buttons & leftMouseButton)
+    {
+        state.mouseLeftPressed = true;
+        state.mouseLeftReleased = false;
+    }
+    else
+    {
+        state.mouseLeftReleased = state.mouseLeftPressed;
+        state.mouseLeftPressed = false;
+    }
+    if (input.buttons & rightMouseButton)
+    {
+        state.mouseRightPressed = true;
+        state.mouseRightReleased = false;
+    }
+    else
+    {
+        state.mouseRightReleased = state.mouseRightPressed;
+        state.mouseRightPressed = false;
+    }
+    bool mouseLeftClicked = state.mouseLeftPressed && !mouseLeftWasPressed;
+
+    if (!state.hasStarted)
+    {
+        // A generated beatmap needs its first keyframes before the game can start
+        if (state.mouseLeftPressed && beatmap.size() >= 2)
+        {
+            state.totalElapsedTime = rules.startTime;
+            state.gameElapsedTime = rules.startTime;
+            state.beatmapCursor.seek(beatmap, state.gameElapsedTime);
+            state.previousKeyFrame = state.beatmapCursor.index;
+            state.hasStarted = true;
+            events.started = true;
+        }
+
+        state.ballPosition.x = ballMinX + (1 - state.padPositionX) * (ballMaxX - ballMinX);
+        state.ballPosition.y = ballBottomY;
+        state.ballPosition.z = ballMinZ + (1 - state.padPositionZ) * ((ballMaxZ + cameraWallOffset) - ballMinZ);
+        return events;
+    }
+
+    state.totalElapsedTime += timeDelta;
+    if (state.hasLost)
+    {
+        if (state.mouseLeftReleased)
+        {
+            state.hasLost = false;
+            state.hasStarted = false;
+        }
+        return events;
+    }
+    if (state.isPaused)
+    {
+        if (state.mouseRightReleased)
+        {
+            state.isPaused = false;
+            events.resumed = true;
+        }
+        return events;
+    }
+
+    double previousGameElapsedTime = state.gameElapsedTime;
+    state.gameElapsedTime = input.gameTimeNanoseconds / 1e9;
+
+    events.calibrationTap = rules.calibrate && mouseLeftClicked;
+
+    if (state.mouseRightReleased)
+    {
+        state.isPaused = true;
+        events.paused = true;
+    }
+    // Get the timing for the beat of the song
+    state.beatmapCursor.update(beatmap, state.gameElapsedTime);
+    // Assumes last keyframe at infinity
+    std::size_t currentKeyFrame = std::min(state.beatmapCursor.index, beatmap.size() - 2);
+
+    std::size_t passedKeyFrame = state.previousKeyFrame;
+    state.previousKeyFrame = currentKeyFrame;
+
+    double frameStart = beatmap.timestamp(currentKeyFrame);
+    double frameEnd = beatmap.timestamp(currentKeyFrame + 1);
+
+    double elapsedTimeInFrame = state.gameElapsedTime - frameStart;
+    double frameDuration = frameEnd - frameStart;
+    // Only goes past 1 if a generated beatmap has not caught up yet, in which case the ball waits at the end
+    double fractionFrameComplete = std::min(elapsedTimeInFrame / frameDuration, 1.0);
+
+    double ballYCoord;
+
+    KeyFrameAction currentOrigin = beatmap.direction(currentKeyFrame);
+    KeyFrameAction currentDestination = beatmap.direction(currentKeyFrame + 1);
+
+    // Synchronize ball with music
+    if (currentOrigin == BOTTOM && currentDestination == BOTTOM)
+    {
+        ballYCoord = ballBottomY;
+    }
+    else if (currentOrigin == TOP && currentDestination == TOP)
+    {
+        ballYCoord = ballBottomY + BallVerticalTravelDistance;
+    }
+    else if (currentDestination == BOTTOM)
+    {
+        ballYCoord = ballBottomY + BallVerticalTravelDistance * (1 - fractionFrameComplete);
+    }
+    else
+    {
+        ballYCoord = ballBottomY + BallVerticalTravelDistance * fractionFrameComplete;
+    }
+
+    // Make ball move. The ball bounces off the walls at their exact time of impact, and the pad is checked at the
+    // exact time of every keyframe where the ball leaves the bottom, even when a long frame passes several of them.
+    const glm::vec2 ballMin(ballMinX, ballMinZ);
+    const glm::vec2 ballMax(ballMaxX, ballMaxZ);
+    auto moveBall = [&](double seconds) {
+        sweepBallHorizontally(state.ballPosition, state.ballDirection, seconds * ballSpeed, ballMin, ballMax);
+        if (rules.autoplay)
+        {
+            state.padPositionX = 1 - (state.ballPosition.x - ballMinX) / (ballMaxX - ballMinX);
+            state.padPositionZ = 1 - (state.ballPosition.z - ballMinZ) / ((ballMaxZ + cameraWallOffset) - ballMinZ);
+        }
+    };
+
+    double movedUntil = previousGameElapsedTime;
+    for (std::size_t keyFrame = passedKeyFrame + 1; keyFrame <= currentKeyFrame; keyFrame++)
+    {
+        if (beatmap.direction(keyFrame) != BOTTOM || beatmap.direction(keyFrame + 1) != TOP)
+        {
+            continue;
+        }
+        double bounceTime = beatmap.timestamp(keyFrame);
+        moveBall(bounceTime - movedUntil);
+        movedUntil = bounceTime;
+
+        // Check if the ball is hitting the pad when the ball is at the bottom.
+        // If not, you just lost the game! (hehe)
+        if (rules.calibrate || ballIsAbovePad(state))
+        {
+            state.padHits++;
+            events.padHits++;
+            events.padHitPosition = state.ballPosition;
+            events.padHitPosition.y = float(ballBottomY - ballRadius);
+            continue;
+        }
+        state.misses++;
+        events.missed = true;
+        if (!rules.keepPlayingAfterMiss)
+        {
+            state.hasLost = true;
+            break;
+        }
+    }
+
+    if (state.hasLost)
+    {
+        // Stays where it missed the pad
+        state.ballPosition.y = ballBottomY;
+    }
+    else
+    {
+        moveBall(state.gameElapsedTime - movedUntil);
+        state.ballPosition.y = ballYCoord;
+    }
+    return events;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "beatmap.hpp"
+#include "inputRecording.hpp"
+#include <cstddef>
+#include <glm/glm.hpp>
+
+// The box the ball bounces around in, and the pad at its bottom
+const glm::vec3 boxPosition(0, -10, -80);
+const glm::vec3 boxDimensions(180, 90, 90);
+const glm::vec3 padDimensions(30, 3, 40);
+// Arbitrary addition to prevent the balls from going too much into the camera
+const float cameraWallOffset = 30;
+const double ballRadius = 3.0;
+
+// What stays the same while a game is played
+struct GameRules
+{
+    // The pad follows the ball by itself
+    bool autoplay = false;
+    // Nobody loses while calibrating, since the player is busy clicking along with the music
+    bool calibrate = false;
+    // Misses are counted, but the game goes on instead of waiting for a click to start over
+    bool keepPlayingAfterMiss = false;
+    double mouseSensitivity = 1.0;
+    // Mouse movement is relative to the window size the session started with. It stays fixed even if the window is
+    // resized, since a recording only stores the starting size.
+    int windowWidth = 0;
+    int windowHeight = 0;
+    // Song position the game starts at, in seconds
+    double startTime = 0;
+};
+
+// What happened during one update
+struct GameEvents
+{
+    bool started = false;
+    bool paused = false;
+    bool resumed = false;
+    // The ball came down next to the pad
+    bool missed = false;
+    // Left click while calibrating
+    bool calibrationTap = false;
+    unsigned int padHits = 0;
+    // Where the bottom of the ball touched the pad, at the time of the last of the pad hits
+    glm::vec3 padHitPosition = glm::vec3(0);
+};
+
+// Everything that changes while playing. The game keeps one of these, and a batch simulation runs many side by side.
+struct GameState
+{
+    bool hasStarted = false;
+    bool hasLost = false;
+    bool isPaused = false;
+
+    // 0 to 1 across the box, in the opposite direction of the mouse
+    double padPositionX = 0;
+    double padPositionZ = 0;
+    glm::vec3 ballPosition = glm::vec3(0, ballRadius + padDimensions.y, boxDimensions.z / 2);
+    glm::vec3 ballDirection = glm::vec3(1, 1, 0.2f);
+
+    // Time since the game started, and the position in the song
+    double totalElapsedTime = 0;
+    double gameElapsedTime = 0;
+    BeatmapCursor beatmapCursor;
+    std::size_t previousKeyFrame = 0;
+
+    bool mouseLeftPressed = false;
+    bool mouseLeftReleased = false;
+    bool mouseRightPressed = false;
+    bool mouseRightReleased = false;
+
+    // Over all games played with this state
+    unsigned int padHits = 0;
+    unsigned int misses = 0;
+};
+
+// Whether the next update moves the ball along with the song, and so needs the game time in its input
+bool gameIsRunning(const GameState &state);
+
+// Advances the game by one frame. Nothing but the arguments is read or written, so any number of games can be updated
+// at the same time.
+GameEvents updateGameState(GameState &state, const Beatmap &beatmap, const GameRules &rules, const FrameInput &input);
+
+// Whether the center of the ball is over the pad
+bool ballIsAbovePad(const GameState &state);
@@ -1,423 +1,931 @@
 #include "gamelogic.h"
+#include "antiAliasing.hpp"
+#include "ballSimulation.hpp"
+#include "beatmap.hpp"
+#include "deferredRenderer.hpp"
+#include "dynamicResolution.hpp"
+#include "gameState.hpp"
+#include "modelImporter.hpp"
+#include "occlusionCuller.hpp"
+#include "onsetDetector.hpp"
+#include "particleSystem.hpp"
+#include "sceneFile.hpp"
 #include "sceneGraph.hpp"
-#include <SFML/Audio/Sound.hpp>
-#include <SFML/Audio/SoundBuffer.hpp>
+#include "shadowMaps.hpp"
+#include "softwareRenderer.hpp"
+#include <SFML/Audio/Music.hpp>
+#include <algorithm>
 #include <chrono>
+#include <cmath>
 #include <fmt/format.h>
 #include <glad/glad.h>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/vec3.hpp>
 #include <iostream>
+#include <limits>
+#include <random>
+#include <utilities/audioClock.h>
+#include <utilities/framePacer.h>
 #include <utilities/glutils.h>
+#include <utilities/gpuResource.h>
+#include <utilities/gpuRingBuffer.h>
+#include <utilities/gpuTimer.h>
+#include <utilities/latencyHistogram.h>
 #include <utilities/mesh.h>
+#include <utilities/meshRegistry.h>
 #include <utilities/shader.hpp>
 #include <utilities/shapes.h>
+#include <utilities/spscQueue.h>
+#include <utilities/textRenderer.h>
+#include <utilities/threadPool.h>
 #include <utilities/timeutils.h>
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/gtx/transform.hpp>
 
-#include "utilities/glfont.h"
 #include "utilities/imageLoader.hpp"
 
-enum KeyFrameAction
-{
-    BOTTOM,
-    TOP
-};
-
-#include <timestamps.h>
-
-double padPositionX = 0;
-double padPositionZ = 0;
+Beatmap beatmap;
 
-unsigned int currentKeyFrame = 0;
-unsigned int previousKeyFrame = 0;
+// When generating the beatmap while playing, keyframes are analyzed this far ahead of the music
+const double beatmapLookaheadSeconds = 10.0;
+StreamingBeatmapGenerator beatmapGenerator;
 
-SceneNode *rootNode;
-SceneNode *boxNode;
-SceneNode *ballNode;
-SceneNode *padNode;
-SceneNode *textNode;
+SceneNodeHandle rootNode;
+SceneNodeHandle boxNode;
+SceneNodeHandle ballNode;
+SceneNodeHandle padNode;
 
-SceneNode *ballLightNode;
-
-double ballRadius = 3.0f;
+SceneNodeHandle ballLightNode;
 
+glm::mat4 cameraTransform;
 glm::mat4 VP;
+// VP without the sub-pixel jitter of temporal anti-aliasing
+glm::mat4 unjitteredVP;
 glm::mat4 VP_2D;
 
 glm::vec3 cameraPosition(0, 2, -20);
 
-// These are heap allocated, because they should not be initialised at the start of the program
-sf::SoundBuffer *buffer;
-Gloom::Shader *shader;
-sf::Sound *sound;
-
-const glm::vec3 boxDimensions(180, 90, 90);
-const glm::vec3 padDimensions(30, 3, 40);
+// Meshes, images and GPU objects owned by the scene. The scene nodes only refer to them. The meshes are kept on the
+// CPU for occlusion culling and the software renderer, and the images only when there are no GPU objects.
+struct SceneResources
+{
+    Mesh ballMesh;
+    Mesh boxMesh;
+    Mesh padMesh;
+
+    Material boxMaterial;
+    PNGImage boxDiffuseImage;
+    PNGImage boxNormalMapImage;
+    PNGImage boxRoughnessMapImage;
+
+    SharedMeshBuffers ball;
+    SharedMeshBuffers box;
+    SharedMeshBuffers pad;
+
+    GLTexture boxDiffuse;
+    GLTexture boxNormalMap;
+    GLTexture boxRoughnessMap;
+};
 
-glm::vec3 ballPosition(0, ballRadius + padDimensions.y, boxDimensions.z / 2);
-glm::vec3 ballDirection(1, 1, 0.2f);
+// These are heap allocated, because they should not be initialised at the start of the program, and have to be
+// released while the OpenGL context still exists
+SceneResources *sceneResources;
+// Instead of sceneResources, when the scene comes from a file
+SceneFile *sceneFile;
+// Imported with --model, in addition to either of the above
+ImportedModel *importedModel;
+Gloom::Shader *shader;
+TextRenderer *textRenderer;
+Gloom::Shader *depthShader;
+PointShadowMaps *shadowMaps;
+DeferredRenderer *deferredRenderer;
+DynamicResolution *dynamicResolution;
+GpuTimer *gpuFrameTimer;
+AntiAliasing *antiAliasing;
+GpuRingBuffer *frameUploads;
+OcclusionCuller *occlusionCuller;
+ThreadPool *threadPool;
+// Only created when --balls asks for extra balls
+BallSimulation *ballSimulation;
+// Instance data of the simulated balls, in a ring of its own sized for all of them, since there can be far more than
+// fit in frameUploads
+GpuRingBuffer *ballInstances;
+Gloom::Shader *ballShader;
+Gloom::Shader *ballGeometryShader;
+GLint storageBufferAlignment = 16;
+ParticleSystem *particles;
+std::size_t padBounceEmitter;
+// Streamed from disk while playing, and only opened when music is enabled
+sf::Music *music;
 
 CommandLineOptions options;
 
-bool hasStarted = false;
-bool hasLost = false;
-bool jumpedToNextFrame = false;
-bool isPaused = false;
+GameState game;
+GameRules rules;
 
-bool mouseLeftPressed = false;
-bool mouseLeftReleased = false;
-bool mouseRightPressed = false;
-bool mouseRightReleased = false;
+// Switched at runtime with F2
+bool useDeferredShading = false;
+// Switched at runtime with F3
+bool useDepthPrepass = true;
+// Switched at runtime with F4
+bool useOcclusionCulling = true;
 
-// Modify if you want the music to start further on in the track. Measured in seconds.
-const float debug_startTime = 0;
-double totalElapsedTime = debug_startTime;
-double gameElapsedTime = debug_startTime;
-
-double mouseSensitivity = 1.0;
-double lastMouseX = windowWidth / 2;
-double lastMouseY = windowHeight / 2;
-void mouseCallback(GLFWwindow *window, double x, double y)
+// Rebuilt every frame. Opaque geometry is sorted front to back, and the 2D geometry is drawn on top with blending.
+struct DrawItem
 {
-    int windowWidth, windowHeight;
-    glfwGetWindowSize(window, &windowWidth, &windowHeight);
-    glViewport(0, 0, windowWidth, windowHeight);
+    SceneNode *node;
+    float viewDepth;
+};
+std::vector<DrawItem> opaqueDraws;
+std::vector<DrawItem> transparentDraws;
 
-    double deltaX = x - lastMouseX;
-    double deltaY = y - lastMouseY;
+// Modify if you want the music to start further on in the track. Measured in seconds.
+const float debug_startTime = 0;
+double smoothedFrameTime = 1.0 / 60.0;
 
-    padPositionX -= mouseSensitivity * deltaX / windowWidth;
-    padPositionZ -= mouseSensitivity * deltaY / windowHeight;
+FramePacer framePacer;
 
-    if (padPositionX > 1)
-        padPositionX = 1;
-    if (padPositionX < 0)
-        padPositionX = 0;
-    if (padPositionZ > 1)
-        padPositionZ = 1;
-    if (padPositionZ < 0)
-        padPositionZ = 0;
+// Game time follows the music playback position instead of adding up frame times
+AudioClock gameClock;
+// Offsets between the player's clicks and the beats they were aiming for, when calibrating the audio latency
+std::vector<double> calibrationOffsets;
 
-    glfwSetCursorPos(window, windowWidth / 2, windowHeight / 2);
+// Mouse input as the GLFW callbacks saw it, queued until readFrameInput() takes it at the start of the next update.
+// GLFW gives no time for an event, and only runs the callbacks inside glfwPollEvents(), so the time is when the event
+// was polled rather than when it happened. The time the event spent waiting for the poll is not measured.
+struct InputEvent
+{
+    std::chrono::steady_clock::time_point time;
+    bool isButton;
+    // Cursor position for movement
+    double x, y;
+    // Button bit for buttons
+    std::uint32_t button;
+    bool pressed;
+};
+SpscQueue<InputEvent, 4096> inputEvents;
+std::size_t droppedInputEvents = 0;
+
+bool hasMousePosition = false;
+double lastMouseX = 0;
+double lastMouseY = 0;
+// Movement that was too small for a whole 1/mouseDeltaSubpixels pixel yet, carried over to the next frame
+double remainingMouseX = 0;
+double remainingMouseY = 0;
+std::uint32_t heldButtons = 0;
+
+// When the events of the current frame happened, until the frame is on screen
+std::vector<std::chrono::steady_clock::time_point> frameEventTimes;
+// From polling an input event to the swap of the first frame that reacted to it
+LatencyHistogram inputLatency;
+
+// Input of the current frame, read from the window or played back from a recording
+FrameInput frameInput;
+InputRecorder *inputRecorder;
+InputPlayer *inputPlayer;
+
+void mouseCallback(GLFWwindow *, double x, double y)
+{
+    InputEvent event;
+    event.time = std::chrono::steady_clock::now();
+    event.isButton = false;
+    event.x = x;
+    event.y = y;
+    if (!inputEvents.push(event))
+    {
+        droppedInputEvents++;
+    }
 }
 
-unsigned int genTexture(const PNGImage &img)
+void mouseButtonCallback(GLFWwindow *, int button, int action, int)
 {
-    unsigned int textureId;
-    glGenTextures(1, &textureId);
-    glBindTexture(GL_TEXTURE_2D, textureId);
+    InputEvent event;
+    event.time = std::chrono::steady_clock::now();
+    event.isButton = true;
+    event.button = 0;
+    if (button == GLFW_MOUSE_BUTTON_1)
+    {
+        event.button = leftMouseButton;
+    }
+    else if (button == GLFW_MOUSE_BUTTON_2)
+    {
+        event.button = rightMouseButton;
+    }
+    event.pressed = action == GLFW_PRESS;
+    if (event.button != 0 && !inputEvents.push(event))
+    {
+        droppedInputEvents++;
+    }
+}
 
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, img.width, img.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, img.pixels.data());
-    glGenerateMipmap(GL_TEXTURE_2D);
-    glTexParameteri(GL_TEXTURE_2D, GL_NEAREST_MIPMAP_LINEAR, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    return textureId;
+// True only on the frame the key goes down
+bool keyPressed(GLFWwindow *window, int key)
+{
+    static bool wasDown[GLFW_KEY_LAST + 1] = {};
+    bool isDown = glfwGetKey(window, key) == GLFW_PRESS;
+    bool pressed = isDown && !wasDown[key];
+    wasDown[key] = isDown;
+    return pressed;
 }
 
-void initGame(GLFWwindow *window, CommandLineOptions gameOptions)
+// Records how far off the beat the player clicked, and prints the latency that would line the beats up
+void recordCalibrationTap()
 {
-    buffer = new sf::SoundBuffer();
-    if (!buffer->loadFromFile("../res/Hall of the Mountain King.ogg"))
+    double tapTime = gameClock.rawNow();
+    std::size_t keyFrame = beatmap.findKeyFrame(tapTime);
+
+    double closestOffset = 0;
+    bool foundHit = false;
+    for (std::size_t i = keyFrame > 0 ? keyFrame - 1 : 0; i < std::min(keyFrame + 3, beatmap.size()); i++)
+    {
+        double offset = tapTime - beatmap.timestamp(i);
+        if (beatmap.direction(i) == BOTTOM && (!foundHit || std::abs(offset) < std::abs(closestOffset)))
+        {
+            closestOffset = offset;
+            foundHit = true;
+        }
+    }
+    if (!foundHit)
     {
         return;
     }
 
-    options = gameOptions;
-
-    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_HIDDEN);
-    glfwSetCursorPosCallback(window, mouseCallback);
-
-    shader = new Gloom::Shader();
-    shader->makeBasicShader("../res/shaders/simple.vert", "../res/shaders/simple.frag");
-    shader->activate();
-
-    // Create meshes
-    Mesh pad = cube(padDimensions, glm::vec2(30, 40), true);
-    Mesh box = cube(boxDimensions, glm::vec2(90), true, true);
-    Mesh sphere = generateSphere(1.0, 40, 40);
-    Mesh text = generateTextGeometryBuffer("Click to start the game", 39.0f / 29.0f, 500);
-
-    // Fill buffers
-    unsigned int ballVAO = generateBuffer(sphere);
-    unsigned int boxVAO = generateBuffer(box);
-    unsigned int padVAO = generateBuffer(pad);
-    unsigned int textVAO = generateBuffer(text);
+    calibrationOffsets.push_back(closestOffset);
+    std::vector<double> sorted = calibrationOffsets;
+    std::sort(sorted.begin(), sorted.end());
+    double median = sorted[sorted.size() / 2];
 
-    // Load textures
-    PNGImage charmap = loadPNGFile("../res/textures/charmap.png");
-    int charmapTextureID = genTexture(charmap);
+    std::cout << fmt::format("Calibration: {} taps, median offset {:.1f} ms. Suggested option: --audio-latency {:.0f}",
+                             calibrationOffsets.size(), median * 1000.0, median * 1000.0)
+              << std::endl;
+}
 
-    int boxDiffuseTextureID = genTexture(loadPNGFile("../res/textures/Brick03_col.png"));
-    int boxNormalMapTextureID = genTexture(loadPNGFile("../res/textures/Brick03_nrm.png"));
-    int boxRoughnessMapTextureID = genTexture(loadPNGFile("../res/textures/Brick03_rgh.png"));
+// Builds the scene graph and its resources. Without GPU resources no OpenGL context is needed, and the nodes only get
+// the meshes and images the software renderer draws with.
+void createScene(bool withGpuResources)
+{
+    sceneResources = new SceneResources();
+    sceneResources->ballMesh = generateSphere(1.0, 40, 40);
+    sceneResources->boxMesh = cube(boxDimensions, glm::vec2(90), true, true);
+    sceneResources->padMesh = cube(padDimensions, glm::vec2(30, 40), true);
+
+    Material &boxMaterial = sceneResources->boxMaterial;
+    boxMaterial.diffuseFile = "../res/textures/Brick03_col.png";
+    boxMaterial.normalMapFile = "../res/textures/Brick03_nrm.png";
+    boxMaterial.roughnessMapFile = "../res/textures/Brick03_rgh.png";
+    PNGImage boxDiffuse = loadPNGFile(boxMaterial.diffuseFile);
+    PNGImage boxNormalMap = loadPNGFile(boxMaterial.normalMapFile);
+    PNGImage boxRoughnessMap = loadPNGFile(boxMaterial.roughnessMapFile);
+
+    if (withGpuResources)
+    {
+        MeshRegistry &meshes = meshRegistry();
+        sceneResources->ball = meshes.acquire(sphereKey(1.0, 40, 40), sceneResources->ballMesh, "ball", GPU_HERE);
+        sceneResources->box = meshes.acquire(cubeKey(boxDimensions, glm::vec2(90), true, true), sceneResources->boxMesh,
+                                             "box", GPU_HERE);
+        sceneResources->pad =
+            meshes.acquire(cubeKey(padDimensions, glm::vec2(30, 40), true), sceneResources->padMesh, "pad", GPU_HERE);
+
+        sceneResources->boxDiffuse = genTexture(boxDiffuse, "box diffuse", GPU_HERE);
+        sceneResources->boxNormalMap = genTexture(boxNormalMap, "box normal map", GPU_HERE);
+        sceneResources->boxRoughnessMap = genTexture(boxRoughnessMap, "box roughness map", GPU_HERE);
+    }
+    else
+    {
+        sceneResources->boxDiffuseImage = std::move(boxDiffuse);
+        sceneResources->boxNormalMapImage = std::move(boxNormalMap);
+        sceneResources->boxRoughnessMapImage = std::move(boxRoughnessMap);
+    }
 
-    // Construct scene
     rootNode = createSceneNode();
     boxNode = createSceneNode();
     padNode = createSceneNode();
     ballNode = createSceneNode();
-    textNode = createSceneNode();
     ballLightNode = createLightSceneNode();
 
-    rootNode->children.push_back(boxNode);
-    rootNode->children.push_back(padNode);
-    rootNode->children.push_back(ballNode);
-    rootNode->children.push_back(textNode);
+    addChild(rootNode, boxNode);
+    addChild(rootNode, padNode);
+    addChild(rootNode, ballNode);
+    addChild(ballNode, ballLightNode);
 
-    boxNode->nodeType = SceneNodeType::NORMAL_MAPPED_GEOMETRY;
-    boxNode->vertexArrayObjectID = boxVAO;
-    boxNode->VAOIndexCount = box.indices.size();
-    boxNode->textureID = boxDiffuseTextureID;
-    boxNode->normalMapTextureID = boxNormalMapTextureID;
-    boxNode->roughnessMapTextureID = boxRoughnessMapTextureID;
+    // The game logic finds these by name in scene files
+    rootNode->name = "root";
+    boxNode->name = "box";
+    padNode->name = "pad";
+    ballNode->name = "ball";
+    ballLightNode->name = "ball light";
 
-    padNode->vertexArrayObjectID = padVAO;
-    padNode->VAOIndexCount = pad.indices.size();
+    boxNode->nodeType = SceneNodeType::NORMAL_MAPPED_GEOMETRY;
+    boxNode->isStatic = true;
+    boxNode->mesh = &sceneResources->boxMesh;
+    boxNode->material = &sceneResources->boxMaterial;
+    // The cubes are already as simple as occluders get
+    boxNode->occluderMesh = &sceneResources->boxMesh;
+    boxNode->hasBounds = true;
+    meshBounds(sceneResources->boxMesh, boxNode->boundsMin, boxNode->boundsMax);
+
+    padNode->mesh = &sceneResources->padMesh;
+    padNode->occluderMesh = &sceneResources->padMesh;
+    padNode->hasBounds = true;
+    meshBounds(sceneResources->padMesh, padNode->boundsMin, padNode->boundsMax);
+
+    ballNode->mesh = &sceneResources->ballMesh;
+    ballNode->hasBounds = true;
+    meshBounds(sceneResources->ballMesh, ballNode->boundsMin, ballNode->boundsMax);
+
+    if (withGpuResources)
+    {
+        boxNode->vertexArrayObjectID = sceneResources->box->vertexArray.id();
+        boxNode->VAOIndexCount = sceneResources->box->indexCount;
+        boxNode->textureID = sceneResources->boxDiffuse.id();
+        boxNode->normalMapTextureID = sceneResources->boxNormalMap.id();
+        boxNode->roughnessMapTextureID = sceneResources->boxRoughnessMap.id();
 
-    ballNode->vertexArrayObjectID = ballVAO;
-    ballNode->VAOIndexCount = sphere.indices.size();
-    ballNode->children.push_back(ballLightNode);
+        padNode->vertexArrayObjectID = sceneResources->pad->vertexArray.id();
+        padNode->VAOIndexCount = sceneResources->pad->indexCount;
 
-    textNode->vertexArrayObjectID = textVAO;
-    textNode->nodeType = SceneNodeType::GEOMETRY_2D;
-    textNode->VAOIndexCount = text.indices.size();
-    textNode->textureID = charmapTextureID;
+        ballNode->vertexArrayObjectID = sceneResources->ball->vertexArray.id();
+        ballNode->VAOIndexCount = sceneResources->ball->indexCount;
+    }
+    else if (!sceneResources->boxDiffuseImage.pixels.empty() && !sceneResources->boxNormalMapImage.pixels.empty() &&
+             !sceneResources->boxRoughnessMapImage.pixels.empty())
+    {
+        boxNode->diffuseImage = &sceneResources->boxDiffuseImage;
+        boxNode->normalMapImage = &sceneResources->boxNormalMapImage;
+        boxNode->roughnessMapImage = &sceneResources->boxRoughnessMapImage;
+    }
 
     ballNode->position = glm::vec3(0, 0, 0);
     padNode->position = glm::vec3(0, 0, 0);
-    textNode->position = glm::vec3(50, 50, 0);
 
     ballLightNode->lightColor = glm::vec3(1, 1, 1);
-
-    getTimeDeltaSeconds();
-
-    std::cout << fmt::format("Initialized scene with {} SceneNodes.", totalChildren(rootNode)) << std::endl;
-
-    std::cout << "Ready. Click to start!" << std::endl;
 }
 
-void updateFrame(GLFWwindow *window)
+// Takes the scene from a scene file instead, with the nodes the game logic moves around found by name
+bool loadSceneFile(const std::string &fileName)
 {
-    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+    sceneFile = new SceneFile();
+    if (sceneFile->load(fileName))
+    {
+        rootNode = sceneFile->root();
+        boxNode = sceneFile->findNode("box");
+        padNode = sceneFile->findNode("pad");
+        ballNode = sceneFile->findNode("ball");
+        ballLightNode = sceneFile->findNode("ball light");
+        if (boxNode && padNode && ballNode && ballLightNode)
+        {
+            return true;
+        }
+        std::cerr << fileName << " has no box, pad, ball or ball light node" << std::endl;
+        destroySceneNode(sceneFile->root());
+    }
+    delete sceneFile;
+    sceneFile = nullptr;
+    return false;
+}
 
-    double timeDelta = getTimeDeltaSeconds();
+// Adds an imported model below the root, at the origin of the scene and in the model's own units
+void loadModel(const std::string &fileName, bool withGpuResources)
+{
+    importedModel = new ImportedModel();
+    if (!importedModel->load(fileName, *threadPool, withGpuResources))
+    {
+        delete importedModel;
+        importedModel = nullptr;
+        return;
+    }
+    addChild(rootNode, importedModel->root());
+
+    const ImportedModel::Statistics &stats = importedModel->statistics();
+    std::cout << fmt::format("Imported {} meshes with {} vertices and {} triangles from {} in {:.1f} ms ({} shared "
+                             "vertices merged)",
+                             stats.meshCount, stats.vertexCount, stats.triangleCount, fileName,
+                             stats.parseSeconds * 1000.0, stats.mergedVertices)
+              << std::endl;
+}
 
-    const float ballBottomY = boxNode->position.y - (boxDimensions.y / 2) + ballRadius + padDimensions.y;
-    const float ballTopY = boxNode->position.y + (boxDimensions.y / 2) - ballRadius;
-    const float BallVerticalTravelDistance = ballTopY - ballBottomY;
+void destroyScene()
+{
+    destroySceneNode(rootNode);
+    delete sceneResources;
+    delete sceneFile;
+    delete importedModel;
+    sceneResources = nullptr;
+    sceneFile = nullptr;
+    importedModel = nullptr;
+}
 
-    const float cameraWallOffset = 30; // Arbitrary addition to prevent ball from going too much into camera
+bool exportBuiltInScene(const std::string &fileName)
+{
+    createScene(false);
+    bool exported = exportScene(fileName, rootNode);
+    if (exported)
+    {
+        std::cout << fmt::format("Wrote {} SceneNodes to {}", totalChildren(rootNode), fileName) << std::endl;
+    }
+    destroyScene();
+    return exported;
+}
 
-    const float ballMinX = boxNode->position.x - (boxDimensions.x / 2) + ballRadius;
-    const float ballMaxX = boxNode->position.x + (boxDimensions.x / 2) - ballRadius;
-    const float ballMinZ = boxNode->position.z - (boxDimensions.z / 2) + ballRadius;
-    const float ballMaxZ = boxNode->position.z + (boxDimensions.z / 2) - ballRadius - cameraWallOffset;
+// The rules the options ask for, with mouse movement relative to the default window size
+GameRules gameRules(const CommandLineOptions &gameOptions)
+{
+    GameRules gameRules;
+    gameRules.autoplay = gameOptions.enableAutoplay;
+    gameRules.calibrate = gameOptions.calibrate;
+    gameRules.windowWidth = windowWidth;
+    gameRules.windowHeight = windowHeight;
+    gameRules.startTime = debug_startTime;
+    return gameRules;
+}
 
-    if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_1))
+// Records the input of every frame from now on, to be played back with replayRecording()
+void startRecording(const std::string &fileName)
+{
+    if (options.generateBeatmap)
     {
-        mouseLeftPressed = true;
-        mouseLeftReleased = false;
+        // The generated keyframes depend on how fast the track happens to be analyzed
+        std::cerr << "Sessions with a generated beatmap can not be played back, not recording" << std::endl;
+        return;
     }
-    else
+
+    RecordedSession session;
+    session.windowWidth = windowWidth;
+    session.windowHeight = windowHeight;
+    session.autoplay = options.enableAutoplay;
+    session.calibrate = options.calibrate;
+    session.beatmapFile = options.beatmapFile;
+
+    inputRecorder = new InputRecorder();
+    if (!inputRecorder->open(fileName, session))
     {
-        mouseLeftReleased = mouseLeftPressed;
-        mouseLeftPressed = false;
+        delete inputRecorder;
+        inputRecorder = nullptr;
+        return;
     }
-    if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_2))
+    std::cout << "Recording input to " << fileName << std::endl;
+}
+
+void initGame(GLFWwindow *window, CommandLineOptions gameOptions)
+{
+    if (gameOptions.generateBeatmap)
     {
-        mouseRightPressed = true;
-        mouseRightReleased = false;
+        if (!beatmapGenerator.start(gameOptions.trackFile, beatmapLookaheadSeconds))
+        {
+            return;
+        }
     }
-    else
+    else if (!loadBeatmap(gameOptions.beatmapFile, beatmap))
     {
-        mouseRightReleased = mouseRightPressed;
-        mouseRightPressed = false;
+        return;
     }
 
-    if (!hasStarted)
+    options = gameOptions;
+    rules = gameRules(options);
+    gameClock.setOutputLatency(options.audioLatencyMs / 1000.0);
+
+    if (options.enableMusic)
     {
-        if (mouseLeftPressed)
+        // Only reads the header. The track is decoded a little at a time while it plays.
+        music = new sf::Music();
+        if (!music->openFromFile(options.trackFile))
         {
-            if (options.enableMusic)
-            {
-                sound = new sf::Sound();
-                sound->setBuffer(*buffer);
-                sf::Time startTime = sf::seconds(debug_startTime);
-                sound->setPlayingOffset(startTime);
-                sound->play();
-            }
-            totalElapsedTime = debug_startTime;
-            gameElapsedTime = debug_startTime;
-            hasStarted = true;
+            std::cerr << "Could not open " << options.trackFile << ", continuing without music" << std::endl;
+            delete music;
+            music = nullptr;
+            options.enableMusic = false;
         }
-
-        ballPosition.x = ballMinX + (1 - padPositionX) * (ballMaxX - ballMinX);
-        ballPosition.y = ballBottomY;
-        ballPosition.z = ballMinZ + (1 - padPositionZ) * ((ballMaxZ + cameraWallOffset) - ballMinZ);
     }
-    else
+
+    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+    // Unscaled and unaccelerated movement straight from the mouse, where the platform has it
+    if (glfwRawMouseMotionSupported())
     {
-        totalElapsedTime += timeDelta;
-        if (hasLost)
-        {
-            if (mouseLeftReleased)
-            {
-                hasLost = false;
-                hasStarted = false;
-                currentKeyFrame = 0;
-                previousKeyFrame = 0;
-            }
-        }
-        else if (isPaused)
-        {
-            if (mouseRightReleased)
-            {
-                isPaused = false;
-                if (options.enableMusic)
-                {
-                    sound->play();
-                }
-            }
-        }
-        else
-        {
-            gameElapsedTime += timeDelta;
-            if (mouseRightReleased)
-            {
-                isPaused = true;
-                if (options.enableMusic)
-                {
-                    sound->pause();
-                }
-            }
-            // Get the timing for the beat of the song
-            for (unsigned int i = currentKeyFrame; i < keyFrameTimeStamps.size(); i++)
-            {
-                if (gameElapsedTime < keyFrameTimeStamps.at(i))
-                {
-                    continue;
-                }
-                currentKeyFrame = i;
-            }
+        glfwSetInputMode(window, GLFW_RAW_MOUSE_MOTION, GLFW_TRUE);
+    }
+    glfwSetCursorPosCallback(window, mouseCallback);
+    glfwSetMouseButtonCallback(window, mouseButtonCallback);
+    frameEventTimes.reserve(1024);
 
-            jumpedToNextFrame = currentKeyFrame != previousKeyFrame;
-            previousKeyFrame = currentKeyFrame;
+    framePacer.init(options.vsyncMode, options.frameRateLimit);
 
-            double frameStart = keyFrameTimeStamps.at(currentKeyFrame);
-            double frameEnd = keyFrameTimeStamps.at(currentKeyFrame + 1); // Assumes last keyframe at infinity
+    shader = new Gloom::Shader(GPU_HERE);
+    shader->makeBasicShader("../res/shaders/simple.vert", "../res/shaders/simple.frag");
+    shader->activate();
 
-            double elapsedTimeInFrame = gameElapsedTime - frameStart;
-            double frameDuration = frameEnd - frameStart;
-            double fractionFrameComplete = elapsedTimeInFrame / frameDuration;
+    depthShader = new Gloom::Shader(GPU_HERE);
+    depthShader->makeBasicShader("../res/shaders/depthOnly.vert", "../res/shaders/depthOnly.frag");
 
-            double ballYCoord;
+    // Load textures
+    PNGImage charmap = loadPNGFile("../res/textures/charmap.png");
+    // Everything that is uploaded again every frame is allocated from here
+    frameUploads = new GpuRingBuffer();
+    frameUploads->init(2 * 1024 * 1024);
+
+    textRenderer = new TextRenderer();
+    textRenderer->init(charmap, *frameUploads);
+
+    // Matches MAX_LIGHTS in simple.frag
+    shadowMaps = new PointShadowMaps();
+    shadowMaps->init(512, 3);
+
+    deferredRenderer = new DeferredRenderer();
+    deferredRenderer->init();
+
+    // Already checked by main()
+    AntiAliasingMode antiAliasingMode = AntiAliasingMode::Msaa4;
+    parseAntiAliasingMode(options.antiAliasing, antiAliasingMode);
+    antiAliasing = new AntiAliasing();
+    antiAliasing->init(antiAliasingMode);
+
+    // The scene is never rendered at less than half the window size in either direction
+    dynamicResolution = new DynamicResolution();
+    dynamicResolution->init(antiAliasingSamples(antiAliasingMode), options.gpuBudgetMs / 1000.0, 0.5f);
+    gpuFrameTimer = new GpuTimer();
+    gpuFrameTimer->init();
+    useDeferredShading = options.deferredShading;
+
+    threadPool = new ThreadPool();
+    occlusionCuller = new OcclusionCuller();
+    occlusionCuller->init(*threadPool);
+
+    if (options.sceneFile.empty() || !loadSceneFile(options.sceneFile))
+    {
+        createScene(true);
+    }
+    if (!options.modelFile.empty())
+    {
+        loadModel(options.modelFile, true);
+    }
 
-            KeyFrameAction currentOrigin = keyFrameDirections.at(currentKeyFrame);
-            KeyFrameAction currentDestination = keyFrameDirections.at(currentKeyFrame + 1);
+    particles = new ParticleSystem();
+    particles->init(*threadPool, 128 * 1024);
+    particles->setFloor(boxPosition.y - boxDimensions.y / 2);
+    ParticleEmitter trail;
+    trail.node = ballNode;
+    trail.rate = 300;
+    trail.speed = 0;
+    trail.spread = 2;
+    trail.size = 0.6f;
+    trail.color = glm::vec4(0.4, 0.7, 1.0, 0.6);
+    trail.gravityScale = 0;
+    particles->addEmitter(trail);
+    // Sparks from where the ball touches the pad, emitted with burstAt()
+    ParticleEmitter sparks;
+    sparks.speed = 40;
+    sparks.spread = 30;
+    sparks.size = 0.4f;
+    sparks.color = glm::vec4(1.0, 0.7, 0.3, 1.0);
+    padBounceEmitter = particles->addEmitter(sparks);
+
+    if (options.ballCount > 0)
+    {
+        glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &storageBufferAlignment);
+
+        ballShader = new Gloom::Shader(GPU_HERE);
+        ballShader->makeBasicShader("../res/shaders/instanced.vert", "../res/shaders/simple.frag");
+        ballGeometryShader = new Gloom::Shader(GPU_HERE);
+        ballGeometryShader->makeBasicShader("../res/shaders/instanced.vert", "../res/shaders/gbuffer.frag");
+
+        ballSimulation = new BallSimulation();
+        ballSimulation->init(*threadPool, options.ballCount, 1.0f, boxPosition - boxDimensions / 2.0f,
+                             boxPosition + boxDimensions / 2.0f - glm::vec3(0, 0, cameraWallOffset));
+        // Room for the alignment of the one allocation per frame
+        ballInstances = new GpuRingBuffer();
+        ballInstances->init(GLsizeiptr(ballSimulation->size() * 4 * sizeof(float)) + storageBufferAlignment);
+    }
 
-            // Synchronize ball with music
-            if (currentOrigin == BOTTOM && currentDestination == BOTTOM)
-            {
-                ballYCoord = ballBottomY;
-            }
-            else if (currentOrigin == TOP && currentDestination == TOP)
-            {
-                ballYCoord = ballBottomY + BallVerticalTravelDistance;
-            }
-            else if (currentDestination == BOTTOM)
-            {
-                ballYCoord = ballBottomY + BallVerticalTravelDistance * (1 - fractionFrameComplete);
-            }
-            else if (currentDestination == TOP)
-            {
-                ballYCoord = ballBottomY + BallVerticalTravelDistance * fractionFrameComplete;
-            }
+    if (!options.recordFile.empty())
+    {
+        startRecording(options.recordFile);
+    }
 
-            // Make ball move
-            const float ballSpeed = 60.0f;
-            ballPosition.x += timeDelta * ballSpeed * ballDirection.x;
-            ballPosition.y = ballYCoord;
-            ballPosition.z += timeDelta * ballSpeed * ballDirection.z;
+    getTimeDeltaSeconds();
 
-            // Make ball bounce
-            if (ballPosition.x < ballMinX)
-            {
-                ballPosition.x = ballMinX;
-                ballDirection.x *= -1;
-            }
-            else if (ballPosition.x > ballMaxX)
-            {
-                ballPosition.x = ballMaxX;
-                ballDirection.x *= -1;
-            }
-            if (ballPosition.z < ballMinZ)
-            {
-                ballPosition.z = ballMinZ;
-                ballDirection.z *= -1;
-            }
-            else if (ballPosition.z > ballMaxZ)
-            {
-                ballPosition.z = ballMaxZ;
-                ballDirection.z *= -1;
-            }
+    std::cout << fmt::format("Initialized scene with {} SceneNodes.", totalChildren(rootNode)) << std::endl;
+    gpuResources().printBreakdown(std::cout);
+    meshRegistry().printStatistics(std::cout);
 
-            if (options.enableAutoplay)
-            {
-                padPositionX = 1 - (ballPosition.x - ballMinX) / (ballMaxX - ballMinX);
-                padPositionZ = 1 - (ballPosition.z - ballMinZ) / ((ballMaxZ + cameraWallOffset) - ballMinZ);
-            }
+    std::cout << "Ready. Click to start!" << std::endl;
+}
 
-            // Check if the ball is hitting the pad when the ball is at the bottom.
-            // If not, you just lost the game! (hehe)
-            if (jumpedToNextFrame && currentOrigin == BOTTOM && currentDestination == TOP)
+void shutdownGame()
+{
+    beatmapGenerator.stop();
+    if (music != nullptr)
+    {
+        music->stop();
+    }
+
+    if (inputRecorder != nullptr)
+    {
+        if (inputRecorder->close())
+        {
+            std::cout << fmt::format("Recorded {} frames of input in {} bytes", inputRecorder->frameCount(),
+                                     inputRecorder->byteCount())
+                      << std::endl;
+        }
+        else
+        {
+            std::cerr << "Could not write the whole input recording" << std::endl;
+        }
+        delete inputRecorder;
+        inputRecorder = nullptr;
+    }
+
+    const FramePacer::Statistics &pacingStats = framePacer.statistics();
+    if (pacingStats.frameTimes.count() > 0)
+    {
+        const LatencyHistogram &frameTimes = pacingStats.frameTimes;
+        std::cout << fmt::format("Frame times of {} frames: {:.2f} ms median, {:.2f} ms 99th, {:.2f} ms 99.9th "
+                                 "percentile, {:.2f} ms max",
+                                 frameTimes.count(), frameTimes.percentile(0.5) * 1000.0,
+                                 frameTimes.percentile(0.99) * 1000.0, frameTimes.percentile(0.999) * 1000.0,
+                                 frameTimes.maximum() * 1000.0)
+                  << std::endl;
+        std::cout << fmt::format("Frame limiter: {} late frames, {:.2f}s asleep, {:.2f}s spinning",
+                                 pacingStats.lateFrames, pacingStats.sleepSeconds, pacingStats.spinSeconds)
+                  << std::endl;
+    }
+    if (inputLatency.count() > 0)
+    {
+        std::cout << fmt::format("Poll to swap latency of {} input events: {:.2f} ms median, {:.2f} ms 90th, "
+                                 "{:.2f} ms 99th, {:.2f} ms 99.9th percentile, {:.2f} ms max",
+                                 inputLatency.count(), inputLatency.percentile(0.5) * 1000.0,
+                                 inputLatency.percentile(0.9) * 1000.0, inputLatency.percentile(0.99) * 1000.0,
+                                 inputLatency.percentile(0.999) * 1000.0, inputLatency.maximum() * 1000.0)
+                  << std::endl;
+    }
+    if (droppedInputEvents > 0)
+    {
+        std::cerr << fmt::format("{} input events were dropped because the queue was full", droppedInputEvents)
+                  << std::endl;
+    }
+    if (antiAliasing != nullptr)
+    {
+        const AntiAliasing::Statistics &antiAliasingStats = antiAliasing->statistics();
+        for (int i = 0; i < antiAliasingModeCount; i++)
+        {
+            if (antiAliasingStats.frames[i] > 0)
             {
-                double padLeftX = boxNode->position.x - (boxDimensions.x / 2) +
-                                  (1 - padPositionX) * (boxDimensions.x - padDimensions.x);
-                double padRightX = padLeftX + padDimensions.x;
-                double padFrontZ = boxNode->position.z - (boxDimensions.z / 2) +
-                                   (1 - padPositionZ) * (boxDimensions.z - padDimensions.z);
-                double padBackZ = padFrontZ + padDimensions.z;
-
-                if (ballPosition.x < padLeftX || ballPosition.x > padRightX || ballPosition.z < padFrontZ ||
-                    ballPosition.z > padBackZ)
-                {
-                    hasLost = true;
-                    if (options.enableMusic)
-                    {
-                        sound->stop();
-                        delete sound;
-                    }
-                }
+                std::cout << fmt::format("Anti-aliasing {}: {:.2f} ms GPU per frame over {} frames",
+                                         antiAliasingModeName(AntiAliasingMode(i)),
+                                         antiAliasingStats.gpuSeconds[i] / antiAliasingStats.frames[i] * 1000.0,
+                                         antiAliasingStats.frames[i])
+                          << std::endl;
             }
         }
     }
 
+    destroyScene();
+
+    delete textRenderer;
+    delete shadowMaps;
+    delete deferredRenderer;
+    delete dynamicResolution;
+    delete gpuFrameTimer;
+    delete antiAliasing;
+    delete frameUploads;
+    delete occlusionCuller;
+    delete particles;
+    delete ballSimulation;
+    delete ballInstances;
+    delete ballShader;
+    delete ballGeometryShader;
+    delete threadPool;
+    delete shader;
+    delete depthShader;
+    delete music;
+    textRenderer = nullptr;
+    shadowMaps = nullptr;
+    deferredRenderer = nullptr;
+    dynamicResolution = nullptr;
+    gpuFrameTimer = nullptr;
+    antiAliasing = nullptr;
+    frameUploads = nullptr;
+    occlusionCuller = nullptr;
+    particles = nullptr;
+    ballSimulation = nullptr;
+    ballInstances = nullptr;
+    ballShader = nullptr;
+    ballGeometryShader = nullptr;
+    threadPool = nullptr;
+    shader = nullptr;
+    depthShader = nullptr;
+    music = nullptr;
+}
+
+// Sets up the camera and moves the scene nodes to follow the pad and the ball
+void updateCameraAndNodes()
+{
     glm::mat4 projection = glm::perspective(glm::radians(80.0f), float(windowWidth) / float(windowHeight), 0.1f, 350.f);
 
     // Some math to make the camera move in a nice way
-    float lookRotation = -0.6 / (1 + exp(-5 * (padPositionX - 0.5))) + 0.3;
-    glm::mat4 cameraTransform = glm::rotate(0.3f + 0.2f * float(-padPositionZ * padPositionZ), glm::vec3(1, 0, 0)) *
-                                glm::rotate(lookRotation, glm::vec3(0, 1, 0)) * glm::translate(-cameraPosition);
+    float lookRotation = -0.6 / (1 + exp(-5 * (game.padPositionX - 0.5))) + 0.3;
+    cameraTransform = glm::rotate(0.3f + 0.2f * float(-game.padPositionZ * game.padPositionZ), glm::vec3(1, 0, 0)) *
+                      glm::rotate(lookRotation, glm::vec3(0, 1, 0)) * glm::translate(-cameraPosition);
 
+    unjitteredVP = projection * cameraTransform;
+    if (antiAliasing != nullptr)
+    {
+        // Sized for the resolution of the last frame, which the next one is almost always rendered at too
+        glm::vec2 jitter =
+            antiAliasing->projectionJitter(dynamicResolution->renderWidth(), dynamicResolution->renderHeight());
+        projection[2][0] += jitter.x;
+        projection[2][1] += jitter.y;
+    }
     VP = projection * cameraTransform;
 
     // Move and rotate various SceneNodes
-    boxNode->position = {0, -10, -80};
+    boxNode->position = boxPosition;
 
-    ballNode->position = ballPosition;
+    ballNode->position = game.ballPosition;
     ballNode->scale = glm::vec3(ballRadius);
-    ballNode->rotation = {0, totalElapsedTime * 2, 0};
+    ballNode->rotation = {0, game.totalElapsedTime * 2, 0};
 
     padNode->position = {boxNode->position.x - (boxDimensions.x / 2) + (padDimensions.x / 2) +
-                             (1 - padPositionX) * (boxDimensions.x - padDimensions.x),
+                             (1 - game.padPositionX) * (boxDimensions.x - padDimensions.x),
                          boxNode->position.y - (boxDimensions.y / 2) + (padDimensions.y / 2),
                          boxNode->position.z - (boxDimensions.z / 2) + (padDimensions.z / 2) +
-                             (1 - padPositionZ) * (boxDimensions.z - padDimensions.z)};
+                             (1 - game.padPositionZ) * (boxDimensions.z - padDimensions.z)};
+
+    updateNodeTransformations(rootNode.get(), glm::mat4(1.0f));
+}
+
+// Gathers this frame's input from the window
+void readFrameInput(GLFWwindow *window)
+{
+    frameInput = FrameInput();
+    frameInput.timeDeltaNanoseconds = std::llround(getTimeDeltaSeconds() * 1e9);
+
+    // A button pressed and released again since the last frame still counts as held for this one, so no click is
+    // lost. The release is seen on the next frame.
+    std::uint32_t pressedButtons = 0;
+    double mouseX = remainingMouseX;
+    double mouseY = remainingMouseY;
+    InputEvent event;
+    while (inputEvents.pop(event))
+    {
+        frameEventTimes.push_back(event.time);
+        if (event.isButton)
+        {
+            heldButtons = event.pressed ? heldButtons | event.button : heldButtons & ~event.button;
+            pressedButtons |= event.pressed ? event.button : 0;
+        }
+        else
+        {
+            // The cursor is disabled, so the position keeps moving without ever reaching the edge of the window
+            if (hasMousePosition)
+            {
+                mouseX += (event.x - lastMouseX) * mouseDeltaSubpixels;
+                mouseY += (event.y - lastMouseY) * mouseDeltaSubpixels;
+            }
+            hasMousePosition = true;
+            lastMouseX = event.x;
+            lastMouseY = event.y;
+        }
+    }
+    frameInput.mouseDeltaX = std::int32_t(std::lround(mouseX));
+    frameInput.mouseDeltaY = std::int32_t(std::lround(mouseY));
+    remainingMouseX = mouseX - frameInput.mouseDeltaX;
+    remainingMouseY = mouseY - frameInput.mouseDeltaY;
+    frameInput.buttons = heldButtons | pressedButtons;
+
+    if (keyPressed(window, GLFW_KEY_F2))
+    {
+        frameInput.buttons |= toggleDeferredShadingKey;
+    }
+    if (keyPressed(window, GLFW_KEY_F3))
+    {
+        frameInput.buttons |= toggleDepthPrepassKey;
+    }
+    if (keyPressed(window, GLFW_KEY_F4))
+    {
+        frameInput.buttons |= toggleOcclusionCullingKey;
+    }
+}
+
+// The song position for this frame. It comes from the audio device, so it is recorded along with the input.
+void readGameClock()
+{
+    if (options.enableMusic)
+    {
+        gameClock.synchronize(music->getPlayingOffset().asSeconds());
+    }
+    frameInput.hasGameTime = true;
+    frameInput.gameTimeNanoseconds = std::llround(gameClock.now() * 1e9);
+}
+
+// Advances the game by one frame, using nothing from the outside world but frameInput
+void updateGame()
+{
+    double timeDelta = frameInput.timeDeltaNanoseconds / 1e9;
+    smoothedFrameTime += 0.05 * (timeDelta - smoothedFrameTime);
+
+    if (frameInput.buttons & toggleDeferredShadingKey)
+    {
+        useDeferredShading = !useDeferredShading;
+    }
+    if (frameInput.buttons & toggleDepthPrepassKey)
+    {
+        useDepthPrepass = !useDepthPrepass;
+    }
+    if (frameInput.buttons & toggleOcclusionCullingKey)
+    {
+        useOcclusionCulling = !useOcclusionCulling;
+    }
+
+    if (options.generateBeatmap)
+    {
+        beatmapGenerator.setPlaybackPosition(game.gameElapsedTime);
+        beatmapGenerator.poll(beatmap);
+    }
+
+    GameEvents events = updateGameState(game, beatmap, rules, frameInput);
+
+    // The music and the game clock follow what happened in the game
+    if (events.started)
+    {
+        if (options.enableMusic)
+        {
+            music->play();
+            if (debug_startTime > 0)
+            {
+                // Seeking a stream only decodes from the new position onwards
+                music->setPlayingOffset(sf::seconds(debug_startTime));
+            }
+        }
+        gameClock.start(debug_startTime);
+    }
+    if (events.calibrationTap)
+    {
+        recordCalibrationTap();
+    }
+    if (events.paused)
+    {
+        gameClock.pause();
+        if (options.enableMusic)
+        {
+            music->pause();
+        }
+    }
+    if (events.resumed)
+    {
+        gameClock.resume();
+        if (options.enableMusic)
+        {
+            music->play();
+        }
+    }
+    if (events.missed && options.enableMusic)
+    {
+        music->stop();
+    }
+    if (events.padHits > 0 && particles != nullptr)
+    {
+        // The ball has already moved on from the pad by the end of the update
+        particles->burstAt(padBounceEmitter, 400 * events.padHits, events.padHitPosition);
+    }
 
-    updateNodeTransformations(rootNode, glm::mat4(1.0f));
+    if (ballSimulation != nullptr && !game.isPaused)
+    {
+        glm::vec3 padTop = padNode->position + glm::vec3(0, padDimensions.y / 2, 0);
+        glm::vec3 padHalfSize(padDimensions.x / 2, 0, padDimensions.z / 2);
+        ballSimulation->setPad(padTop - padHalfSize, padTop + padHalfSize);
+        ballSimulation->setObstacle(game.ballPosition, ballRadius);
+        ballSimulation->update(timeDelta);
+    }
+
+    updateCameraAndNodes();
+
+    // Emitters follow their nodes, so this has to come after the nodes have moved
+    if (particles != nullptr && !game.isPaused)
+    {
+        particles->update(float(timeDelta));
+    }
+}
+
+void updateFrame(GLFWwindow *window)
+{
+    readFrameInput(window);
+    // Only changes how frames are drawn, so it stays out of the recorded input, which is replayed without drawing
+    if (keyPressed(window, GLFW_KEY_F5))
+    {
+        AntiAliasingMode nextMode = AntiAliasingMode((int(antiAliasing->mode()) + 1) % antiAliasingModeCount);
+        antiAliasing->setMode(nextMode);
+        dynamicResolution->setSamples(antiAliasingSamples(nextMode));
+    }
+    // Only a running game moves along with the song
+    if (gameIsRunning(game))
+    {
+        readGameClock();
+    }
+    updateGame();
+    if (inputRecorder != nullptr)
+    {
+        inputRecorder->write(frameInput);
+    }
 }
 
 void updateNodeTransformations(SceneNode *node, glm::mat4 transformationThusFar)
@@ -442,23 +950,109 @@ void updateNodeTransformations(SceneNode *node, glm::mat4 transformationThusFar)
         break;
     }
 
-    for (SceneNode *child : node->children)
+    for (SceneNodeHandle child : node->children)
     {
-        updateNodeTransformations(child, node->currentTransformationMatrix);
+        updateNodeTransformations(child.get(), node->currentTransformationMatrix);
     }
 }
 
-void renderNode(SceneNode *node)
+void addOccluders(SceneNode *node)
 {
-    glUniformMatrix4fv(shader->getUniformFromName("M"), 1, GL_FALSE, glm::value_ptr(node->currentTransformationMatrix));
-    glUniformMatrix3fv(shader->getUniformFromName("N"), 1, GL_FALSE, glm::value_ptr(node->currentNormalMatrix));
+    if (node->occluderMesh != nullptr)
+    {
+        occlusionCuller->addOccluder(*node->occluderMesh, node->currentTransformationMatrix);
+    }
+    for (SceneNodeHandle child : node->children)
+    {
+        addOccluders(child.get());
+    }
+}
 
+// Adds the drawable nodes below node to the draw lists. Opaque geometry gets its distance from the camera for sorting,
+// and is left out when the occluders hide it.
+void collectDraws(SceneNode *node)
+{
     switch (node->nodeType)
     {
     case GEOMETRY:
-        glUniform1i(shader->getUniformFromName("is2D"), false);
-        glUniform1i(shader->getUniformFromName("useNM"), false);
-        glUniformMatrix4fv(shader->getUniformFromName("VP"), 1, GL_FALSE, glm::value_ptr(VP));
+    case NORMAL_MAPPED_GEOMETRY:
+        if (useOcclusionCulling && node->hasBounds &&
+            !occlusionCuller->isVisible(node->boundsMin, node->boundsMax, node->currentTransformationMatrix))
+        {
+            break;
+        }
+        if (node->vertexArrayObjectID != -1 || node->mesh != nullptr)
+        {
+            glm::vec4 clipPosition = VP * node->currentTransformationMatrix[3];
+            opaqueDraws.push_back({node, clipPosition.w});
+        }
+        break;
+    case GEOMETRY_2D:
+        transparentDraws.push_back({node, 0.0f});
+        break;
+    default:
+        break;
+    }
+
+    for (SceneNodeHandle child : node->children)
+    {
+        collectDraws(child.get());
+    }
+}
+
+void sortDraws()
+{
+    opaqueDraws.clear();
+    transparentDraws.clear();
+
+    if (useOcclusionCulling)
+    {
+        occlusionCuller->beginFrame(VP);
+        addOccluders(rootNode.get());
+        occlusionCuller->rasterize();
+    }
+    collectDraws(rootNode.get());
+
+    // Front to back, so hidden fragments fail the depth test before they are shaded
+    std::sort(opaqueDraws.begin(), opaqueDraws.end(),
+              [](const DrawItem &a, const DrawItem &b) { return a.viewDepth < b.viewDepth; });
+}
+
+// Fills the depth buffer with the opaque geometry, so the shading pass only runs for the closest fragment per pixel
+void renderDepthPrepass()
+{
+    depthShader->activate();
+    glUniformMatrix4fv(depthShader->getUniformFromName("VP"), 1, GL_FALSE, glm::value_ptr(VP));
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+
+    for (const DrawItem &draw : opaqueDraws)
+    {
+        // Nodes that only have a mesh for the software renderer
+        if (draw.node->vertexArrayObjectID == -1)
+        {
+            continue;
+        }
+        glUniformMatrix4fv(depthShader->getUniformFromName("M"), 1, GL_FALSE,
+                           glm::value_ptr(draw.node->currentTransformationMatrix));
+        glBindVertexArray(draw.node->vertexArrayObjectID);
+        glDrawElements(GL_TRIANGLES, draw.node->VAOIndexCount, GL_UNSIGNED_INT, nullptr);
+    }
+
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+}
+
+void drawNode(SceneNode *node, Gloom::Shader *nodeShader)
+{
+    glUniformMatrix4fv(nodeShader->getUniformFromName("M"), 1, GL_FALSE,
+                       glm::value_ptr(node->currentTransformationMatrix));
+    glUniformMatrix3fv(nodeShader->getUniformFromName("N"), 1, GL_FALSE, glm::value_ptr(node->currentNormalMatrix));
+
+    switch (node->nodeType)
+    {
+    case GEOMETRY:
+        glUniform1i(nodeShader->getUniformFromName("is2D"), false);
+        glUniform1i(nodeShader->getUniformFromName("useNM"), false);
+        glUniformMatrix4fv(nodeShader->getUniformFromName("VP"), 1, GL_FALSE, glm::value_ptr(VP));
         if (node->vertexArrayObjectID != -1)
         {
             glBindVertexArray(node->vertexArrayObjectID);
@@ -466,9 +1060,9 @@ void renderNode(SceneNode *node)
         }
         break;
     case NORMAL_MAPPED_GEOMETRY:
-        glUniform1i(shader->getUniformFromName("is2D"), false);
-        glUniform1i(shader->getUniformFromName("useNM"), true);
-        glUniformMatrix4fv(shader->getUniformFromName("VP"), 1, GL_FALSE, glm::value_ptr(VP));
+        glUniform1i(nodeShader->getUniformFromName("is2D"), false);
+        glUniform1i(nodeShader->getUniformFromName("useNM"), true);
+        glUniformMatrix4fv(nodeShader->getUniformFromName("VP"), 1, GL_FALSE, glm::value_ptr(VP));
         glBindTextureUnit(0, node->textureID);
         glBindTextureUnit(1, node->normalMapTextureID);
         glBindTextureUnit(2, node->roughnessMapTextureID);
@@ -479,9 +1073,9 @@ void renderNode(SceneNode *node)
         }
         break;
     case GEOMETRY_2D:
-        glUniform1i(shader->getUniformFromName("is2D"), true);
-        glUniform1i(shader->getUniformFromName("useNM"), false);
-        glUniformMatrix4fv(shader->getUniformFromName("VP"), 1, GL_FALSE, glm::value_ptr(VP_2D));
+        glUniform1i(nodeShader->getUniformFromName("is2D"), true);
+        glUniform1i(nodeShader->getUniformFromName("useNM"), false);
+        glUniformMatrix4fv(nodeShader->getUniformFromName("VP"), 1, GL_FALSE, glm::value_ptr(VP_2D));
         glBindTextureUnit(0, node->textureID);
         if (node->vertexArrayObjectID != -1)
         {
@@ -494,46 +1088,645 @@ void renderNode(SceneNode *node)
     case SPOT_LIGHT:
         break;
     }
-
-    for (SceneNode *child : node->children)
-    {
-        renderNode(child);
-    }
 }
 
-void updateLightsInShader(SceneNode *node)
+void updateLightsInShader(SceneNode *node, Gloom::Shader *lightShader)
 {
     switch (node->nodeType)
     {
     case POINT_LIGHT:
-        glUniform3fv(shader->getUniformFromName(fmt::format("lights[{}].position", std::to_string(node->lightIndex))),
-                     1, glm::value_ptr(glm::vec3(node->currentTransformationMatrix[3])));
-        glUniform3fv(shader->getUniformFromName(fmt::format("lights[{}].color", std::to_string(node->lightIndex))), 1,
-                     glm::value_ptr(glm::vec3(node->lightColor)));
+        glUniform3fv(
+            lightShader->getUniformFromName(fmt::format("lights[{}].position", std::to_string(node->lightIndex))), 1,
+            glm::value_ptr(glm::vec3(node->currentTransformationMatrix[3])));
+        glUniform3fv(lightShader->getUniformFromName(fmt::format("lights[{}].color", std::to_string(node->lightIndex))),
+                     1, glm::value_ptr(glm::vec3(node->lightColor)));
         break;
     default:
         break;
     }
 
-    for (SceneNode *child : node->children)
+    for (SceneNodeHandle child : node->children)
+    {
+        updateLightsInShader(child.get(), lightShader);
+    }
+}
+
+// Everything simple.frag needs besides the material, for shaders using it as their fragment shader
+void setLightingUniforms(Gloom::Shader *lightShader)
+{
+    glUniform1i(lightShader->getUniformFromName("lightsCount"), sceneNodePool.lightCount());
+    glUniform3fv(lightShader->getUniformFromName("cameraPos"), 1, glm::value_ptr(cameraPosition));
+    glUniform3fv(lightShader->getUniformFromName("ballPos"), 1, glm::value_ptr(game.ballPosition));
+    glUniform1f(lightShader->getUniformFromName("ballRadius"), ballRadius);
+    glUniform1i(lightShader->getUniformFromName("useShadowMaps"), !options.analyticShadows);
+    glUniform1f(lightShader->getUniformFromName("shadowFarPlane"), shadowMaps->farPlane());
+    updateLightsInShader(rootNode.get(), lightShader);
+}
+
+// Draws all simulated balls with a single instanced draw call of the ball mesh. Their centers and radii are streamed
+// through the per-frame upload buffer and read by instanced.vert.
+void drawSimulatedBalls(Gloom::Shader *instanceShader)
+{
+    if (ballNode->vertexArrayObjectID == -1)
+    {
+        return;
+    }
+    GLsizeiptr bytes = GLsizeiptr(ballSimulation->size() * 4 * sizeof(float));
+    GpuRingBuffer::Allocation instances = ballInstances->allocate(bytes, storageBufferAlignment);
+    if (!instances)
     {
-        updateLightsInShader(child);
+        // Sized for every ball, so this only happens if the balls are drawn more than once in a frame
+        static bool reported = false;
+        if (!reported)
+        {
+            std::cerr << "The simulated balls did not fit in their instance buffer, and are not drawn" << std::endl;
+            reported = true;
+        }
+        return;
     }
+    ballSimulation->writeInstances(static_cast<float *>(instances.pointer));
+    ballInstances->bindRange(GL_SHADER_STORAGE_BUFFER, 0, instances);
+
+    glUniform1i(instanceShader->getUniformFromName("is2D"), false);
+    glUniform1i(instanceShader->getUniformFromName("useNM"), false);
+    glUniformMatrix4fv(instanceShader->getUniformFromName("VP"), 1, GL_FALSE, glm::value_ptr(VP));
+    glBindVertexArray(ballNode->vertexArrayObjectID);
+    glDrawElementsInstanced(GL_TRIANGLES, ballNode->VAOIndexCount, GL_UNSIGNED_INT, nullptr,
+                            GLsizei(ballSimulation->size()));
+}
+
+void renderHUD(int windowWidth, int windowHeight)
+{
+    const float textHeight = 29.0f;
+    const float margin = 20.0f;
+
+    if (!game.hasStarted)
+    {
+        textRenderer->addText("Click to start the game", glm::vec2(50, 50), textHeight);
+    }
+    else if (game.hasLost)
+    {
+        textRenderer->addText("You missed! Click to try again", glm::vec2(50, 50), textHeight,
+                              glm::vec4(1, 0.4, 0.4, 1));
+    }
+    else if (game.isPaused)
+    {
+        textRenderer->addText("Paused", glm::vec2(50, 50), textHeight);
+    }
+
+    std::string songTime = fmt::format("{:.1f}s", game.gameElapsedTime);
+    textRenderer->addText(songTime, glm::vec2(margin, windowHeight - margin - textHeight), textHeight);
+
+    // Right aligned status lines in the top right corner, from the top down
+    const float statusHeight = textHeight * 0.6f;
+    float statusY = windowHeight - margin - statusHeight;
+    auto addStatusLine = [&](const std::string &text, glm::vec4 color) {
+        float width = textRenderer->textWidth(text, statusHeight);
+        textRenderer->addText(text, glm::vec2(windowWidth - margin - width, statusY), statusHeight, color);
+        statusY -= statusHeight;
+    };
+    const glm::vec4 statusColor(1, 1, 1, 0.7);
+    const glm::vec4 warningColor(1, 0.6, 0.3, 0.7);
+
+    addStatusLine(fmt::format("{:.0f} FPS", 1.0 / smoothedFrameTime), statusColor);
+
+    const FramePacer::Statistics &pacingStats = framePacer.statistics();
+    std::string frameLimit =
+        framePacer.frameRateLimit() > 0 ? fmt::format("{:.0f} FPS limit", framePacer.frameRateLimit()) : "no limit";
+    addStatusLine(fmt::format("Frame time: {:.1f} ms median, {:.1f} ms 99th, {:.1f} ms 99.9th (vsync {}, {})",
+                              pacingStats.frameTimes.percentile(0.5) * 1000.0,
+                              pacingStats.frameTimes.percentile(0.99) * 1000.0,
+                              pacingStats.frameTimes.percentile(0.999) * 1000.0, vsyncModeName(framePacer.vsyncMode()),
+                              frameLimit),
+                  statusColor);
+
+    addStatusLine(fmt::format("GPU {:.1f} MB: buffers {:.1f}, textures {:.1f}", gpuResources().totalBytes() / 1048576.0,
+                              gpuResources().liveBytes(GpuResourceType::Buffer) / 1048576.0,
+                              gpuResources().liveBytes(GpuResourceType::Texture) / 1048576.0),
+                  statusColor);
+
+    if (useDeferredShading)
+    {
+        const DeferredRenderer::Statistics &deferredStats = deferredRenderer->statistics();
+        addStatusLine(fmt::format("Deferred (F2): {} lights, {:.0f}% coverage", deferredStats.lightsDrawn,
+                                  deferredStats.lightCoverage * 100.0f),
+                      statusColor);
+    }
+    else
+    {
+        addStatusLine(fmt::format("Forward (F2), depth pre-pass (F3) {}", useDepthPrepass ? "on" : "off"),
+                      statusColor);
+    }
+
+    if (useOcclusionCulling)
+    {
+        const OcclusionCuller::Statistics &cullingStats = occlusionCuller->statistics();
+        addStatusLine(fmt::format("Occlusion culling (F4): {} of {} culled, {:.2f} ms", cullingStats.nodesCulled,
+                                  cullingStats.nodesTested, cullingStats.rasterSeconds * 1000.0),
+                      statusColor);
+    }
+    else
+    {
+        addStatusLine("Occlusion culling (F4) off", statusColor);
+    }
+
+    const DynamicResolution::Statistics &resolutionStats = dynamicResolution->statistics();
+    std::string gpuBudget = dynamicResolution->budget() > 0
+                                ? fmt::format("{:.1f} ms budget", dynamicResolution->budget() * 1000.0)
+                                : "fixed resolution";
+    addStatusLine(fmt::format("GPU {:.2f} ms, scene at {}x{} ({:.0f}%, {})", resolutionStats.gpuSeconds * 1000.0,
+                              resolutionStats.renderWidth, resolutionStats.renderHeight, resolutionStats.scale * 100.0f,
+                              gpuBudget),
+                  statusColor);
+
+    const AntiAliasing::Statistics &antiAliasingStats = antiAliasing->statistics();
+    int antiAliasingMode = int(antiAliasing->mode());
+    double antiAliasingGpuSeconds = 0;
+    if (antiAliasingStats.frames[antiAliasingMode] > 0)
+    {
+        antiAliasingGpuSeconds =
+            antiAliasingStats.gpuSeconds[antiAliasingMode] / antiAliasingStats.frames[antiAliasingMode];
+    }
+    addStatusLine(fmt::format("Anti-aliasing (F5): {}, {:.2f} ms GPU per frame on average",
+                              antiAliasingModeName(antiAliasing->mode()), antiAliasingGpuSeconds * 1000.0),
+                  statusColor);
+
+    const ParticleSystem::Statistics &particleStats = particles->statistics();
+    addStatusLine(fmt::format("{} particles: {:.2f} ms update, {:.2f} ms upload", particleStats.liveParticles,
+                              particleStats.updateSeconds * 1000.0, particleStats.uploadSeconds * 1000.0),
+                  statusColor);
+
+    if (ballSimulation != nullptr)
+    {
+        const BallSimulation::Statistics &ballStats = ballSimulation->statistics();
+        addStatusLine(fmt::format("{} balls: {} steps, {:.2f} ms per step, {} collisions", ballSimulation->size(),
+                                  ballStats.steps, ballStats.stepSeconds * 1000.0, ballStats.collisions),
+                      statusColor);
+    }
+
+    addStatusLine(fmt::format("Input poll to swap: {:.1f} ms median, {:.1f} ms 99th percentile",
+                              inputLatency.percentile(0.5) * 1000.0, inputLatency.percentile(0.99) * 1000.0),
+                  statusColor);
+
+    const GpuRingBuffer::Statistics &uploadStats = frameUploads->statistics();
+    if (uploadStats.stalls > 0 || uploadStats.failedAllocations > 0)
+    {
+        addStatusLine(fmt::format("{} upload stalls ({:.1f} ms max), {} failed", uploadStats.stalls,
+                                  uploadStats.longestStallSeconds * 1000.0, uploadStats.failedAllocations),
+                      warningColor);
+    }
+
+    textRenderer->render(VP_2D);
+    shader->activate();
 }
 
 void renderFrame(GLFWwindow *window)
 {
+    // Each frame is tagged with its anti-aliasing mode, so their costs can be compared
+    double gpuSeconds;
+    int gpuFrameMode;
+    bool measuredFrame = false;
+    while (gpuFrameTimer->poll(gpuSeconds, gpuFrameMode))
+    {
+        antiAliasing->recordGpuTime(AntiAliasingMode(gpuFrameMode), gpuSeconds);
+        measuredFrame = true;
+    }
+    if (measuredFrame)
+    {
+        dynamicResolution->update(gpuSeconds);
+    }
+    gpuFrameTimer->begin(int(antiAliasing->mode()));
+
+    if (!options.analyticShadows)
+    {
+        shadowMaps->render(rootNode);
+    }
+
     int windowWidth, windowHeight;
     glfwGetWindowSize(window, &windowWidth, &windowHeight);
-    glViewport(0, 0, windowWidth, windowHeight);
 
     VP_2D = glm::ortho(0.0f, (float)windowWidth, 0.0f, (float)windowHeight);
 
-    glUniform1i(shader->getUniformFromName("lightsCount"), SceneNode::lightsCount);
-    glUniform3fv(shader->getUniformFromName("cameraPos"), 1, glm::value_ptr(cameraPosition));
-    glUniform3fv(shader->getUniformFromName("ballPos"), 1, glm::value_ptr(ballPosition));
-    glUniform1f(shader->getUniformFromName("ballRadius"), ballRadius);
+    sortDraws();
+
+    // The 3D scene goes into an offscreen target at the resolution the GPU time allows, and is then scaled up to the
+    // window. The 2D geometry and the HUD are drawn on top at the full resolution.
+    dynamicResolution->beginScene(windowWidth, windowHeight);
+    int sceneWidth = dynamicResolution->renderWidth();
+    int sceneHeight = dynamicResolution->renderHeight();
+
+    if (useDeferredShading)
+    {
+        Gloom::Shader *geometryShader = deferredRenderer->beginGeometryPass(sceneWidth, sceneHeight);
+        for (const DrawItem &draw : opaqueDraws)
+        {
+            drawNode(draw.node, geometryShader);
+        }
+        if (ballSimulation != nullptr)
+        {
+            ballGeometryShader->activate();
+            drawSimulatedBalls(ballGeometryShader);
+        }
+        deferredRenderer->lightingPass(VP, cameraPosition, *shadowMaps, !options.analyticShadows, game.ballPosition,
+                                       ballRadius, dynamicResolution->sceneFramebuffer());
+        particles->render(VP, cameraTransform, deferredRenderer->depthTexture());
+    }
+    else
+    {
+        if (useDepthPrepass)
+        {
+            renderDepthPrepass();
+        }
+
+        // The instanced balls are not part of the pre-pass, so they are drawn while they still write depth. They are
+        // tested against the pre-pass, and the scene nodes behind them are rejected by their depth.
+        shadowMaps->bind(3);
+        if (ballSimulation != nullptr)
+        {
+            ballShader->activate();
+            setLightingUniforms(ballShader);
+            drawSimulatedBalls(ballShader);
+        }
+
+        if (useDepthPrepass)
+        {
+            // The depth buffer is already complete, only fragments matching it get shaded
+            glDepthFunc(GL_LEQUAL);
+            glDepthMask(GL_FALSE);
+        }
+        shader->activate();
+        setLightingUniforms(shader);
+        for (const DrawItem &draw : opaqueDraws)
+        {
+            drawNode(draw.node, shader);
+        }
+
+        glDepthFunc(GL_LESS);
+        glDepthMask(GL_TRUE);
+
+        particles->render(VP, cameraTransform);
+    }
+
+    // The temporal mode reprojects with the depth, which the deferred path keeps in the G-buffer
+    GLuint sceneDepth = useDeferredShading ? deferredRenderer->depthTexture() : dynamicResolution->sceneDepthTexture();
+    GLuint sceneColor = antiAliasing->apply(dynamicResolution->resolve(), sceneDepth, sceneWidth, sceneHeight,
+                                            dynamicResolution->allocatedWidth(), dynamicResolution->allocatedHeight(),
+                                            unjitteredVP);
+    dynamicResolution->upscale(sceneColor);
+    // What follows is drawn at the window resolution, without the temporal blend that evens out the jitter
+    VP = unjitteredVP;
+
+    if (!transparentDraws.empty())
+    {
+        shader->activate();
+        glEnable(GL_BLEND);
+        for (const DrawItem &draw : transparentDraws)
+        {
+            drawNode(draw.node, shader);
+        }
+        glDisable(GL_BLEND);
+    }
+
+    renderHUD(windowWidth, windowHeight);
+
+    frameUploads->endFrame();
+    if (ballInstances != nullptr)
+    {
+        ballInstances->endFrame();
+    }
+    gpuFrameTimer->end();
+}
+
+void waitForNextFrame()
+{
+    framePacer.waitForNextFrame();
+}
+
+void frameSwapped()
+{
+    framePacer.frameSwapped();
+
+    auto now = std::chrono::steady_clock::now();
+    for (std::chrono::steady_clock::time_point eventTime : frameEventTimes)
+    {
+        inputLatency.record(std::chrono::duration<double>(now - eventTime).count());
+    }
+    frameEventTimes.clear();
+}
+
+bool renderSoftwareFrames(CommandLineOptions gameOptions, const std::string &imageFile)
+{
+    options = gameOptions;
+
+    threadPool = new ThreadPool();
+    occlusionCuller = new OcclusionCuller();
+    occlusionCuller->init(*threadPool);
+    createScene(false);
+    if (!options.modelFile.empty())
+    {
+        loadModel(options.modelFile, false);
+    }
+
+    // The ball resting on the pad in the middle of the box, like before the game starts
+    game.padPositionX = 0.5;
+    game.padPositionZ = 0.5;
+    updateCameraAndNodes();
+    game.ballPosition = padNode->position + glm::vec3(0, padDimensions.y / 2 + ballRadius, 0);
+    updateCameraAndNodes();
+    sortDraws();
+
+    SoftwareRenderer::FrameConstants constants;
+    constants.viewProjection = VP;
+    constants.cameraPosition = cameraPosition;
+    constants.ballPosition = game.ballPosition;
+    constants.ballRadius = ballRadius;
+    // Same as the clear color runProgram() sets
+    constants.clearColor = glm::vec4(0.3f, 0.5f, 0.8f, 1.0f);
+    for (int i = 0; i < sceneNodePool.lightCount(); i++)
+    {
+        SceneNodeHandle light = sceneNodePool.light(i);
+        constants.lights.push_back({glm::vec3(light->currentTransformationMatrix[3]), light->lightColor});
+    }
+
+    // Average time per frame, after a first frame to warm up
+    SoftwareRenderer renderer;
+    const int timedFrames = 10;
+    auto timeFrames = [&](ThreadPool &pool) {
+        renderer.init(pool);
+        double totalSeconds = 0;
+        for (int frame = 0; frame <= timedFrames; frame++)
+        {
+            auto start = std::chrono::steady_clock::now();
+            renderer.beginFrame(windowWidth, windowHeight, constants);
+            for (const DrawItem &draw : opaqueDraws)
+            {
+                renderer.drawNode(draw.node);
+            }
+            renderer.finishFrame();
+            if (frame > 0)
+            {
+                totalSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            }
+        }
+        return totalSeconds / timedFrames;
+    };
+
+    ThreadPool singleThread(0);
+    double singleThreadSeconds = timeFrames(singleThread);
+    double poolSeconds = timeFrames(*threadPool);
+
+    const SoftwareRenderer::Statistics &stats = renderer.statistics();
+    std::cout << fmt::format("Software rendered {}x{}: {} triangles, {} rasterized, {} pixels shaded", windowWidth,
+                             windowHeight, stats.trianglesSubmitted, stats.trianglesRasterized, stats.pixelsShaded)
+              << std::endl;
+    std::cout << fmt::format("1 thread: {:.2f} ms per frame, {} threads: {:.2f} ms per frame ({:.1f}x)",
+                             singleThreadSeconds * 1000.0, threadPool->threadCount(), poolSeconds * 1000.0,
+                             singleThreadSeconds / poolSeconds)
+              << std::endl;
+
+    bool saved = savePNGFile(imageFile, renderer.image());
+    if (saved)
+    {
+        std::cout << "Wrote " << imageFile << std::endl;
+    }
+
+    destroyScene();
+    delete occlusionCuller;
+    delete threadPool;
+    occlusionCuller = nullptr;
+    threadPool = nullptr;
+    return saved;
+}
+
+bool replayRecording(CommandLineOptions gameOptions, const std::string &fileName)
+{
+    inputPlayer = new InputPlayer();
+    if (!inputPlayer->open(fileName))
+    {
+        delete inputPlayer;
+        inputPlayer = nullptr;
+        return false;
+    }
+
+    // Everything that changes how the game reacts comes from the recording
+    const RecordedSession &session = inputPlayer->session();
+    options = gameOptions;
+    options.beatmapFile = session.beatmapFile;
+    options.enableAutoplay = session.autoplay;
+    options.calibrate = session.calibrate;
+    options.generateBeatmap = false;
+    options.enableMusic = false;
+    rules = gameRules(options);
+    rules.windowWidth = session.windowWidth;
+    rules.windowHeight = session.windowHeight;
+
+    bool replayed = loadBeatmap(options.beatmapFile, beatmap);
+    if (replayed)
+    {
+        threadPool = new ThreadPool();
+        createScene(false);
+        if (options.ballCount > 0)
+        {
+            ballSimulation = new BallSimulation();
+            ballSimulation->init(*threadPool, options.ballCount, 1.0f, boxPosition - boxDimensions / 2.0f,
+                                 boxPosition + boxDimensions / 2.0f - glm::vec3(0, 0, cameraWallOffset));
+        }
+        updateCameraAndNodes();
+
+        std::size_t frames = 0;
+        double recordedSeconds = 0;
+        double slowestFrameSeconds = 0;
+        double lostAt = -1;
+        auto start = std::chrono::steady_clock::now();
+        while (inputPlayer->next(frameInput))
+        {
+            // The recorded game read the clock exactly when it was running
+            if (gameIsRunning(game) != frameInput.hasGameTime)
+            {
+                std::cerr << fmt::format("Playback diverged from the recording at frame {}", frames) << std::endl;
+                replayed = false;
+                break;
+            }
+
+            auto frameStart = std::chrono::steady_clock::now();
+            bool hadLost = game.hasLost;
+            updateGame();
+            double frameSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - frameStart).count();
+            slowestFrameSeconds = std::max(slowestFrameSeconds, frameSeconds);
+
+            if (game.hasLost && !hadLost)
+            {
+                lostAt = game.gameElapsedTime;
+            }
+            frames++;
+            recordedSeconds += frameInput.timeDeltaNanoseconds / 1e9;
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout << fmt::format("Played back {} frames ({:.1f}s recorded) in {:.3f}s, {:.0f}x real time", frames,
+                                 recordedSeconds, seconds, recordedSeconds / std::max(seconds, 1e-9))
+                  << std::endl;
+        std::cout << fmt::format("Game logic: {:.3f} ms per frame, {:.3f} ms slowest",
+                                 seconds * 1000.0 / std::max<std::size_t>(frames, 1), slowestFrameSeconds * 1000.0)
+                  << std::endl;
+        // Two runs of the same recording have to end in exactly the same state
+        std::cout << fmt::format("Song at {:.3f}s, ball at ({:.3f}, {:.3f}, {:.3f}), pad at ({:.4f}, {:.4f}), {}",
+                                 game.gameElapsedTime, game.ballPosition.x, game.ballPosition.y, game.ballPosition.z,
+                                 game.padPositionX, game.padPositionZ,
+                                 lostAt >= 0 ? fmt::format("last miss at {:.3f}s", lostAt) : "no miss")
+                  << std::endl;
+
+        destroyScene();
+        delete ballSimulation;
+        delete threadPool;
+        ballSimulation = nullptr;
+        threadPool = nullptr;
+    }
+
+    delete inputPlayer;
+    inputPlayer = nullptr;
+    return replayed;
+}
+
+// One session of simulateSessions(), with a player that follows the ball with a limited hand speed and aims a little
+// off every time the ball comes down
+struct SimulatedSession
+{
+    unsigned int seed = 0;
+    GameState state;
+    unsigned int frames = 0;
+    // Song time of the first miss, or of the end of the song
+    double survivedSeconds = 0;
+};
+
+void runSimulatedSession(SimulatedSession &session, const GameRules &sessionRules, double songSeconds)
+{
+    const std::int64_t frameNanoseconds = 1000000000 / 60;
+
+    std::mt19937 random(session.seed);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    GameState &state = session.state;
+    state.ballDirection = glm::vec3(uniform(random) < 0.5 ? -1 : 1, 1, float(uniform(random) - 0.5));
+    // In pad positions, where 1 is the whole way across the box
+    double handSpeed = 0.5 + 2.5 * uniform(random);
+    std::normal_distribution<double> aim(0.0, 0.1 * uniform(random));
+    double aimX = aim(random);
+    double aimZ = aim(random);
+
+    FrameInput input;
+    input.timeDeltaNanoseconds = frameNanoseconds;
+    input.gameTimeNanoseconds = std::llround(sessionRules.startTime * 1e9);
+    bool missed = false;
+    while (input.gameTimeNanoseconds / 1e9 < songSeconds)
+    {
+        // Click on the first frame to start, and let go again
+        input.buttons = session.frames == 0 ? leftMouseButton : 0;
+        input.hasGameTime = gameIsRunning(state);
+        if (input.hasGameTime)
+        {
+            input.gameTimeNanoseconds += frameNanoseconds;
+        }
+
+        // Where the pad would be centered below the ball, as updateCameraAndNodes() places it
+        double targetX = 1 - (state.ballPosition.x - (boxPosition.x - boxDimensions.x / 2) - padDimensions.x / 2) /
+                                 (boxDimensions.x - padDimensions.x);
+        double targetZ = 1 - (state.ballPosition.z - (boxPosition.z - boxDimensions.z / 2) - padDimensions.z / 2) /
+                                 (boxDimensions.z - padDimensions.z);
+        double maximumMove = handSpeed * frameNanoseconds / 1e9;
+        double moveX = glm::clamp(targetX + aimX - state.padPositionX, -maximumMove, maximumMove);
+        double moveZ = glm::clamp(targetZ + aimZ - state.padPositionZ, -maximumMove, maximumMove);
+        input.mouseDeltaX = std::int32_t(std::lround(-moveX * sessionRules.windowWidth * mouseDeltaSubpixels));
+        input.mouseDeltaY = std::int32_t(std::lround(-moveZ * sessionRules.windowHeight * mouseDeltaSubpixels));
+
+        GameEvents events = updateGameState(state, beatmap, sessionRules, input);
+        session.frames++;
+        if (events.missed && !missed)
+        {
+            missed = true;
+            session.survivedSeconds = state.gameElapsedTime;
+        }
+        if (events.missed || events.padHits > 0)
+        {
+            aimX = aim(random);
+            aimZ = aim(random);
+        }
+    }
+    if (!missed)
+    {
+        session.survivedSeconds = state.gameElapsedTime;
+    }
+}
+
+bool simulateSessions(CommandLineOptions gameOptions, int sessionCount)
+{
+    options = gameOptions;
+    bool loaded = options.generateBeatmap ? generateBeatmap(options.trackFile, beatmap)
+                                          : loadBeatmap(options.beatmapFile, beatmap);
+    if (!loaded || beatmap.size() < 2)
+    {
+        return false;
+    }
+    // The last keyframe only marks the end of the song, at a time it never reaches
+    double songSeconds = beatmap.timestamp(beatmap.size() - 2);
+
+    // Misses are counted instead of ending the session, so every session plays the whole song
+    GameRules sessionRules = gameRules(options);
+    sessionRules.keepPlayingAfterMiss = true;
+
+    // Sessions only share the beatmap, which none of them writes to
+    auto runSessions = [&](ThreadPool &pool, std::size_t count, std::vector<SimulatedSession> &sessions) {
+        sessions.assign(count, SimulatedSession());
+        pool.parallelFor(sessions.size(), [&](std::size_t i) {
+            sessions[i].seed = unsigned(i + 1);
+            runSimulatedSession(sessions[i], sessionRules, songSeconds);
+        });
+    };
+
+    ThreadPool pool;
+    std::vector<SimulatedSession> sessions;
+    auto start = std::chrono::steady_clock::now();
+    runSessions(pool, std::size_t(sessionCount), sessions);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::size_t frames = 0;
+    unsigned int hits = 0, misses = 0, fullSongs = 0;
+    for (const SimulatedSession &session : sessions)
+    {
+        std::cout << fmt::format("Session {}: {} hits, {} misses, survived {:.1f}s", session.seed,
+                                 session.state.padHits, session.state.misses, session.survivedSeconds)
+                  << std::endl;
+        frames += session.frames;
+        hits += session.state.padHits;
+        misses += session.state.misses;
+        fullSongs += session.state.misses == 0 ? 1 : 0;
+    }
+
+    // The first few sessions again on a single thread have to end the same way, since no session reads anything
+    // another one writes. A sample is enough to catch shared state, and keeps the check from costing more than the
+    // whole parallel run.
+    const std::size_t checkedSessions = 8;
+    ThreadPool singleThread(0);
+    std::vector<SimulatedSession> serialSessions;
+    runSessions(singleThread, std::min(sessions.size(), checkedSessions), serialSessions);
+    for (std::size_t i = 0; i < serialSessions.size(); i++)
+    {
+        if (serialSessions[i].state.padHits != sessions[i].state.padHits ||
+            serialSessions[i].state.misses != sessions[i].state.misses ||
+            serialSessions[i].state.ballPosition != sessions[i].state.ballPosition)
+        {
+            std::cerr << fmt::format("Session {} ended differently on a single thread", sessions[i].seed) << std::endl;
+            return false;
+        }
+    }
 
-    updateLightsInShader(rootNode);
-    renderNode(rootNode);
+    double playedSeconds = double(sessionCount) * songSeconds;
+    std::cout << fmt::format("{} sessions of {:.1f}s: {} hits, {} misses, {} without a miss", sessionCount,
+                             songSeconds, hits, misses, fullSongs)
+              << std::endl;
+    std::cout << fmt::format("{} threads: {:.3f}s, {:.0f} sessions per minute, {:.0f}x real time, {:.0f} frames per "
+                             "second",
+                             pool.threadCount(), seconds, sessionCount * 60.0 / std::max(seconds, 1e-9),
+                             playedSeconds / std::max(seconds, 1e-9), frames / std::max(seconds, 1e-9))
+              << std::endl;
+    return true;
 }
@@ -2,9 +2,26 @@
 
 #include "sceneGraph.hpp"
 #include <GLFW/glfw3.h>
+#include <string>
 #include <utilities/window.hpp>
 
 void updateNodeTransformations(SceneNode *node, glm::mat4 transformationThusFar);
 void initGame(GLFWwindow *window, CommandLineOptions options);
 void updateFrame(GLFWwindow *window);
 void renderFrame(GLFWwindow *window);
+// Holds the loop back until the next frame is due, if the frame rate is limited
+void waitForNextFrame();
+// Call right after the frame was swapped to the screen, to measure how long input took to get there
+void frameSwapped();
+// Releases everything initGame created. Has to be called while the OpenGL context is still current.
+void shutdownGame();
+// Writes the scene initGame() builds to a scene file, which --scene can load instead. Needs no OpenGL context.
+bool exportBuiltInScene(const std::string &fileName);
+// Renders the scene on the CPU without an OpenGL context, prints how long that takes and writes the image to a PNG file
+bool renderSoftwareFrames(CommandLineOptions options, const std::string &imageFile);
+// Plays back an input recording made with --record without a window, as fast as possible, and prints how long that
+// took and the state the game ended in
+bool replayRecording(CommandLineOptions options, const std::string &fileName);
+// Plays the beatmap from start to end in many sessions at once, spread over all cores without a window or music, each
+// with its own simulated player. Prints how every session went and how long they took.
+bool simulateSessions(CommandLineOptions options, int sessionCount);
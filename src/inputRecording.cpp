@@ -0,0 +1,210 @@
+#include "inputRecording.hpp"
+#include <cstring>
+#include <iostream>
+
+static const std::uint8_t buttonBits = 0x1F;
+static const std::uint8_t mouseMovedBit = 1 << 5;
+static const std::uint8_t gameTimeBit = 1 << 6;
+// The buffer is written out whenever it grows beyond this, so a crash loses at most this much of a session
+static const std::size_t flushSize = 16 * 1024;
+
+static void writeVarint(std::vector<std::uint8_t> &out, std::int64_t value)
+{
+    // Zigzag encoding keeps small negative values short
+    std::uint64_t bits = (std::uint64_t(value) << 1) ^ std::uint64_t(value >> 63);
+    while (bits >= 0x80)
+    {
+        out.push_back(std::uint8_t(bits | 0x80));
+        bits >>= 7;
+    }
+    out.push_back(std::uint8_t(bits));
+}
+
+static bool readVarint(const unsigned char *data, std::size_t size, std::size_t &position, std::int64_t &value)
+{
+    std::uint64_t bits = 0;
+    for (unsigned int shift = 0; shift < 64; shift += 7)
+    {
+        if (position >= size)
+        {
+            return false;
+        }
+        std::uint8_t byte = data[position++];
+        bits |= std::uint64_t(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0)
+        {
+            value = std::int64_t(bits >> 1) ^ -std::int64_t(bits & 1);
+            return true;
+        }
+    }
+    return false;
+}
+
+InputRecorder::~InputRecorder()
+{
+    close();
+}
+
+bool InputRecorder::open(const std::string &fileName, const RecordedSession &session)
+{
+    file.open(fileName, std::ios::binary);
+    if (!file)
+    {
+        std::cerr << "Could not open " << fileName << " for writing" << std::endl;
+        return false;
+    }
+
+    InputRecordingHeader header;
+    std::memcpy(header.magic, inputRecordingMagic, sizeof(inputRecordingMagic));
+    header.version = inputRecordingVersion;
+    header.windowWidth = uint32_t(session.windowWidth);
+    header.windowHeight = uint32_t(session.windowHeight);
+    header.flags = (session.autoplay ? 1 : 0) | (session.calibrate ? 2 : 0);
+    header.beatmapFileLength = uint32_t(session.beatmapFile.size());
+
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(session.beatmapFile.data(), session.beatmapFile.size());
+    bytes = sizeof(header) + session.beatmapFile.size();
+    frames = 0;
+    previous = FrameInput();
+    return bool(file);
+}
+
+void InputRecorder::write(const FrameInput &frame)
+{
+    if (!file.is_open())
+    {
+        return;
+    }
+
+    bool mouseMoved = frame.mouseDeltaX != 0 || frame.mouseDeltaY != 0;
+    std::size_t start = buffer.size();
+    buffer.push_back(std::uint8_t((frame.buttons & buttonBits) | (mouseMoved ? mouseMovedBit : 0) |
+                                  (frame.hasGameTime ? gameTimeBit : 0)));
+
+    writeVarint(buffer, frame.timeDeltaNanoseconds - previous.timeDeltaNanoseconds);
+    if (mouseMoved)
+    {
+        writeVarint(buffer, frame.mouseDeltaX);
+        writeVarint(buffer, frame.mouseDeltaY);
+    }
+    if (frame.hasGameTime)
+    {
+        // While the song plays, the game clock moves about as much as the frame time
+        writeVarint(buffer, frame.gameTimeNanoseconds - previous.gameTimeNanoseconds - frame.timeDeltaNanoseconds);
+        previous.gameTimeNanoseconds = frame.gameTimeNanoseconds;
+    }
+    previous.timeDeltaNanoseconds = frame.timeDeltaNanoseconds;
+
+    frames++;
+    bytes += buffer.size() - start;
+    if (buffer.size() >= flushSize)
+    {
+        flush();
+    }
+}
+
+void InputRecorder::flush()
+{
+    file.write(reinterpret_cast<const char *>(buffer.data()), buffer.size());
+    buffer.clear();
+}
+
+bool InputRecorder::close()
+{
+    if (!file.is_open())
+    {
+        return true;
+    }
+    flush();
+    bool written = bool(file);
+    file.close();
+    return written;
+}
+
+bool InputPlayer::open(const std::string &fileName)
+{
+    if (!file.open(fileName))
+    {
+        std::cerr << "Could not open input recording " << fileName << std::endl;
+        return false;
+    }
+
+    InputRecordingHeader header;
+    if (file.size() < sizeof(header))
+    {
+        std::cerr << "Input recording " << fileName << " is truncated" << std::endl;
+        return false;
+    }
+    std::memcpy(&header, file.data(), sizeof(header));
+
+    if (std::memcmp(header.magic, inputRecordingMagic, sizeof(inputRecordingMagic)) != 0 ||
+        header.version != inputRecordingVersion)
+    {
+        std::cerr << fileName << " is not a supported input recording" << std::endl;
+        return false;
+    }
+    if (file.size() - sizeof(header) < header.beatmapFileLength)
+    {
+        std::cerr << "Input recording " << fileName << " is truncated" << std::endl;
+        return false;
+    }
+
+    recordedSession.windowWidth = int(header.windowWidth);
+    recordedSession.windowHeight = int(header.windowHeight);
+    recordedSession.autoplay = (header.flags & 1) != 0;
+    recordedSession.calibrate = (header.flags & 2) != 0;
+    recordedSession.beatmapFile.assign(reinterpret_cast<const char *>(file.data()) + sizeof(header),
+                                       header.beatmapFileLength);
+
+    position = sizeof(header) + header.beatmapFileLength;
+    previous = FrameInput();
+    return true;
+}
+
+bool InputPlayer::next(FrameInput &frame)
+{
+    const unsigned char *data = file.data();
+    std::size_t size = file.size();
+    if (position >= size)
+    {
+        return false;
+    }
+
+    std::size_t readPosition = position;
+    std::uint8_t flags = data[readPosition++];
+    FrameInput decoded;
+    decoded.buttons = flags & buttonBits;
+    decoded.hasGameTime = (flags & gameTimeBit) != 0;
+
+    std::int64_t value = 0;
+    if (!readVarint(data, size, readPosition, value))
+    {
+        return false;
+    }
+    decoded.timeDeltaNanoseconds = previous.timeDeltaNanoseconds + value;
+    if (flags & mouseMovedBit)
+    {
+        std::int64_t x = 0, y = 0;
+        if (!readVarint(data, size, readPosition, x) || !readVarint(data, size, readPosition, y))
+        {
+            return false;
+        }
+        decoded.mouseDeltaX = std::int32_t(x);
+        decoded.mouseDeltaY = std::int32_t(y);
+    }
+    decoded.gameTimeNanoseconds = previous.gameTimeNanoseconds;
+    if (decoded.hasGameTime)
+    {
+        if (!readVarint(data, size, readPosition, value))
+        {
+            return false;
+        }
+        decoded.gameTimeNanoseconds += value + decoded.timeDeltaNanoseconds;
+    }
+
+    position = readPosition;
+    previous = decoded;
+    frame = decoded;
+    return true;
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <utilities/mappedFile.h>
+#include <vector>
+
+// Everything the game logic reads from the player and from the clocks during one frame. Times are whole nanoseconds
+// and mouse movement is in 1/16 pixels, so a recording holds exactly the values the game ran with.
+struct FrameInput
+{
+    // Wall time since the previous frame
+    std::int64_t timeDeltaNanoseconds = 0;
+    // Cursor movement since the previous frame
+    std::int32_t mouseDeltaX = 0;
+    std::int32_t mouseDeltaY = 0;
+    // Buttons held down, and keys pressed since the previous frame
+    std::uint32_t buttons = 0;
+    // Song position of the game clock. Only frames where the song is playing read the clock.
+    bool hasGameTime = false;
+    std::int64_t gameTimeNanoseconds = 0;
+};
+
+const std::uint32_t leftMouseButton = 1 << 0;
+const std::uint32_t rightMouseButton = 1 << 1;
+const std::uint32_t toggleDeferredShadingKey = 1 << 2;
+const std::uint32_t toggleDepthPrepassKey = 1 << 3;
+const std::uint32_t toggleOcclusionCullingKey = 1 << 4;
+
+const int mouseDeltaSubpixels = 16;
+
+// Binary input recording layout (little endian):
+//
+//   InputRecordingHeader
+//   char    beatmapFile[beatmapFileLength]
+//   frames until the end of the file
+//
+// Every frame starts with a byte of flags: the buttons in the low five bits, then whether the mouse moved and whether
+// the game clock was read. Then follow zigzag encoded variable length integers: the change in frame time from the
+// previous frame, the mouse movement if it moved, and how far the game clock moved beyond the frame time since it was
+// last read. A steady frame without mouse movement takes three bytes.
+struct InputRecordingHeader
+{
+    char magic[4];
+    uint32_t version;
+    // Mouse movement is relative to the window size
+    uint32_t windowWidth;
+    uint32_t windowHeight;
+    // Bit 0 autoplay, bit 1 calibration
+    uint32_t flags;
+    uint32_t beatmapFileLength;
+};
+
+const char inputRecordingMagic[4] = {'G', 'B', 'I', 'R'};
+const uint32_t inputRecordingVersion = 1;
+
+// The options a recorded session has to be played back with
+struct RecordedSession
+{
+    int windowWidth = 0;
+    int windowHeight = 0;
+    bool autoplay = false;
+    bool calibrate = false;
+    std::string beatmapFile;
+};
+
+class InputRecorder
+{
+  public:
+    InputRecorder() = default;
+    ~InputRecorder();
+
+    bool open(const std::string &fileName, const RecordedSession &session);
+    void write(const FrameInput &frame);
+    // Writes out what is still buffered. Returns false if anything failed to be written.
+    bool close();
+
+    std::size_t frameCount() const
+    {
+        return frames;
+    }
+    std::size_t byteCount() const
+    {
+        return bytes;
+    }
+
+  private:
+    InputRecorder(InputRecorder const &) = delete;
+    InputRecorder &operator=(InputRecorder const &) = delete;
+
+    void flush();
+
+    std::ofstream file;
+    std::vector<std::uint8_t> buffer;
+    FrameInput previous;
+    std::size_t frames = 0;
+    std::size_t bytes = 0;
+};
+
+class InputPlayer
+{
+  public:
+    InputPlayer() = default;
+
+    bool open(const std::string &fileName);
+    // Returns false once all frames have been played. A frame cut off at the end of the file is not played.
+    bool next(FrameInput &frame);
+
+    const RecordedSession &session() const
+    {
+        return recordedSession;
+    }
+
+  private:
+    InputPlayer(InputPlayer const &) = delete;
+    InputPlayer &operator=(InputPlayer const &) = delete;
+
+    MappedFile file;
+    RecordedSession recordedSession;
+    std::size_t position = 0;
+    FrameInput previous;
+};
@@ -1,4 +1,8 @@
 // Local headers
+#include "antiAliasing.hpp"
+#include "beatmap.hpp"
+#include "gamelogic.h"
+#include "onsetDetector.hpp"
 #include "program.hpp"
 #include "utilities/window.hpp"
 
@@ -35,7 +39,8 @@ GLFWwindow *initialise()
 
     // Set additional window options
     glfwWindowHint(GLFW_RESIZABLE, windowResizable);
-    glfwWindowHint(GLFW_SAMPLES, windowSamples); // MSAA
+    // The scene is anti-aliased in its own offscreen target
+    glfwWindowHint(GLFW_SAMPLES, 0);
 
     // Create window using GLFW
     GLFWwindow *window = glfwCreateWindow(windowWidth, windowHeight, windowTitle.c_str(), nullptr, nullptr);
@@ -69,6 +74,59 @@ int main(int argc, const char *argb[])
                                                arrrgh::Optional, false);
     const auto &enableAutoplay = parser.add<bool>(
         "autoplay", "Let the game play itself automatically. Useful for testing.", 'a', arrrgh::Optional, false);
+    const auto &beatmapFile = parser.add<std::string>(
+        "beatmap", "Binary beatmap file to play instead of the built in track", 'b', arrrgh::Optional, "");
+    const auto &trackFile = parser.add<std::string>("track", "Music file to play", 't', arrrgh::Optional,
+                                                    "../res/Hall of the Mountain King.ogg");
+    const auto &generateBeatmapFromTrack = parser.add<bool>(
+        "generate-beatmap", "Generate the beatmap from the music instead of using a prepared one", 'g',
+        arrrgh::Optional, false);
+    const auto &audioLatency = parser.add<int>(
+        "audio-latency", "Audio output latency in milliseconds, used to line the ball up with the music", 'l',
+        arrrgh::Optional, 0);
+    const auto &calibrate = parser.add<bool>(
+        "calibrate", "Click along with the beat to measure the audio latency. You cannot lose in this mode.", 'c',
+        arrrgh::Optional, false);
+    const auto &analyticShadows = parser.add<bool>(
+        "analytic-shadows", "Only let the ball cast a shadow, computed analytically instead of with shadow maps", 's',
+        arrrgh::Optional, false);
+    const auto &deferredShading = parser.add<bool>(
+        "deferred", "Start with deferred shading instead of forward shading. F2 switches while playing.", 'd',
+        arrrgh::Optional, false);
+    const auto &exportBeatmapFile = parser.add<std::string>(
+        "export-beatmap", "Write the selected beatmap to a binary beatmap file and exit", 'x', arrrgh::Optional, "");
+    const auto &sceneFile = parser.add<std::string>(
+        "scene", "Scene file to load instead of building the scene in code", 'n', arrrgh::Optional, "");
+    const auto &modelFile = parser.add<std::string>(
+        "model", "Wavefront OBJ, glTF or GLB model to import into the scene", 'o', arrrgh::Optional, "");
+    const auto &ballCount = parser.add<int>(
+        "balls", "Number of extra balls bouncing around in the box, simulated on all cores", 'k', arrrgh::Optional, 0);
+    const auto &recordFile = parser.add<std::string>(
+        "record", "Record the mouse, keys and frame times of the session to a file", 'w', arrrgh::Optional, "");
+    const auto &replayFile = parser.add<std::string>(
+        "replay", "Play back a session recorded with --record without a window, as fast as possible, and exit", 'p',
+        arrrgh::Optional, "");
+    const auto &vsync = parser.add<std::string>(
+        "vsync", "Wait for vertical blank before swapping: on, off or adaptive (tears instead of stuttering when late)",
+        'v', arrrgh::Optional, "on");
+    const auto &frameRateLimit = parser.add<int>(
+        "fps-limit", "Start frames no more often than this many times per second, 0 for no limit", 'f',
+        arrrgh::Optional, 0);
+    const auto &gpuBudget = parser.add<int>(
+        "gpu-budget", "Milliseconds of GPU time per frame to hold by lowering the scene resolution, 0 to keep it full",
+        'j', arrrgh::Optional, 0);
+    const auto &antiAliasing = parser.add<std::string>(
+        "aa", "Anti-aliasing to start with: off, msaa2, msaa4, msaa8, fxaa or taa. F5 switches while playing.", 'q',
+        arrrgh::Optional, "msaa4");
+    const auto &simulateCount = parser.add<int>(
+        "simulate", "Play the beatmap in this many sessions with simulated players on all cores, print how they went "
+                    "and exit",
+        'u', arrrgh::Optional, 0);
+    const auto &exportSceneFile = parser.add<std::string>(
+        "export-scene", "Write the built in scene to a scene file and exit", 'e', arrrgh::Optional, "");
+    const auto &softwareRenderFile = parser.add<std::string>(
+        "software-render", "Render the scene on the CPU into a PNG file, print the timings and exit. Needs no GPU.",
+        'r', arrrgh::Optional, "");
 
     // If you want to add more program arguments, define them here,
     // but do not request their value here (they have not been parsed yet at this point).
@@ -93,6 +151,67 @@ int main(int argc, const char *argb[])
     CommandLineOptions options;
     options.enableMusic = enableMusic.value();
     options.enableAutoplay = enableAutoplay.value();
+    options.beatmapFile = beatmapFile.value();
+    options.trackFile = trackFile.value();
+    options.generateBeatmap = generateBeatmapFromTrack.value();
+    options.audioLatencyMs = audioLatency.value();
+    options.calibrate = calibrate.value();
+    options.analyticShadows = analyticShadows.value();
+    options.deferredShading = deferredShading.value();
+    options.sceneFile = sceneFile.value();
+    options.modelFile = modelFile.value();
+    options.ballCount = ballCount.value();
+    options.recordFile = recordFile.value();
+    options.frameRateLimit = frameRateLimit.value();
+    options.gpuBudgetMs = gpuBudget.value();
+    options.antiAliasing = antiAliasing.value();
+    if (!parseVsyncMode(vsync.value(), options.vsyncMode))
+    {
+        std::cerr << "Unknown vsync mode " << vsync.value() << ", expected on, off or adaptive" << std::endl;
+        parser.show_usage(std::cerr);
+        exit(1);
+    }
+    AntiAliasingMode antiAliasingMode;
+    if (!parseAntiAliasingMode(options.antiAliasing, antiAliasingMode))
+    {
+        std::cerr << "Unknown anti-aliasing mode " << options.antiAliasing
+                  << ", expected off, msaa2, msaa4, msaa8, fxaa or taa" << std::endl;
+        parser.show_usage(std::cerr);
+        exit(1);
+    }
+
+    if (!exportBeatmapFile.value().empty())
+    {
+        Beatmap beatmap;
+        bool loaded = options.generateBeatmap ? generateBeatmap(options.trackFile, beatmap)
+                                              : loadBeatmap(options.beatmapFile, beatmap);
+        if (!loaded || !beatmap.saveToFile(exportBeatmapFile.value()))
+        {
+            return EXIT_FAILURE;
+        }
+        std::cout << "Wrote " << beatmap.size() << " keyframes to " << exportBeatmapFile.value() << std::endl;
+        return EXIT_SUCCESS;
+    }
+
+    if (!exportSceneFile.value().empty())
+    {
+        return exportBuiltInScene(exportSceneFile.value()) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (!replayFile.value().empty())
+    {
+        return replayRecording(options, replayFile.value()) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (simulateCount.value() > 0)
+    {
+        return simulateSessions(options, simulateCount.value()) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (!softwareRenderFile.value().empty())
+    {
+        return renderSoftwareFrames(options, softwareRenderFile.value()) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
 
     // Initialise window using GLFW
     GLFWwindow *window = initialise();
@@ -0,0 +1,1200 @@
+#include "modelImporter.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fmt/format.h>
+#include <glad/glad.h>
+#include <iostream>
+#include <unordered_map>
+#include <utilities/json.h>
+#include <utilities/mappedFile.h>
+
+// A node as the parsers see it, before any scene nodes or GPU objects exist
+struct ModelNode
+{
+    std::string name;
+    // Parents come before their children, -1 for nodes directly below the model's root
+    int parent = -1;
+    int mesh = -1;
+    int material = -1;
+    glm::vec3 position = glm::vec3(0);
+    glm::vec3 rotation = glm::vec3(0);
+    glm::vec3 scale = glm::vec3(1);
+};
+
+struct ModelData
+{
+    std::vector<ModelNode> nodes;
+    std::vector<Mesh> meshes;
+    std::vector<Material> materials;
+    std::size_t mergedVertices = 0;
+};
+
+static const char *skipSpaces(const char *text, const char *end)
+{
+    while (text < end && (*text == ' ' || *text == '\t'))
+    {
+        text++;
+    }
+    return text;
+}
+
+static bool isDigit(char character)
+{
+    return character >= '0' && character <= '9';
+}
+
+// Powers of ten that are exact in a double
+static const double exactPowersOfTen[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                          1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+// Parses a decimal number without reading past end, and returns where it stopped, or nullptr if there is no number.
+// Up to 19 significant digits go into an integer mantissa, which is scaled by a single exact power of ten in the
+// common case. That is far more precise than the float the value ends up in, and several times faster than strtod.
+static const char *parseFloat(const char *text, const char *end, float &value)
+{
+    bool isNegative = false;
+    if (text < end && (*text == '-' || *text == '+'))
+    {
+        isNegative = *text == '-';
+        text++;
+    }
+
+    uint64_t mantissa = 0;
+    int significantDigits = 0;
+    int exponent = 0;
+    bool hasDigits = false;
+    for (; text < end && isDigit(*text); text++)
+    {
+        hasDigits = true;
+        if (significantDigits < 19)
+        {
+            mantissa = mantissa * 10 + uint64_t(*text - '0');
+            significantDigits += mantissa != 0;
+        }
+        else
+        {
+            exponent++;
+        }
+    }
+    if (text < end && *text == '.')
+    {
+        for (text++; text < end && isDigit(*text); text++)
+        {
+            hasDigits = true;
+            if (significantDigits < 19)
+            {
+                mantissa = mantissa * 10 + uint64_t(*text - '0');
+                significantDigits += mantissa != 0;
+                exponent--;
+            }
+        }
+    }
+    if (!hasDigits)
+    {
+        return nullptr;
+    }
+    if (text < end && (*text == 'e' || *text == 'E'))
+    {
+        const char *exponentText = text + 1;
+        bool isNegativeExponent = false;
+        if (exponentText < end && (*exponentText == '-' || *exponentText == '+'))
+        {
+            isNegativeExponent = *exponentText == '-';
+            exponentText++;
+        }
+        if (exponentText < end && isDigit(*exponentText))
+        {
+            int explicitExponent = 0;
+            for (; exponentText < end && isDigit(*exponentText); exponentText++)
+            {
+                // Anything this large is zero or infinite as a float anyway
+                explicitExponent = std::min(explicitExponent * 10 + (*exponentText - '0'), 10000);
+            }
+            exponent += isNegativeExponent ? -explicitExponent : explicitExponent;
+            text = exponentText;
+        }
+    }
+
+    double result = double(mantissa);
+    if (mantissa == 0)
+    {
+        result = 0;
+    }
+    else if (exponent >= 0 && exponent <= 22)
+    {
+        result *= exactPowersOfTen[exponent];
+    }
+    else if (exponent < 0 && exponent >= -22)
+    {
+        result /= exactPowersOfTen[-exponent];
+    }
+    else
+    {
+        result *= std::pow(10.0, double(exponent));
+    }
+    value = float(isNegative ? -result : result);
+    return text;
+}
+
+// Normals for meshes that come without them, averaged over the triangles sharing a vertex and weighted by their area
+static void computeNormals(Mesh &mesh)
+{
+    mesh.normals.assign(mesh.vertices.size(), glm::vec3(0));
+    for (std::size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+    {
+        const unsigned int *index = &mesh.indices[i];
+        glm::vec3 faceNormal = glm::cross(mesh.vertices[index[1]] - mesh.vertices[index[0]],
+                                          mesh.vertices[index[2]] - mesh.vertices[index[0]]);
+        for (int corner = 0; corner < 3; corner++)
+        {
+            mesh.normals[index[corner]] += faceNormal;
+        }
+    }
+    for (glm::vec3 &normal : mesh.normals)
+    {
+        float length = glm::length(normal);
+        normal = length > 0 ? normal / length : glm::vec3(0, 1, 0);
+    }
+}
+
+// One corner of an OBJ face
+struct ObjCorner
+{
+    // Zero based position, texture coordinate and normal indices. Negative indices in the file count back from the
+    // last element defined, so until the chunks are put together, those are relative to the start of the chunk.
+    int64_t index[3];
+    uint8_t isPresent[3];
+    uint8_t isRelative[3];
+};
+
+// A piece of an OBJ file that starts and ends on a line boundary, parsed independently of the others
+struct ObjChunk
+{
+    const char *begin = nullptr;
+    const char *end = nullptr;
+
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec2> textureCoordinates;
+    std::vector<glm::vec3> normals;
+    std::vector<ObjCorner> corners;
+    std::vector<uint32_t> faceSizes;
+
+    // Number of elements of each kind in the earlier chunks
+    std::size_t bases[3] = {0, 0, 0};
+
+    std::size_t lineCount = 0;
+    // Where parsing stopped, with the line relative to the start of the chunk
+    const char *error = nullptr;
+    std::size_t errorLine = 0;
+};
+
+static bool startsWithKeyword(const char *text, const char *end, const char *keyword)
+{
+    std::size_t length = std::strlen(keyword);
+    return std::size_t(end - text) > length && std::memcmp(text, keyword, length) == 0 &&
+           (text[length] == ' ' || text[length] == '\t');
+}
+
+static const char *parseFloats(const char *text, const char *end, float *values, int count)
+{
+    for (int i = 0; i < count && text != nullptr; i++)
+    {
+        text = parseFloat(skipSpaces(text, end), end, values[i]);
+    }
+    return text;
+}
+
+// Parses one face corner like "7", "7/3", "7//2" or "7/3/2"
+static const char *parseCorner(const char *text, const char *end, ObjChunk &chunk, ObjCorner &corner)
+{
+    const std::size_t elementCounts[3] = {chunk.positions.size(), chunk.textureCoordinates.size(),
+                                          chunk.normals.size()};
+    for (int attribute = 0; attribute < 3; attribute++)
+    {
+        corner.isPresent[attribute] = false;
+        corner.isRelative[attribute] = false;
+        corner.index[attribute] = -1;
+        if (attribute > 0)
+        {
+            if (text >= end || *text != '/')
+            {
+                continue;
+            }
+            text++;
+        }
+
+        bool isNegative = text < end && *text == '-';
+        const char *digits = isNegative ? text + 1 : text;
+        int64_t value = 0;
+        for (text = digits; text < end && isDigit(*text) && value < (int64_t(1) << 40); text++)
+        {
+            value = value * 10 + (*text - '0');
+        }
+        if (text == digits)
+        {
+            // Only the texture coordinate may be left out, as in "7//2"
+            if (attribute == 1 && text < end && *text == '/')
+            {
+                continue;
+            }
+            return nullptr;
+        }
+        if (value == 0)
+        {
+            return nullptr;
+        }
+        corner.isPresent[attribute] = true;
+        corner.isRelative[attribute] = isNegative;
+        corner.index[attribute] = isNegative ? int64_t(elementCounts[attribute]) - value : value - 1;
+    }
+    return text;
+}
+
+static void parseObjChunk(ObjChunk &chunk)
+{
+    const char *line = chunk.begin;
+    while (line < chunk.end)
+    {
+        const char *lineEnd = static_cast<const char *>(std::memchr(line, '\n', std::size_t(chunk.end - line)));
+        const char *next = lineEnd != nullptr ? lineEnd + 1 : chunk.end;
+        if (lineEnd == nullptr)
+        {
+            lineEnd = chunk.end;
+        }
+        if (lineEnd > line && lineEnd[-1] == '\r')
+        {
+            lineEnd--;
+        }
+        chunk.lineCount++;
+
+        const char *text = skipSpaces(line, lineEnd);
+        bool isValid = true;
+        float values[3] = {0, 0, 0};
+        if (startsWithKeyword(text, lineEnd, "v"))
+        {
+            // An optional w or vertex color may follow, which are not used
+            isValid = parseFloats(text + 1, lineEnd, values, 3) != nullptr;
+            chunk.positions.emplace_back(values[0], values[1], values[2]);
+        }
+        else if (startsWithKeyword(text, lineEnd, "vt"))
+        {
+            // v is optional
+            const char *afterU = parseFloats(text + 2, lineEnd, values, 1);
+            isValid = afterU != nullptr;
+            if (isValid)
+            {
+                parseFloats(afterU, lineEnd, values + 1, 1);
+            }
+            chunk.textureCoordinates.emplace_back(values[0], values[1]);
+        }
+        else if (startsWithKeyword(text, lineEnd, "vn"))
+        {
+            isValid = parseFloats(text + 2, lineEnd, values, 3) != nullptr;
+            chunk.normals.emplace_back(values[0], values[1], values[2]);
+        }
+        else if (startsWithKeyword(text, lineEnd, "f"))
+        {
+            uint32_t cornerCount = 0;
+            for (text = skipSpaces(text + 1, lineEnd); text < lineEnd; text = skipSpaces(text, lineEnd))
+            {
+                ObjCorner corner;
+                text = parseCorner(text, lineEnd, chunk, corner);
+                isValid = text != nullptr && (text == lineEnd || *text == ' ' || *text == '\t');
+                if (!isValid)
+                {
+                    break;
+                }
+                chunk.corners.push_back(corner);
+                cornerCount++;
+            }
+            isValid = isValid && cornerCount >= 3;
+            chunk.faceSizes.push_back(cornerCount);
+        }
+        // Everything else, like comments, groups, smoothing groups and materials, is not used
+
+        if (!isValid)
+        {
+            chunk.error = "Malformed line";
+            chunk.errorLine = chunk.lineCount;
+            return;
+        }
+        line = next;
+    }
+}
+
+// Open addressing from (position, texture coordinate, normal) index triples to the vertex made for them
+class CornerMap
+{
+  public:
+    explicit CornerMap(std::size_t expectedCount)
+    {
+        std::size_t capacity = 16;
+        while (capacity < expectedCount * 2)
+        {
+            capacity *= 2;
+        }
+        slots.assign(capacity, uint32_t(empty));
+    }
+
+    // The vertex for the triple, or the one passed in if the triple has not been seen before
+    uint32_t findOrAdd(const int64_t (&key)[3], uint32_t newVertex)
+    {
+        uint64_t hash = uint64_t(key[0]) * 0x9E3779B97F4A7C15ull ^ uint64_t(key[1]) * 0xC2B2AE3D27D4EB4Full ^
+                        uint64_t(key[2]) * 0x165667B19E3779F9ull;
+        hash ^= hash >> 29;
+        std::size_t mask = slots.size() - 1;
+        for (std::size_t slot = std::size_t(hash) & mask;; slot = (slot + 1) & mask)
+        {
+            if (slots[slot] == empty)
+            {
+                slots[slot] = newVertex;
+                keys.push_back({key[0], key[1], key[2]});
+                return newVertex;
+            }
+            const Key &existing = keys[slots[slot]];
+            if (existing.index[0] == key[0] && existing.index[1] == key[1] && existing.index[2] == key[2])
+            {
+                return slots[slot];
+            }
+        }
+    }
+
+  private:
+    static const uint32_t empty = ~0u;
+
+    struct Key
+    {
+        int64_t index[3];
+    };
+
+    std::vector<uint32_t> slots;
+    // Indexed by vertex
+    std::vector<Key> keys;
+};
+
+// Reads a Wavefront OBJ file into a single mesh. The file is split into chunks on line boundaries that are parsed in
+// parallel, then the chunks' relative indices are resolved, and finally face corners are merged into shared vertices.
+static bool importObj(const std::string &fileName, ThreadPool &pool, ModelData &model)
+{
+    MappedFile file;
+    if (!file.open(fileName))
+    {
+        std::cerr << "Could not open " << fileName << std::endl;
+        return false;
+    }
+    const char *text = reinterpret_cast<const char *>(file.data());
+    const char *textEnd = text + file.size();
+
+    // Several chunks per thread even out lines that take longer to parse than others
+    const std::size_t minimumChunkSize = 256 * 1024;
+    std::size_t chunkCount = std::max<std::size_t>(
+        1, std::min<std::size_t>(file.size() / minimumChunkSize, std::size_t(pool.threadCount()) * 8));
+    std::vector<ObjChunk> chunks(chunkCount);
+    const char *chunkBegin = text;
+    for (std::size_t i = 0; i < chunkCount; i++)
+    {
+        const char *chunkEnd = textEnd;
+        if (i + 1 < chunkCount)
+        {
+            chunkEnd = std::max(chunkBegin, text + file.size() * (i + 1) / chunkCount);
+            const char *newline =
+                static_cast<const char *>(std::memchr(chunkEnd, '\n', std::size_t(textEnd - chunkEnd)));
+            chunkEnd = newline != nullptr ? newline + 1 : textEnd;
+        }
+        chunks[i].begin = chunkBegin;
+        chunks[i].end = chunkEnd;
+        chunkBegin = chunkEnd;
+    }
+
+    pool.parallelFor(chunkCount, [&](std::size_t i) { parseObjChunk(chunks[i]); });
+
+    std::size_t totals[3] = {0, 0, 0};
+    std::size_t cornerCount = 0;
+    std::size_t lineBase = 0;
+    for (ObjChunk &chunk : chunks)
+    {
+        if (chunk.error != nullptr)
+        {
+            std::cerr << fmt::format("{}:{}: {}", fileName, lineBase + chunk.errorLine, chunk.error) << std::endl;
+            return false;
+        }
+        lineBase += chunk.lineCount;
+        const std::size_t counts[3] = {chunk.positions.size(), chunk.textureCoordinates.size(), chunk.normals.size()};
+        for (int attribute = 0; attribute < 3; attribute++)
+        {
+            chunk.bases[attribute] = totals[attribute];
+            totals[attribute] += counts[attribute];
+        }
+        cornerCount += chunk.corners.size();
+    }
+    if (totals[0] == 0 || cornerCount == 0)
+    {
+        std::cerr << fileName << " has no faces" << std::endl;
+        return false;
+    }
+
+    std::atomic<bool> hasInvalidIndex{false};
+    std::atomic<bool> hasAllNormals{true};
+    pool.parallelFor(chunkCount, [&](std::size_t i) {
+        for (ObjCorner &corner : chunks[i].corners)
+        {
+            for (int attribute = 0; attribute < 3; attribute++)
+            {
+                if (!corner.isPresent[attribute])
+                {
+                    continue;
+                }
+                if (corner.isRelative[attribute])
+                {
+                    corner.index[attribute] += int64_t(chunks[i].bases[attribute]);
+                }
+                if (corner.index[attribute] < 0 || uint64_t(corner.index[attribute]) >= totals[attribute])
+                {
+                    hasInvalidIndex = true;
+                }
+            }
+            if (!corner.isPresent[2])
+            {
+                hasAllNormals = false;
+            }
+        }
+    });
+    if (hasInvalidIndex)
+    {
+        std::cerr << fileName << " refers to vertices that do not exist" << std::endl;
+        return false;
+    }
+
+    // The chunks' elements are only concatenated now that nothing refers to them by chunk anymore
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec2> textureCoordinates;
+    std::vector<glm::vec3> normals;
+    positions.reserve(totals[0]);
+    textureCoordinates.reserve(totals[1]);
+    normals.reserve(totals[2]);
+    for (ObjChunk &chunk : chunks)
+    {
+        positions.insert(positions.end(), chunk.positions.begin(), chunk.positions.end());
+        textureCoordinates.insert(textureCoordinates.end(), chunk.textureCoordinates.begin(),
+                                  chunk.textureCoordinates.end());
+        normals.insert(normals.end(), chunk.normals.begin(), chunk.normals.end());
+    }
+
+    // Corners only share a vertex when all three indices match. Without normals for every corner they are computed
+    // afterwards, and leaving the normal out of the key lets triangles around a position share it for smooth shading.
+    model.meshes.emplace_back();
+    Mesh &mesh = model.meshes.back();
+    mesh.vertices.reserve(totals[0]);
+    mesh.textureCoordinates.reserve(totals[0]);
+    if (hasAllNormals)
+    {
+        mesh.normals.reserve(totals[0]);
+    }
+    CornerMap cornerMap(cornerCount);
+    std::vector<unsigned int> faceVertices;
+    for (const ObjChunk &chunk : chunks)
+    {
+        const ObjCorner *corner = chunk.corners.data();
+        for (uint32_t faceSize : chunk.faceSizes)
+        {
+            faceVertices.clear();
+            for (uint32_t i = 0; i < faceSize; i++, corner++)
+            {
+                int64_t key[3] = {corner->index[0], corner->index[1], hasAllNormals ? corner->index[2] : -1};
+                uint32_t vertex = cornerMap.findOrAdd(key, uint32_t(mesh.vertices.size()));
+                if (vertex == mesh.vertices.size())
+                {
+                    mesh.vertices.push_back(positions[std::size_t(key[0])]);
+                    mesh.textureCoordinates.push_back(key[1] >= 0 ? textureCoordinates[std::size_t(key[1])]
+                                                                  : glm::vec2(0));
+                    if (hasAllNormals)
+                    {
+                        mesh.normals.push_back(normals[std::size_t(key[2])]);
+                    }
+                }
+                else
+                {
+                    model.mergedVertices++;
+                }
+                faceVertices.push_back(vertex);
+            }
+
+            // Polygons are assumed to be convex, and split into a fan around their first corner
+            for (std::size_t i = 1; i + 1 < faceVertices.size(); i++)
+            {
+                mesh.indices.push_back(faceVertices[0]);
+                mesh.indices.push_back(faceVertices[i]);
+                mesh.indices.push_back(faceVertices[i + 1]);
+            }
+        }
+    }
+    if (!hasAllNormals)
+    {
+        computeNormals(mesh);
+    }
+
+    ModelNode node;
+    node.mesh = 0;
+    model.nodes.push_back(node);
+    return true;
+}
+
+// Binary data a glTF file refers to, either a mapped .bin file or the binary chunk of a .glb file
+struct GltfBuffer
+{
+    const unsigned char *data = nullptr;
+    std::size_t size = 0;
+};
+
+struct GltfFile
+{
+    JsonValue json;
+    std::string directory;
+    std::vector<MappedFile> files;
+    std::vector<GltfBuffer> buffers;
+};
+
+static const uint32_t glbMagic = 0x46546C67;
+static const uint32_t glbJsonChunk = 0x4E4F534A;
+static const uint32_t glbBinaryChunk = 0x004E4942;
+
+static const int gltfFloat = 5126;
+static const int gltfUnsignedByte = 5121;
+static const int gltfUnsignedShort = 5123;
+static const int gltfUnsignedInt = 5125;
+static const int gltfTriangles = 4;
+
+static uint32_t readUint32(const unsigned char *data)
+{
+    uint32_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+// A non-negative integer that fits a size, or fallback if the value is missing
+static bool readSize(const JsonValue &value, std::size_t fallback, std::size_t &size)
+{
+    if (value.isNull())
+    {
+        size = fallback;
+        return true;
+    }
+    double number = value.number(-1);
+    if (number < 0 || number > 9007199254740992.0 || number != std::floor(number))
+    {
+        return false;
+    }
+    size = std::size_t(number);
+    return true;
+}
+
+// Finds where an accessor's elements are, checking that all of them are inside the buffer
+static bool locateAccessor(const GltfFile &gltf, const JsonValue &accessor, std::size_t elementSize,
+                           const unsigned char *&data, std::size_t &stride, std::size_t &count)
+{
+    const JsonValue &view = gltf.json["bufferViews"][std::size_t(accessor["bufferView"].integer())];
+    int bufferIndex = view["buffer"].integer();
+    std::size_t accessorOffset, viewOffset, viewLength;
+    if (view.isNull() || !accessor["sparse"].isNull() || bufferIndex < 0 ||
+        std::size_t(bufferIndex) >= gltf.buffers.size() || !readSize(accessor["count"], 0, count) ||
+        !readSize(accessor["byteOffset"], 0, accessorOffset) || !readSize(view["byteOffset"], 0, viewOffset) ||
+        !readSize(view["byteLength"], 0, viewLength) || !readSize(view["byteStride"], elementSize, stride))
+    {
+        return false;
+    }
+    const GltfBuffer &buffer = gltf.buffers[std::size_t(bufferIndex)];
+    if (viewOffset > buffer.size || viewLength > buffer.size - viewOffset || stride < elementSize)
+    {
+        return false;
+    }
+    if (count > 0 && (accessorOffset > viewLength || count - 1 > (viewLength - accessorOffset) / stride ||
+                      (count - 1) * stride + elementSize > viewLength - accessorOffset))
+    {
+        return false;
+    }
+    data = buffer.data + viewOffset + accessorOffset;
+    return true;
+}
+
+static std::size_t componentCount(const std::string &type)
+{
+    return type == "SCALAR" ? 1 : type == "VEC2" ? 2 : type == "VEC3" ? 3 : type == "VEC4" ? 4 : 0;
+}
+
+// Reads a float attribute with the given number of components per element
+template <class T>
+static bool readAttribute(const GltfFile &gltf, int accessorIndex, std::size_t components, std::vector<T> &values)
+{
+    const JsonValue &accessor = gltf.json["accessors"][std::size_t(accessorIndex)];
+    const unsigned char *data;
+    std::size_t stride, count;
+    if (accessor["componentType"].integer() != gltfFloat || componentCount(accessor["type"].string()) != components ||
+        !locateAccessor(gltf, accessor, components * sizeof(float), data, stride, count))
+    {
+        return false;
+    }
+    values.resize(count);
+    for (std::size_t i = 0; i < count; i++)
+    {
+        float element[4];
+        std::memcpy(element, data + i * stride, components * sizeof(float));
+        for (std::size_t component = 0; component < components; component++)
+        {
+            values[i][int(component)] = element[component];
+        }
+    }
+    return true;
+}
+
+static bool readIndices(const GltfFile &gltf, int accessorIndex, std::vector<unsigned int> &indices)
+{
+    const JsonValue &accessor = gltf.json["accessors"][std::size_t(accessorIndex)];
+    int componentType = accessor["componentType"].integer();
+    std::size_t indexSize = componentType == gltfUnsignedInt     ? 4
+                            : componentType == gltfUnsignedShort ? 2
+                            : componentType == gltfUnsignedByte  ? 1
+                                                                 : 0;
+    const unsigned char *data;
+    std::size_t stride, count;
+    if (indexSize == 0 || componentCount(accessor["type"].string()) != 1 ||
+        !locateAccessor(gltf, accessor, indexSize, data, stride, count))
+    {
+        return false;
+    }
+    indices.resize(count);
+    for (std::size_t i = 0; i < count; i++)
+    {
+        const unsigned char *index = data + i * stride;
+        indices[i] = indexSize == 4   ? readUint32(index)
+                     : indexSize == 2 ? unsigned(index[0] | index[1] << 8)
+                                      : index[0];
+    }
+    return true;
+}
+
+// Converts a triangle primitive into a mesh. Returns nullptr on success.
+static const char *convertPrimitive(const GltfFile &gltf, const JsonValue &primitive, Mesh &mesh)
+{
+    const JsonValue &attributes = primitive["attributes"];
+    if (primitive["mode"].integer(gltfTriangles) != gltfTriangles)
+    {
+        return "only triangle primitives are supported";
+    }
+    if (!readAttribute(gltf, attributes["POSITION"].integer(), 3, mesh.vertices))
+    {
+        return "positions are missing or invalid";
+    }
+    if (!attributes["NORMAL"].isNull() && !readAttribute(gltf, attributes["NORMAL"].integer(), 3, mesh.normals))
+    {
+        return "normals are invalid";
+    }
+    if (!attributes["TEXCOORD_0"].isNull() &&
+        !readAttribute(gltf, attributes["TEXCOORD_0"].integer(), 2, mesh.textureCoordinates))
+    {
+        return "texture coordinates are invalid or not floats";
+    }
+    if (mesh.normals.size() != mesh.vertices.size() && !mesh.normals.empty())
+    {
+        return "there are not as many normals as positions";
+    }
+    if (mesh.textureCoordinates.size() != mesh.vertices.size())
+    {
+        if (!mesh.textureCoordinates.empty())
+        {
+            return "there are not as many texture coordinates as positions";
+        }
+        mesh.textureCoordinates.assign(mesh.vertices.size(), glm::vec2(0));
+    }
+    // glTF puts the texture origin in the upper left corner
+    for (glm::vec2 &textureCoordinate : mesh.textureCoordinates)
+    {
+        textureCoordinate.y = 1.0f - textureCoordinate.y;
+    }
+
+    if (primitive["indices"].isNull())
+    {
+        mesh.indices.resize(mesh.vertices.size());
+        for (std::size_t i = 0; i < mesh.indices.size(); i++)
+        {
+            mesh.indices[i] = unsigned(i);
+        }
+    }
+    else if (!readIndices(gltf, primitive["indices"].integer(), mesh.indices))
+    {
+        return "indices are invalid";
+    }
+    if (mesh.indices.size() % 3 != 0)
+    {
+        return "the index count is not a multiple of three";
+    }
+    for (unsigned int index : mesh.indices)
+    {
+        if (index >= mesh.vertices.size())
+        {
+            return "an index is out of range";
+        }
+    }
+
+    if (mesh.normals.empty())
+    {
+        computeNormals(mesh);
+    }
+    return nullptr;
+}
+
+// Rotation angles for the order the scene graph applies them in, R = Ry * Rx * Rz, from elements of R (row, column)
+static glm::vec3 eulerAngles(float r02, float r10, float r11, float r12, float r22)
+{
+    return glm::vec3(std::asin(std::max(-1.0f, std::min(1.0f, -r12))), std::atan2(r02, r22), std::atan2(r10, r11));
+}
+
+static void readNodeTransform(const JsonValue &node, ModelNode &modelNode)
+{
+    const JsonValue &matrix = node["matrix"];
+    if (matrix.size() == 16)
+    {
+        // Column major, and assumed to be without shear
+        float m[16];
+        for (std::size_t i = 0; i < 16; i++)
+        {
+            m[i] = float(matrix[i].number());
+        }
+        modelNode.position = glm::vec3(m[12], m[13], m[14]);
+        for (int column = 0; column < 3; column++)
+        {
+            modelNode.scale[column] = glm::length(glm::vec3(m[column * 4], m[column * 4 + 1], m[column * 4 + 2]));
+        }
+        auto r = [&](int row, int column) {
+            return modelNode.scale[column] > 0 ? m[column * 4 + row] / modelNode.scale[column] : 0.0f;
+        };
+        modelNode.rotation = eulerAngles(r(0, 2), r(1, 0), r(1, 1), r(1, 2), r(2, 2));
+        return;
+    }
+
+    const JsonValue &translation = node["translation"];
+    const JsonValue &rotation = node["rotation"];
+    const JsonValue &scale = node["scale"];
+    for (std::size_t i = 0; i < 3; i++)
+    {
+        modelNode.position[int(i)] = float(translation[i].number(0));
+        modelNode.scale[int(i)] = float(scale[i].number(1));
+    }
+    if (rotation.size() == 4)
+    {
+        float q[4];
+        for (std::size_t i = 0; i < 4; i++)
+        {
+            q[i] = float(rotation[i].number());
+        }
+        float x = q[0], y = q[1], z = q[2], w = q[3];
+        modelNode.rotation = eulerAngles(2 * (x * z + w * y), 2 * (x * y + w * z), 1 - 2 * (x * x + z * z),
+                                         2 * (y * z - w * x), 1 - 2 * (x * x + y * y));
+    }
+}
+
+// The file a texture's image comes from, or an empty string if there is none
+static std::string textureFile(const GltfFile &gltf, const JsonValue &textureInfo)
+{
+    if (textureInfo.isNull())
+    {
+        return std::string();
+    }
+    const JsonValue &texture = gltf.json["textures"][std::size_t(textureInfo["index"].integer())];
+    const JsonValue &image = gltf.json["images"][std::size_t(texture["source"].integer())];
+    const std::string &uri = image["uri"].string();
+    if (uri.empty() || uri.compare(0, 5, "data:") == 0)
+    {
+        std::cerr << "Skipping a glTF image that is not in a file of its own" << std::endl;
+        return std::string();
+    }
+    return gltf.directory + uri;
+}
+
+// Maps the binary buffers, either from the .glb file itself or from the files the .gltf file refers to
+static bool openGltfBuffers(const std::string &fileName, GltfFile &gltf, const GltfBuffer &glbBinary)
+{
+    const JsonValue &buffers = gltf.json["buffers"];
+    gltf.files.reserve(buffers.size());
+    for (std::size_t i = 0; i < buffers.size(); i++)
+    {
+        const std::string &uri = buffers[i]["uri"].string();
+        std::size_t byteLength;
+        GltfBuffer buffer;
+        if (uri.empty() && i == 0 && glbBinary.data != nullptr)
+        {
+            buffer = glbBinary;
+        }
+        else if (uri.empty() || uri.compare(0, 5, "data:") == 0)
+        {
+            std::cerr << fileName << ": only buffers in separate files are supported" << std::endl;
+            return false;
+        }
+        else
+        {
+            gltf.files.emplace_back();
+            if (!gltf.files.back().open(gltf.directory + uri))
+            {
+                std::cerr << "Could not open " << gltf.directory + uri << std::endl;
+                return false;
+            }
+            buffer.data = gltf.files.back().data();
+            buffer.size = gltf.files.back().size();
+        }
+        if (!readSize(buffers[i]["byteLength"], buffer.size, byteLength) || byteLength > buffer.size)
+        {
+            std::cerr << fileName << ": buffer " << i << " is shorter than its byteLength" << std::endl;
+            return false;
+        }
+        buffer.size = byteLength;
+        gltf.buffers.push_back(buffer);
+    }
+    return true;
+}
+
+// Reads a glTF 2.0 file. Every primitive becomes a mesh of its own, and primitives are converted in parallel.
+static bool importGltf(const std::string &fileName, bool isBinary, ThreadPool &pool, ModelData &model)
+{
+    MappedFile file;
+    if (!file.open(fileName))
+    {
+        std::cerr << "Could not open " << fileName << std::endl;
+        return false;
+    }
+
+    GltfFile gltf;
+    std::size_t directoryEnd = fileName.find_last_of("/\\");
+    gltf.directory = directoryEnd == std::string::npos ? std::string() : fileName.substr(0, directoryEnd + 1);
+
+    // A .glb file is a 12 byte header followed by a JSON chunk and an optional binary chunk, each with an 8 byte
+    // header of their own
+    const unsigned char *jsonBegin = file.data();
+    std::size_t jsonSize = file.size();
+    GltfBuffer glbBinary;
+    if (isBinary)
+    {
+        const unsigned char *data = file.data();
+        if (file.size() < 20 || readUint32(data) != glbMagic || readUint32(data + 4) != 2 ||
+            readUint32(data + 8) > file.size() || readUint32(data + 8) < 20 || readUint32(data + 16) != glbJsonChunk ||
+            readUint32(data + 12) > readUint32(data + 8) - 20)
+        {
+            std::cerr << fileName << " is not a glTF 2.0 binary file" << std::endl;
+            return false;
+        }
+        std::size_t totalSize = readUint32(data + 8);
+        jsonBegin = data + 20;
+        jsonSize = readUint32(data + 12);
+        std::size_t binaryChunk = 20 + ((jsonSize + 3) & ~std::size_t(3));
+        if (binaryChunk + 8 <= totalSize && readUint32(data + binaryChunk + 4) == glbBinaryChunk)
+        {
+            glbBinary.data = data + binaryChunk + 8;
+            glbBinary.size = std::min<std::size_t>(readUint32(data + binaryChunk), totalSize - binaryChunk - 8);
+        }
+    }
+
+    std::string error;
+    if (!JsonValue::parse(std::string(reinterpret_cast<const char *>(jsonBegin), jsonSize), gltf.json, error))
+    {
+        std::cerr << fileName << ": " << error << std::endl;
+        return false;
+    }
+    if (gltf.json["asset"]["version"].string().compare(0, 2, "2.") != 0)
+    {
+        std::cerr << fileName << " is not a glTF 2.0 file" << std::endl;
+        return false;
+    }
+    if (!openGltfBuffers(fileName, gltf, glbBinary))
+    {
+        return false;
+    }
+
+    const JsonValue &materials = gltf.json["materials"];
+    model.materials.resize(materials.size());
+    for (std::size_t i = 0; i < materials.size(); i++)
+    {
+        // The roughness map is the metallic-roughness texture, which has roughness in its green channel
+        const JsonValue &pbr = materials[i]["pbrMetallicRoughness"];
+        model.materials[i].diffuseFile = textureFile(gltf, pbr["baseColorTexture"]);
+        model.materials[i].normalMapFile = textureFile(gltf, materials[i]["normalTexture"]);
+        model.materials[i].roughnessMapFile = textureFile(gltf, pbr["metallicRoughnessTexture"]);
+    }
+
+    // Every glTF mesh becomes a range of meshes, one per primitive
+    const JsonValue &meshes = gltf.json["meshes"];
+    std::vector<std::size_t> firstPrimitive(meshes.size() + 1, 0);
+    std::vector<const JsonValue *> primitives;
+    for (std::size_t i = 0; i < meshes.size(); i++)
+    {
+        const JsonValue &meshPrimitives = meshes[i]["primitives"];
+        for (std::size_t j = 0; j < meshPrimitives.size(); j++)
+        {
+            primitives.push_back(&meshPrimitives[j]);
+        }
+        firstPrimitive[i + 1] = primitives.size();
+    }
+    model.meshes.resize(primitives.size());
+    std::vector<const char *> primitiveErrors(primitives.size(), nullptr);
+    pool.parallelFor(primitives.size(), [&](std::size_t i) {
+        primitiveErrors[i] = convertPrimitive(gltf, *primitives[i], model.meshes[i]);
+    });
+    for (std::size_t i = 0; i < primitives.size(); i++)
+    {
+        if (primitiveErrors[i] != nullptr)
+        {
+            std::cerr << fmt::format("{}: primitive {}: {}", fileName, i, primitiveErrors[i]) << std::endl;
+            return false;
+        }
+    }
+
+    // Walks the default scene, or all nodes that are not a child of another node without one
+    const JsonValue &nodes = gltf.json["nodes"];
+    std::vector<int> roots;
+    const JsonValue &scene = gltf.json["scenes"][std::size_t(gltf.json["scene"].integer(0))];
+    if (!scene.isNull())
+    {
+        for (std::size_t i = 0; i < scene["nodes"].size(); i++)
+        {
+            roots.push_back(scene["nodes"][i].integer());
+        }
+    }
+    else
+    {
+        std::vector<bool> isChild(nodes.size(), false);
+        for (std::size_t i = 0; i < nodes.size(); i++)
+        {
+            for (std::size_t j = 0; j < nodes[i]["children"].size(); j++)
+            {
+                int child = nodes[i]["children"][j].integer();
+                if (child >= 0 && std::size_t(child) < nodes.size())
+                {
+                    isChild[std::size_t(child)] = true;
+                }
+            }
+        }
+        for (std::size_t i = 0; i < nodes.size(); i++)
+        {
+            if (!isChild[i])
+            {
+                roots.push_back(int(i));
+            }
+        }
+    }
+
+    std::vector<bool> isVisited(nodes.size(), false);
+    std::vector<std::pair<int, int>> pending;
+    for (auto root = roots.rbegin(); root != roots.rend(); ++root)
+    {
+        pending.emplace_back(*root, -1);
+    }
+    while (!pending.empty())
+    {
+        int index = pending.back().first;
+        int parent = pending.back().second;
+        pending.pop_back();
+        if (index < 0 || std::size_t(index) >= nodes.size() || isVisited[std::size_t(index)])
+        {
+            std::cerr << fileName << " has an invalid node hierarchy" << std::endl;
+            return false;
+        }
+        isVisited[std::size_t(index)] = true;
+        const JsonValue &node = nodes[std::size_t(index)];
+
+        int modelIndex = int(model.nodes.size());
+        ModelNode modelNode;
+        modelNode.name = node["name"].string();
+        modelNode.parent = parent;
+        readNodeTransform(node, modelNode);
+        model.nodes.push_back(modelNode);
+
+        // The first primitive goes on the node itself, and any others on children without a transformation
+        int mesh = node["mesh"].integer();
+        if (mesh >= 0 && std::size_t(mesh) < meshes.size())
+        {
+            for (std::size_t primitive = firstPrimitive[std::size_t(mesh)];
+                 primitive < firstPrimitive[std::size_t(mesh) + 1]; primitive++)
+            {
+                int material = (*primitives[primitive])["material"].integer();
+                material = material >= 0 && std::size_t(material) < model.materials.size() ? material : -1;
+                if (primitive == firstPrimitive[std::size_t(mesh)])
+                {
+                    model.nodes[std::size_t(modelIndex)].mesh = int(primitive);
+                    model.nodes[std::size_t(modelIndex)].material = material;
+                    continue;
+                }
+                ModelNode primitiveNode;
+                primitiveNode.name = modelNode.name;
+                primitiveNode.parent = modelIndex;
+                primitiveNode.mesh = int(primitive);
+                primitiveNode.material = material;
+                model.nodes.push_back(primitiveNode);
+            }
+        }
+
+        const JsonValue &children = node["children"];
+        for (std::size_t i = children.size(); i > 0; i--)
+        {
+            pending.emplace_back(children[i - 1].integer(), modelIndex);
+        }
+    }
+    return true;
+}
+
+bool ImportedModel::load(const std::string &fileName, ThreadPool &pool, bool withGpuResources)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    std::string extension;
+    std::size_t dot = fileName.find_last_of('.');
+    if (dot != std::string::npos)
+    {
+        extension = fileName.substr(dot);
+        std::transform(extension.begin(), extension.end(), extension.begin(),
+                       [](unsigned char character) { return char(std::tolower(character)); });
+    }
+
+    ModelData model;
+    bool isImported;
+    if (extension == ".obj")
+    {
+        isImported = importObj(fileName, pool, model);
+    }
+    else if (extension == ".gltf" || extension == ".glb")
+    {
+        isImported = importGltf(fileName, extension == ".glb", pool, model);
+    }
+    else
+    {
+        std::cerr << "Cannot import " << fileName << ", only .obj, .gltf and .glb files are supported" << std::endl;
+        isImported = false;
+    }
+    if (!isImported)
+    {
+        return false;
+    }
+
+    stats = Statistics();
+    stats.parseSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    stats.meshCount = model.meshes.size();
+    stats.mergedVertices = model.mergedVertices;
+    for (const Mesh &mesh : model.meshes)
+    {
+        stats.vertexCount += mesh.vertices.size();
+        stats.triangleCount += mesh.indices.size() / 3;
+    }
+    meshes = std::move(model.meshes);
+    materials = std::move(model.materials);
+
+    // Materials share images by file name, and the images are decoded in parallel
+    std::vector<std::string> imageFiles;
+    std::unordered_map<std::string, std::size_t> imageIndices;
+    for (const Material &material : materials)
+    {
+        for (const std::string *file : {&material.diffuseFile, &material.normalMapFile, &material.roughnessMapFile})
+        {
+            if (!file->empty() && imageIndices.emplace(*file, imageFiles.size()).second)
+            {
+                imageFiles.push_back(*file);
+            }
+        }
+    }
+    images.resize(imageFiles.size());
+    pool.parallelFor(imageFiles.size(), [&](std::size_t i) { images[i] = loadPNGFile(imageFiles[i]); });
+
+    std::vector<GLuint> textureIDs(images.size(), 0);
+    if (withGpuResources)
+    {
+        for (std::size_t i = 0; i < images.size(); i++)
+        {
+            if (!images[i].pixels.empty())
+            {
+                textures.push_back(genTexture(images[i], imageFiles[i], GPU_HERE));
+                textureIDs[i] = textures.back().id();
+            }
+        }
+        images.clear();
+
+        meshBuffers.resize(meshes.size());
+        for (std::size_t i = 0; i < meshes.size(); i++)
+        {
+            if (!meshes[i].indices.empty())
+            {
+                meshBuffers[i] = meshRegistry().acquire(meshes[i], fileName, GPU_HERE);
+            }
+        }
+    }
+
+    // Node names point into nodeNames, so it must not grow once the nodes exist
+    nodeNames.reserve(model.nodes.size() + 1);
+    nodeNames.push_back(fileName);
+    rootNode = createSceneNode();
+    rootNode->name = nodeNames.back().c_str();
+
+    std::vector<SceneNodeHandle> nodes(model.nodes.size());
+    for (std::size_t i = 0; i < model.nodes.size(); i++)
+    {
+        const ModelNode &modelNode = model.nodes[i];
+        nodes[i] = createSceneNode();
+        SceneNode *node = nodes[i].get();
+        nodeNames.push_back(modelNode.name);
+        node->name = nodeNames.back().c_str();
+        node->position = modelNode.position;
+        node->rotation = modelNode.rotation;
+        node->scale = modelNode.scale;
+
+        if (modelNode.mesh != -1 && !meshes[std::size_t(modelNode.mesh)].indices.empty())
+        {
+            const Mesh &mesh = meshes[std::size_t(modelNode.mesh)];
+            node->mesh = &mesh;
+            node->hasBounds = true;
+            meshBounds(mesh, node->boundsMin, node->boundsMax);
+            if (withGpuResources)
+            {
+                node->vertexArrayObjectID = meshBuffers[std::size_t(modelNode.mesh)]->vertexArray.id();
+                node->VAOIndexCount = meshBuffers[std::size_t(modelNode.mesh)]->indexCount;
+            }
+        }
+
+        // The shaders only texture normal mapped geometry, which needs all three images
+        if (modelNode.material != -1)
+        {
+            const Material &material = materials[std::size_t(modelNode.material)];
+            node->material = &material;
+            auto image = [&](const std::string &file) -> int {
+                auto found = imageIndices.find(file);
+                if (found == imageIndices.end())
+                {
+                    return -1;
+                }
+                bool isLoaded = withGpuResources ? textureIDs[found->second] != 0
+                                                 : !images[found->second].pixels.empty();
+                return isLoaded ? int(found->second) : -1;
+            };
+            int diffuse = image(material.diffuseFile);
+            int normalMap = image(material.normalMapFile);
+            int roughnessMap = image(material.roughnessMapFile);
+            if (diffuse != -1 && normalMap != -1 && roughnessMap != -1)
+            {
+                node->nodeType = NORMAL_MAPPED_GEOMETRY;
+                if (withGpuResources)
+                {
+                    node->textureID = textureIDs[std::size_t(diffuse)];
+                    node->normalMapTextureID = textureIDs[std::size_t(normalMap)];
+                    node->roughnessMapTextureID = textureIDs[std::size_t(roughnessMap)];
+                }
+                else
+                {
+                    node->diffuseImage = &images[std::size_t(diffuse)];
+                    node->normalMapImage = &images[std::size_t(normalMap)];
+                    node->roughnessMapImage = &images[std::size_t(roughnessMap)];
+                }
+            }
+        }
+
+        addChild(modelNode.parent == -1 ? rootNode : nodes[std::size_t(modelNode.parent)], nodes[i]);
+    }
+    return true;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "sceneGraph.hpp"
+#include <cstddef>
+#include <string>
+#include <utilities/glutils.h>
+#include <utilities/gpuResource.h>
+#include <utilities/imageLoader.hpp>
+#include <utilities/mesh.h>
+#include <utilities/meshRegistry.h>
+#include <utilities/threadPool.h>
+#include <vector>
+
+// A model imported from a Wavefront OBJ (.obj) or glTF 2.0 (.gltf with external buffers, or .glb) file. The file is
+// memory mapped and parsed on the threads of a pool. Owns the meshes, materials and GPU objects its nodes refer to,
+// like SceneFile does, while the nodes themselves belong to the scene graph.
+class ImportedModel
+{
+  public:
+    struct Statistics
+    {
+        std::size_t meshCount = 0;
+        std::size_t vertexCount = 0;
+        std::size_t triangleCount = 0;
+        // Face corners that turned out to be a copy of an earlier vertex
+        std::size_t mergedVertices = 0;
+        double parseSeconds = 0;
+    };
+
+    ImportedModel() = default;
+
+    // Parses the file and builds a subtree of nodes below root(). Without GPU resources no OpenGL context is needed,
+    // and the nodes only get the meshes and images the software renderer draws with. Nothing is created on failure.
+    bool load(const std::string &fileName, ThreadPool &pool, bool withGpuResources);
+
+    SceneNodeHandle root() const
+    {
+        return rootNode;
+    }
+    const Statistics &statistics() const
+    {
+        return stats;
+    }
+
+  private:
+    ImportedModel(ImportedModel const &) = delete;
+    ImportedModel &operator=(ImportedModel const &) = delete;
+
+    SceneNodeHandle rootNode;
+    // Node names point into these
+    std::vector<std::string> nodeNames;
+
+    std::vector<Mesh> meshes;
+    std::vector<SharedMeshBuffers> meshBuffers;
+    std::vector<Material> materials;
+    std::vector<GLTexture> textures;
+    // Only kept without GPU resources
+    std::vector<PNGImage> images;
+
+    Statistics stats;
+};
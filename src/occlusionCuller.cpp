@@ -0,0 +1,262 @@
+#include "occlusionCuller.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <utilities/simd.h>
+
+void OcclusionCuller::init(ThreadPool &threadPool)
+{
+    pool = &threadPool;
+
+    pyramid.clear();
+    int levelWidth = width;
+    int levelHeight = height;
+    while (true)
+    {
+        pyramid.push_back({levelWidth, levelHeight, std::vector<float>(levelWidth * levelHeight, 1.0f)});
+        if (levelWidth == 1 && levelHeight == 1)
+        {
+            break;
+        }
+        levelWidth = std::max(1, levelWidth / 2);
+        levelHeight = std::max(1, levelHeight / 2);
+    }
+}
+
+void OcclusionCuller::beginFrame(const glm::mat4 &frameViewProjection)
+{
+    viewProjection = frameViewProjection;
+    triangles.clear();
+    for (std::vector<unsigned int> &tile : tileTriangles)
+    {
+        tile.clear();
+    }
+    stats = Statistics();
+}
+
+void OcclusionCuller::addOccluder(const Mesh &mesh, const glm::mat4 &model)
+{
+    glm::mat4 modelViewProjection = viewProjection * model;
+
+    for (std::size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+    {
+        glm::vec3 screen[3];
+        bool isClipped = false;
+        for (int corner = 0; corner < 3; corner++)
+        {
+            glm::vec4 clip = modelViewProjection * glm::vec4(mesh.vertices[mesh.indices[i + corner]], 1.0f);
+            // Leaving out a triangle only makes the culling less effective, whereas drawing one clipped wrongly could
+            // hide something visible
+            if (clip.w <= 0 || clip.z < -clip.w)
+            {
+                isClipped = true;
+                break;
+            }
+            glm::vec3 ndc = glm::vec3(clip) / clip.w;
+            screen[corner] = glm::vec3((ndc.x * 0.5f + 0.5f) * width, (ndc.y * 0.5f + 0.5f) * height,
+                                       ndc.z * 0.5f + 0.5f);
+        }
+        if (isClipped)
+        {
+            continue;
+        }
+
+        // Counter clockwise triangles face the camera
+        float area = (screen[1].x - screen[0].x) * (screen[2].y - screen[0].y) -
+                     (screen[2].x - screen[0].x) * (screen[1].y - screen[0].y);
+        if (area <= 0)
+        {
+            continue;
+        }
+
+        // Pixels whose center lies within the triangle's bounds
+        float minX = std::min({screen[0].x, screen[1].x, screen[2].x});
+        float maxX = std::max({screen[0].x, screen[1].x, screen[2].x});
+        float minY = std::min({screen[0].y, screen[1].y, screen[2].y});
+        float maxY = std::max({screen[0].y, screen[1].y, screen[2].y});
+        Triangle triangle;
+        triangle.minX = std::max(0, int(std::ceil(minX - 0.5f)));
+        triangle.maxX = std::min(width - 1, int(std::floor(maxX - 0.5f)));
+        triangle.minY = std::max(0, int(std::ceil(minY - 0.5f)));
+        triangle.maxY = std::min(height - 1, int(std::floor(maxY - 0.5f)));
+        if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+        {
+            continue;
+        }
+
+        // Edge i is the one opposite of vertex i, and is positive on the inside
+        triangle.depthA = triangle.depthB = triangle.depthC = 0;
+        for (int edge = 0; edge < 3; edge++)
+        {
+            const glm::vec3 &from = screen[(edge + 1) % 3];
+            const glm::vec3 &to = screen[(edge + 2) % 3];
+            triangle.edgeA[edge] = from.y - to.y;
+            triangle.edgeB[edge] = to.x - from.x;
+            triangle.edgeC[edge] = (to.y - from.y) * from.x - (to.x - from.x) * from.y;
+
+            // The edge functions divided by the area are the barycentric coordinates
+            triangle.depthA += screen[edge].z * triangle.edgeA[edge] / area;
+            triangle.depthB += screen[edge].z * triangle.edgeB[edge] / area;
+            triangle.depthC += screen[edge].z * triangle.edgeC[edge] / area;
+        }
+
+        unsigned int index = unsigned(triangles.size());
+        triangles.push_back(triangle);
+        stats.occluderTriangles++;
+
+        for (int tileY = triangle.minY / tileHeight; tileY <= triangle.maxY / tileHeight; tileY++)
+        {
+            for (int tileX = triangle.minX / tileWidth; tileX <= triangle.maxX / tileWidth; tileX++)
+            {
+                tileTriangles[tileY * tilesX + tileX].push_back(index);
+            }
+        }
+    }
+}
+
+void OcclusionCuller::rasterizeTile(int tile)
+{
+    const int tileMinX = (tile % tilesX) * tileWidth;
+    const int tileMinY = (tile / tilesX) * tileHeight;
+    std::vector<float> &depth = pyramid[0].depth;
+
+    for (int y = tileMinY; y < tileMinY + tileHeight; y++)
+    {
+        std::fill_n(depth.begin() + y * width + tileMinX, tileWidth, 1.0f);
+    }
+
+    const float4 laneOffsets(0.5f, 1.5f, 2.5f, 3.5f);
+    const float4 zero(0.0f);
+
+    for (unsigned int index : tileTriangles[tile])
+    {
+        const Triangle &triangle = triangles[index];
+        // Tiles are a multiple of four pixels wide, so aligning down stays inside the tile. The extra pixels are
+        // outside the triangle, and fail the edge tests.
+        int minX = std::max(triangle.minX, tileMinX) & ~3;
+        int maxX = std::min(triangle.maxX, tileMinX + tileWidth - 1);
+        int minY = std::max(triangle.minY, tileMinY);
+        int maxY = std::min(triangle.maxY, tileMinY + tileHeight - 1);
+
+        const float4 edgeA0(triangle.edgeA[0]), edgeA1(triangle.edgeA[1]), edgeA2(triangle.edgeA[2]);
+        const float4 depthA(triangle.depthA);
+
+        for (int y = minY; y <= maxY; y++)
+        {
+            float centerY = y + 0.5f;
+            // Values at the pixel centers of x = 0, stepped along the row with the a coefficients
+            float4 rowEdge0(triangle.edgeB[0] * centerY + triangle.edgeC[0]);
+            float4 rowEdge1(triangle.edgeB[1] * centerY + triangle.edgeC[1]);
+            float4 rowEdge2(triangle.edgeB[2] * centerY + triangle.edgeC[2]);
+            float4 rowDepth(triangle.depthB * centerY + triangle.depthC);
+
+            float *row = &depth[y * width];
+            for (int x = minX; x <= maxX; x += 4)
+            {
+                float4 centerX = float4(float(x)) + laneOffsets;
+                float4 inside = (edgeA0 * centerX + rowEdge0 >= zero) & (edgeA1 * centerX + rowEdge1 >= zero) &
+                                (edgeA2 * centerX + rowEdge2 >= zero);
+                if (moveMask(inside) == 0)
+                {
+                    continue;
+                }
+
+                float4 previous = float4::load(row + x);
+                float4 triangleDepth = depthA * centerX + rowDepth;
+                select(inside, previous, min(previous, triangleDepth)).store(row + x);
+            }
+        }
+    }
+}
+
+void OcclusionCuller::buildPyramid()
+{
+    for (std::size_t level = 1; level < pyramid.size(); level++)
+    {
+        const Level &source = pyramid[level - 1];
+        Level &target = pyramid[level];
+        for (int y = 0; y < target.height; y++)
+        {
+            int y0 = std::min(2 * y, source.height - 1);
+            int y1 = std::min(2 * y + 1, source.height - 1);
+            for (int x = 0; x < target.width; x++)
+            {
+                int x0 = std::min(2 * x, source.width - 1);
+                int x1 = std::min(2 * x + 1, source.width - 1);
+                target.depth[y * target.width + x] =
+                    std::max({source.depth[y0 * source.width + x0], source.depth[y0 * source.width + x1],
+                              source.depth[y1 * source.width + x0], source.depth[y1 * source.width + x1]});
+            }
+        }
+    }
+}
+
+void OcclusionCuller::rasterize()
+{
+    auto start = std::chrono::steady_clock::now();
+
+    pool->parallelFor(tilesX * tilesY, [this](std::size_t tile) { rasterizeTile(int(tile)); });
+    buildPyramid();
+
+    stats.rasterSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool OcclusionCuller::isVisible(const glm::vec3 &boundsMin, const glm::vec3 &boundsMax, const glm::mat4 &model)
+{
+    stats.nodesTested++;
+    glm::mat4 modelViewProjection = viewProjection * model;
+
+    glm::vec2 screenMin(INFINITY);
+    glm::vec2 screenMax(-INFINITY);
+    float nearestDepth = INFINITY;
+    for (int corner = 0; corner < 8; corner++)
+    {
+        glm::vec3 position((corner & 1) ? boundsMax.x : boundsMin.x, (corner & 2) ? boundsMax.y : boundsMin.y,
+                           (corner & 4) ? boundsMax.z : boundsMin.z);
+        glm::vec4 clip = modelViewProjection * glm::vec4(position, 1.0f);
+        if (clip.w <= 0 || clip.z < -clip.w)
+        {
+            // Reaches past the near plane, so it is too close to say anything about
+            return true;
+        }
+        glm::vec3 ndc = glm::vec3(clip) / clip.w;
+        glm::vec2 screen((ndc.x * 0.5f + 0.5f) * width, (ndc.y * 0.5f + 0.5f) * height);
+        screenMin = glm::min(screenMin, screen);
+        screenMax = glm::max(screenMax, screen);
+        nearestDepth = std::min(nearestDepth, ndc.z * 0.5f + 0.5f);
+    }
+
+    if (screenMax.x < 0 || screenMax.y < 0 || screenMin.x > width || screenMin.y > height)
+    {
+        stats.nodesCulled++;
+        return false;
+    }
+
+    int minX = std::max(0, int(screenMin.x));
+    int minY = std::max(0, int(screenMin.y));
+    int maxX = std::min(width - 1, int(screenMax.x));
+    int maxY = std::min(height - 1, int(screenMax.y));
+
+    // The first level where the bounds cover at most 2x2 texels
+    std::size_t level = 0;
+    while (level + 1 < pyramid.size() &&
+           ((maxX >> level) - (minX >> level) > 1 || (maxY >> level) - (minY >> level) > 1))
+    {
+        level++;
+    }
+
+    const Level &texels = pyramid[level];
+    for (int y = minY >> level; y <= std::min(maxY >> level, texels.height - 1); y++)
+    {
+        for (int x = minX >> level; x <= std::min(maxX >> level, texels.width - 1); x++)
+        {
+            if (texels.depth[y * texels.width + x] >= nearestDepth)
+            {
+                return true;
+            }
+        }
+    }
+
+    stats.nodesCulled++;
+    return false;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <utilities/mesh.h>
+#include <utilities/threadPool.h>
+#include <vector>
+
+// Occlusion culling without waiting for the GPU. A few simple occluder meshes are rasterized on the CPU into a small
+// depth buffer, split into tiles which are rasterized in parallel, four pixels at a time. A max depth pyramid built on
+// top of it then answers whether a bounding box could be visible with at most four reads.
+//
+// Every frame: beginFrame(), addOccluder() for each occluder, rasterize(), and then isVisible() for each node.
+class OcclusionCuller
+{
+  public:
+    struct Statistics
+    {
+        // Per frame
+        unsigned int occluderTriangles = 0;
+        unsigned int nodesTested = 0;
+        unsigned int nodesCulled = 0;
+        double rasterSeconds = 0;
+    };
+
+    void init(ThreadPool &pool);
+
+    void beginFrame(const glm::mat4 &viewProjection);
+    // Occluders are drawn with back face culling, like the GPU would, and triangles crossing the near plane are left
+    // out. Occluders should be solid: everything behind a front facing triangle counts as hidden.
+    void addOccluder(const Mesh &mesh, const glm::mat4 &model);
+    // Fills the depth buffer and the pyramid with the occluders added since beginFrame()
+    void rasterize();
+
+    // Whether anything inside the box, given in model space, could be visible. Boxes outside the view are not.
+    bool isVisible(const glm::vec3 &boundsMin, const glm::vec3 &boundsMax, const glm::mat4 &model);
+
+    const Statistics &statistics() const
+    {
+        return stats;
+    }
+
+    static const int width = 256;
+    static const int height = 128;
+
+  private:
+    static const int tileWidth = 64;
+    static const int tileHeight = 32;
+    static const int tilesX = width / tileWidth;
+    static const int tilesY = height / tileHeight;
+
+    // Edge functions and depth are planes in screen space, evaluated as a * x + b * y + c at the pixel centers
+    struct Triangle
+    {
+        float edgeA[3], edgeB[3], edgeC[3];
+        float depthA, depthB, depthC;
+        int minX, minY, maxX, maxY;
+    };
+
+    void rasterizeTile(int tile);
+    void buildPyramid();
+
+    ThreadPool *pool = nullptr;
+    glm::mat4 viewProjection;
+
+    std::vector<Triangle> triangles;
+    // Indices into triangles for every tile overlapping their bounds
+    std::vector<unsigned int> tileTriangles[tilesX * tilesY];
+
+    // Level 0 is the depth buffer, and every following level holds the farthest depth of 2x2 texels of the one before.
+    // Depth is in [0, 1], with 1 meaning nothing has been drawn.
+    struct Level
+    {
+        int width, height;
+        std::vector<float> depth;
+    };
+    std::vector<Level> pyramid;
+
+    Statistics stats;
+};
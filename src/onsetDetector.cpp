@@ -0,0 +1,430 @@
+#include "onsetDetector.hpp"
+#include <SFML/Audio/InputSoundFile.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fmt/format.h>
+#include <iostream>
+#include <utilities/simd.h>
+
+// Analysis frames are windowSize samples long, and a new frame is started every hopSize samples
+static const unsigned int windowSize = 2048;
+static const unsigned int hopSize = 512;
+// Number of onset envelope values kept around for peak picking and tempo estimation
+static const std::size_t envelopeLength = 1024;
+
+// Peak picking: an onset is a local maximum over [-peakPreFrames, peakPostFrames] that also lies above the local mean
+// over [-meanPreFrames, peakPostFrames] by a margin. Waiting for the frames after the peak is what bounds the detector
+// latency.
+static const std::size_t peakPreFrames = 3;
+static const std::size_t peakPostFrames = 3;
+static const std::size_t meanPreFrames = 10;
+static const std::size_t minimumOnsetGapFrames = 4;
+static const float peakThresholdMeanFactor = 1.5f;
+static const float peakThresholdFraction = 0.06f;
+
+static const std::size_t tempoUpdateInterval = 128;
+static const double minimumTempoBpm = 60;
+static const double maximumTempoBpm = 200;
+
+// The ball needs some time to travel up and down between two hits, regardless of how busy the music is
+static const double minimumHitInterval = 0.25;
+
+// Samples decoded per read from the audio file
+static const std::size_t decodeChunkSize = 16384;
+
+OnsetDetector::OnsetDetector(unsigned int sampleRate) : sampleRate(sampleRate), fft(windowSize)
+{
+    window.resize(windowSize);
+    const double pi = 3.14159265358979323846;
+    for (unsigned int i = 0; i < windowSize; i++)
+    {
+        window[i] = float(0.5 - 0.5 * std::cos(2.0 * pi * i / windowSize));
+    }
+
+    frameSamples.resize(windowSize);
+    real.resize(windowSize);
+    imaginary.resize(windowSize);
+    spectrum.resize(windowSize / 2);
+    previousSpectrum.resize(windowSize / 2);
+    envelope.resize(envelopeLength);
+}
+
+double OnsetDetector::latencySeconds() const
+{
+    return double(windowSize + peakPostFrames * hopSize) / sampleRate;
+}
+
+void OnsetDetector::process(const float *samples, std::size_t count, std::vector<double> &onsets)
+{
+    while (count > 0)
+    {
+        std::size_t copied = std::min(count, std::size_t(windowSize) - bufferedSamples);
+        std::memcpy(frameSamples.data() + bufferedSamples, samples, copied * sizeof(float));
+        bufferedSamples += copied;
+        samples += copied;
+        count -= copied;
+
+        if (bufferedSamples == windowSize)
+        {
+            analyzeFrame(onsets);
+            std::memmove(frameSamples.data(), frameSamples.data() + hopSize, (windowSize - hopSize) * sizeof(float));
+            bufferedSamples -= hopSize;
+        }
+    }
+}
+
+float OnsetDetector::envelopeAt(std::size_t frame) const
+{
+    return envelope[frame % envelopeLength];
+}
+
+void OnsetDetector::analyzeFrame(std::vector<double> &onsets)
+{
+    for (unsigned int i = 0; i < windowSize; i += 4)
+    {
+        (float4::load(&frameSamples[i]) * float4::load(&window[i])).store(&real[i]);
+        float4(0.0f).store(&imaginary[i]);
+    }
+
+    fft.forward(real.data(), imaginary.data());
+
+    // Log compressed magnitude spectrum. The Nyquist bin is left out, so the bin count stays a multiple of four.
+    std::swap(spectrum, previousSpectrum);
+    for (unsigned int bin = 0; bin < windowSize / 2; bin += 4)
+    {
+        float4 re = float4::load(&real[bin]);
+        float4 im = float4::load(&imaginary[bin]);
+        sqrt(re * re + im * im).store(&spectrum[bin]);
+    }
+    for (float &magnitude : spectrum)
+    {
+        magnitude = std::log1p(100.0f * magnitude);
+    }
+
+    // Spectral flux: the summed increase in energy over all bins
+    float4 flux(0.0f);
+    for (unsigned int bin = 0; bin < windowSize / 2; bin += 4)
+    {
+        flux += max(float4::load(&spectrum[bin]) - float4::load(&previousSpectrum[bin]), float4(0.0f));
+    }
+    float frameFlux = framesAnalyzed == 0 ? 0 : horizontalSum(flux);
+
+    envelope[framesAnalyzed % envelopeLength] = frameFlux;
+    envelopePeak = std::max(envelopePeak * 0.999f, frameFlux);
+    framesAnalyzed++;
+
+    pickPeak(onsets);
+
+    if (framesAnalyzed % tempoUpdateInterval == 0)
+    {
+        estimateTempo();
+    }
+}
+
+void OnsetDetector::pickPeak(std::vector<double> &onsets)
+{
+    if (framesAnalyzed < meanPreFrames + peakPostFrames + 1)
+    {
+        return;
+    }
+
+    std::size_t candidate = framesAnalyzed - 1 - peakPostFrames;
+    float value = envelopeAt(candidate);
+
+    float sum = 0;
+    for (std::size_t frame = candidate - meanPreFrames; frame <= candidate + peakPostFrames; frame++)
+    {
+        if (frame + peakPreFrames >= candidate && envelopeAt(frame) > value)
+        {
+            return;
+        }
+        sum += envelopeAt(frame);
+    }
+    float mean = sum / float(meanPreFrames + peakPostFrames + 1);
+
+    if (value <= peakThresholdMeanFactor * mean + peakThresholdFraction * envelopePeak)
+    {
+        return;
+    }
+    if (lastOnsetFrame != 0 && candidate - lastOnsetFrame < minimumOnsetGapFrames)
+    {
+        return;
+    }
+
+    lastOnsetFrame = candidate;
+    onsets.push_back(double(candidate * hopSize + windowSize / 2) / sampleRate);
+}
+
+void OnsetDetector::estimateTempo()
+{
+    double framesPerSecond = double(sampleRate) / hopSize;
+    std::size_t minimumLag = std::size_t(60.0 / maximumTempoBpm * framesPerSecond);
+    std::size_t maximumLag = std::size_t(60.0 / minimumTempoBpm * framesPerSecond) + 1;
+
+    std::size_t count = std::min(framesAnalyzed, envelopeLength);
+    if (count < 4 * maximumLag)
+    {
+        return;
+    }
+
+    // Copy the history out of the ring buffer with the mean removed, padded so the correlation can read four at a time
+    std::vector<float> history(count + 4, 0.0f);
+    float mean = 0;
+    for (std::size_t i = 0; i < count; i++)
+    {
+        history[i] = envelopeAt(framesAnalyzed - count + i);
+        mean += history[i];
+    }
+    mean /= count;
+    for (std::size_t i = 0; i < count; i++)
+    {
+        history[i] -= mean;
+    }
+
+    // Autocorrelation for every candidate lag, plus one on each side for the smoothing below
+    std::vector<double> correlations(maximumLag + 2, 0.0);
+    for (std::size_t lag = minimumLag - 1; lag <= maximumLag + 1; lag++)
+    {
+        float4 correlation(0.0f);
+        std::size_t length = (count - lag) & ~std::size_t(3);
+        for (std::size_t i = 0; i < length; i += 4)
+        {
+            correlation += float4::load(&history[i]) * float4::load(&history[i + lag]);
+        }
+        correlations[lag] = horizontalSum(correlation);
+    }
+
+    // Beats rarely fall on exact frame boundaries, so each lag also gets credit from its neighbours. The score is
+    // weighted towards tempos around 120 BPM to avoid locking onto half or double the tempo.
+    double preferredLag = 0.5 * framesPerSecond;
+    double bestScore = 0;
+    std::size_t bestLag = 0;
+    for (std::size_t lag = minimumLag; lag <= maximumLag; lag++)
+    {
+        double correlation = std::max(correlations[lag], 0.5 * (correlations[lag - 1] + correlations[lag + 1]));
+        double octaves = std::log2(double(lag) / preferredLag);
+        double score = correlation * std::exp(-0.5 * octaves * octaves);
+        if (score > bestScore)
+        {
+            bestScore = score;
+            bestLag = lag;
+        }
+    }
+
+    if (bestLag != 0)
+    {
+        currentTempoBpm = 60.0 * framesPerSecond / bestLag;
+    }
+}
+
+void BeatmapBuilder::addOnset(double time, double tempoBpm, std::vector<std::pair<double, KeyFrameAction>> &keyFrames)
+{
+    if (!hasStarted)
+    {
+        keyFrames.emplace_back(0.0, BOTTOM);
+        hasStarted = true;
+    }
+
+    double interval = std::max(minimumHitInterval, 0.9 * 60.0 / tempoBpm);
+    if (time - lastHitTime < interval)
+    {
+        return;
+    }
+
+    keyFrames.emplace_back(lastHitTime + (time - lastHitTime) / 2, TOP);
+    keyFrames.emplace_back(time, BOTTOM);
+    lastHitTime = time;
+}
+
+void BeatmapBuilder::finish(std::vector<std::pair<double, KeyFrameAction>> &keyFrames)
+{
+    if (!hasStarted)
+    {
+        keyFrames.emplace_back(0.0, BOTTOM);
+        hasStarted = true;
+    }
+    // The ball rests on the pad after the last hit. The game expects a keyframe "at infinity" at the end.
+    keyFrames.emplace_back(endOfSongTimestamp, BOTTOM);
+}
+
+// Reads the next chunk of the file and mixes it down to mono. Returns the number of mono samples produced.
+static std::size_t decodeMono(sf::InputSoundFile &file, std::vector<sf::Int16> &decoded, std::vector<float> &mono)
+{
+    unsigned int channels = file.getChannelCount();
+    decoded.resize(decodeChunkSize * channels);
+    std::size_t frames = std::size_t(file.read(decoded.data(), decoded.size())) / channels;
+
+    mono.resize(frames);
+    float scale = 1.0f / (32768.0f * channels);
+    for (std::size_t frame = 0; frame < frames; frame++)
+    {
+        int sum = 0;
+        for (unsigned int channel = 0; channel < channels; channel++)
+        {
+            sum += decoded[frame * channels + channel];
+        }
+        mono[frame] = sum * scale;
+    }
+    return frames;
+}
+
+bool generateBeatmap(const std::string &audioFileName, Beatmap &beatmap)
+{
+    sf::InputSoundFile file;
+    if (!file.openFromFile(audioFileName))
+    {
+        return false;
+    }
+
+    auto startTime = std::chrono::steady_clock::now();
+
+    OnsetDetector detector(file.getSampleRate());
+    BeatmapBuilder builder;
+    std::vector<sf::Int16> decoded;
+    std::vector<float> mono;
+    std::vector<double> onsets;
+    std::vector<std::pair<double, KeyFrameAction>> keyFrames;
+
+    while (decodeMono(file, decoded, mono) > 0)
+    {
+        detector.process(mono.data(), mono.size(), onsets);
+        for (double onset : onsets)
+        {
+            builder.addOnset(onset, detector.tempoBpm(), keyFrames);
+        }
+        onsets.clear();
+    }
+    builder.finish(keyFrames);
+
+    beatmap = Beatmap();
+    for (const auto &keyFrame : keyFrames)
+    {
+        beatmap.append(keyFrame.first, keyFrame.second);
+    }
+
+    double trackSeconds = double(file.getSampleCount()) / file.getChannelCount() / file.getSampleRate();
+    double analysisSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    std::cout << fmt::format("Analyzed {:.1f}s of audio in {:.3f}s ({:.0f}x real time): ~{:.0f} BPM, {} keyframes",
+                             trackSeconds, analysisSeconds, trackSeconds / analysisSeconds, detector.tempoBpm(),
+                             beatmap.size())
+              << std::endl;
+    return true;
+}
+
+StreamingBeatmapGenerator::~StreamingBeatmapGenerator()
+{
+    stop();
+}
+
+bool StreamingBeatmapGenerator::start(const std::string &audioFileName, double lookaheadSeconds)
+{
+    stop();
+
+    // Only the header is read here, to report a missing or unsupported file right away
+    sf::InputSoundFile file;
+    if (!file.openFromFile(audioFileName))
+    {
+        return false;
+    }
+
+    lookahead = lookaheadSeconds;
+    playbackPosition = 0;
+    analyzedUntil = 0;
+    stopRequested = false;
+    finished = false;
+    pendingKeyFrames.clear();
+    worker = std::thread(&StreamingBeatmapGenerator::run, this, audioFileName);
+    return true;
+}
+
+void StreamingBeatmapGenerator::stop()
+{
+    if (worker.joinable())
+    {
+        stopRequested = true;
+        wakeWorker.notify_one();
+        worker.join();
+    }
+}
+
+void StreamingBeatmapGenerator::setPlaybackPosition(double seconds)
+{
+    playbackPosition = seconds;
+    wakeWorker.notify_one();
+}
+
+void StreamingBeatmapGenerator::poll(Beatmap &beatmap)
+{
+    std::unique_lock<std::mutex> lock(mutex, std::try_to_lock);
+    if (!lock.owns_lock())
+    {
+        return;
+    }
+
+    for (const auto &keyFrame : pendingKeyFrames)
+    {
+        beatmap.append(keyFrame.first, keyFrame.second);
+    }
+    pendingKeyFrames.clear();
+}
+
+void StreamingBeatmapGenerator::run(std::string audioFileName)
+{
+    sf::InputSoundFile file;
+    if (!file.openFromFile(audioFileName))
+    {
+        finished = true;
+        return;
+    }
+
+    OnsetDetector detector(file.getSampleRate());
+    BeatmapBuilder builder;
+    std::vector<sf::Int16> decoded;
+    std::vector<float> mono;
+    std::vector<double> onsets;
+    std::vector<std::pair<double, KeyFrameAction>> keyFrames;
+    std::size_t samplesDecoded = 0;
+
+    while (!stopRequested)
+    {
+        if (analyzedUntil > playbackPosition + lookahead)
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wakeWorker.wait_for(lock, std::chrono::milliseconds(50));
+            continue;
+        }
+
+        std::size_t frames = decodeMono(file, decoded, mono);
+        if (frames == 0)
+        {
+            builder.finish(keyFrames);
+        }
+        else
+        {
+            detector.process(mono.data(), mono.size(), onsets);
+            for (double onset : onsets)
+            {
+                builder.addOnset(onset, detector.tempoBpm(), keyFrames);
+            }
+            onsets.clear();
+        }
+
+        if (!keyFrames.empty())
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pendingKeyFrames.insert(pendingKeyFrames.end(), keyFrames.begin(), keyFrames.end());
+            keyFrames.clear();
+        }
+
+        if (frames == 0)
+        {
+            break;
+        }
+        samplesDecoded += frames;
+        analyzedUntil = double(samplesDecoded) / file.getSampleRate() - detector.latencySeconds();
+    }
+
+    finished = true;
+}
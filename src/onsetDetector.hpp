@@ -0,0 +1,112 @@
+#pragma once
+
+#include "beatmap.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utilities/fft.h>
+#include <utility>
+#include <vector>
+
+// Spectral flux onset detector with a simple autocorrelation tempo tracker. Samples are fed in as they are decoded, and
+// onsets are reported a fixed, small number of analysis frames after they happen (see latencySeconds()).
+class OnsetDetector
+{
+  public:
+    explicit OnsetDetector(unsigned int sampleRate);
+
+    // Feeds mono samples. Detected onsets, in seconds from the first sample, are appended to onsets.
+    void process(const float *samples, std::size_t count, std::vector<double> &onsets);
+
+    double tempoBpm() const
+    {
+        return currentTempoBpm;
+    }
+    double latencySeconds() const;
+
+  private:
+    void analyzeFrame(std::vector<double> &onsets);
+    void pickPeak(std::vector<double> &onsets);
+    void estimateTempo();
+    float envelopeAt(std::size_t frame) const;
+
+    unsigned int sampleRate;
+    FFT fft;
+
+    std::vector<float> window;
+    std::vector<float> frameSamples;
+    std::size_t bufferedSamples = 0;
+
+    std::vector<float> real;
+    std::vector<float> imaginary;
+    std::vector<float> spectrum;
+    std::vector<float> previousSpectrum;
+
+    // Ring buffer with the most recent values of the onset envelope (the spectral flux per frame)
+    std::vector<float> envelope;
+    std::size_t framesAnalyzed = 0;
+    std::size_t lastOnsetFrame = 0;
+    float envelopePeak = 0;
+
+    double currentTempoBpm = 120;
+};
+
+// Turns onsets into keyframes. Every onset far enough from the previous one becomes a pad hit (BOTTOM), and the ball
+// is at the top halfway between two hits.
+class BeatmapBuilder
+{
+  public:
+    void addOnset(double time, double tempoBpm, std::vector<std::pair<double, KeyFrameAction>> &keyFrames);
+    void finish(std::vector<std::pair<double, KeyFrameAction>> &keyFrames);
+
+  private:
+    bool hasStarted = false;
+    double lastHitTime = 0;
+};
+
+// Decodes a whole track and generates a beatmap for it. Runs much faster than real time.
+bool generateBeatmap(const std::string &audioFileName, Beatmap &beatmap);
+
+// Generates a beatmap on a worker thread while the track is playing. The worker stays a bounded amount of time ahead
+// of the playback position, and the render loop picks up new keyframes with poll(), which never waits for the worker.
+class StreamingBeatmapGenerator
+{
+  public:
+    StreamingBeatmapGenerator() = default;
+    ~StreamingBeatmapGenerator();
+
+    bool start(const std::string &audioFileName, double lookaheadSeconds);
+    void stop();
+
+    void setPlaybackPosition(double seconds);
+    void poll(Beatmap &beatmap);
+
+    bool isFinished() const
+    {
+        return finished;
+    }
+    double analyzedSeconds() const
+    {
+        return analyzedUntil;
+    }
+
+  private:
+    StreamingBeatmapGenerator(StreamingBeatmapGenerator const &) = delete;
+    StreamingBeatmapGenerator &operator=(StreamingBeatmapGenerator const &) = delete;
+
+    void run(std::string audioFileName);
+
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable wakeWorker;
+    std::vector<std::pair<double, KeyFrameAction>> pendingKeyFrames;
+
+    double lookahead = 0;
+    std::atomic<double> playbackPosition{0};
+    std::atomic<double> analyzedUntil{0};
+    std::atomic<bool> stopRequested{false};
+    std::atomic<bool> finished{false};
+};
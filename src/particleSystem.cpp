@@ -0,0 +1,246 @@
+#include "particleSystem.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <glm/gtc/type_ptr.hpp>
+#include <utilities/simd.h>
+
+static const float gravity = 98.0f;
+// Fraction of the velocity left after one second
+static const float airResistance = 0.3f;
+static const float floorRestitution = 0.4f;
+// Particles per task. A multiple of four, so a block never splits a group of four particles.
+static const std::size_t blockSize = 4096;
+// Position and size, then color
+static const std::size_t floatsPerInstance = 8;
+
+ParticleSystem::~ParticleSystem()
+{
+    delete shader;
+}
+
+void ParticleSystem::init(ThreadPool &threadPool, std::size_t maxParticles)
+{
+    pool = &threadPool;
+    capacity = maxParticles;
+    count = 0;
+    stats = Statistics();
+
+    std::size_t paddedCapacity = (capacity + 3) / 4 * 4;
+    for (std::vector<float> *component : {&x, &y, &z, &vx, &vy, &vz, &age, &lifetime, &weight})
+    {
+        component->assign(paddedCapacity, 0.0f);
+    }
+    emitterOf.assign(capacity, 0);
+
+    shader = new Gloom::Shader(GPU_HERE);
+    shader->makeBasicShader("../res/shaders/particle.vert", "../res/shaders/particle.frag");
+    // The quads are generated from the vertex and instance IDs, but a vertex array still has to be bound
+    emptyVertexArray = GLVertexArray("particles", GPU_HERE);
+
+    glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &storageAlignment);
+    storageAlignment = std::max(storageAlignment, 1);
+    instanceBuffer.init(GLsizeiptr(capacity * floatsPerInstance * sizeof(float)) + storageAlignment);
+}
+
+std::size_t ParticleSystem::addEmitter(const ParticleEmitter &emitter)
+{
+    emitters.push_back(emitter);
+    pendingEmission.push_back(0.0f);
+    pendingBursts.push_back(0);
+    return emitters.size() - 1;
+}
+
+void ParticleSystem::burst(std::size_t emitter, std::size_t emitCount)
+{
+    pendingBursts[emitter] += emitCount;
+}
+
+void ParticleSystem::burstAt(std::size_t emitter, std::size_t emitCount, glm::vec3 position)
+{
+    pendingPositionedBursts.push_back({emitter, emitCount, position});
+}
+
+void ParticleSystem::emit(std::size_t emitterIndex, std::size_t emitCount, glm::vec3 origin)
+{
+    const ParticleEmitter &emitter = emitters[emitterIndex];
+    origin += emitter.offset;
+    glm::vec3 velocity = emitter.direction * emitter.speed;
+
+    std::size_t emitted = std::min(emitCount, capacity - count);
+    stats.droppedParticles += emitCount - emitted;
+
+    std::uniform_real_distribution<float> signedUnit(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> lifetimes(emitter.minLifetime, std::max(emitter.minLifetime,
+                                                                                  emitter.maxLifetime));
+    for (std::size_t i = count; i < count + emitted; i++)
+    {
+        x[i] = origin.x;
+        y[i] = origin.y;
+        z[i] = origin.z;
+        vx[i] = velocity.x + signedUnit(random) * emitter.spread;
+        vy[i] = velocity.y + signedUnit(random) * emitter.spread;
+        vz[i] = velocity.z + signedUnit(random) * emitter.spread;
+        age[i] = 0;
+        lifetime[i] = lifetimes(random);
+        weight[i] = gravity * emitter.gravityScale;
+        emitterOf[i] = std::uint16_t(emitterIndex);
+    }
+    count += emitted;
+}
+
+void ParticleSystem::update(float deltaSeconds)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    for (std::size_t emitter = 0; emitter < emitters.size(); emitter++)
+    {
+        pendingEmission[emitter] += emitters[emitter].rate * deltaSeconds;
+        std::size_t continuous = std::size_t(pendingEmission[emitter]);
+        pendingEmission[emitter] -= float(continuous);
+
+        SceneNode *node = emitters[emitter].node.get();
+        if (node != nullptr)
+        {
+            emit(emitter, continuous + pendingBursts[emitter], glm::vec3(node->currentTransformationMatrix[3]));
+        }
+        pendingBursts[emitter] = 0;
+    }
+    for (const PositionedBurst &burst : pendingPositionedBursts)
+    {
+        emit(burst.emitter, burst.count, burst.position);
+    }
+    pendingPositionedBursts.clear();
+
+    std::size_t blockCount = (count + blockSize - 1) / blockSize;
+    pool->parallelFor(blockCount, [&](std::size_t block) { integrate(block, deltaSeconds); });
+    removeDead();
+
+    stats.liveParticles = count;
+    stats.updateSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void ParticleSystem::integrate(std::size_t block, float dt)
+{
+    const float4 dt4(dt);
+    const float4 drag(std::pow(airResistance, dt));
+    const float4 floorY(floorHeight);
+    const float4 bounce(-floorRestitution);
+
+    // Groups of four may run past the last live particle, into the padding or dead particles, which is harmless
+    std::size_t end = std::min(count, (block + 1) * blockSize);
+    for (std::size_t i = block * blockSize; i < end; i += 4)
+    {
+        float4 px = float4::load(&x[i]), py = float4::load(&y[i]), pz = float4::load(&z[i]);
+        float4 velocityX = float4::load(&vx[i]), velocityY = float4::load(&vy[i]), velocityZ = float4::load(&vz[i]);
+
+        velocityY -= float4::load(&weight[i]) * dt4;
+        velocityX *= drag;
+        velocityY *= drag;
+        velocityZ *= drag;
+        px += velocityX * dt4;
+        py += velocityY * dt4;
+        pz += velocityZ * dt4;
+
+        // Particles that went through the floor are put back on it, moving up again
+        float4 belowFloor = (py < floorY) & (velocityY < float4(0.0f));
+        py = select(belowFloor, py, floorY);
+        velocityY = select(belowFloor, velocityY, velocityY * bounce);
+
+        px.store(&x[i]);
+        py.store(&y[i]);
+        pz.store(&z[i]);
+        velocityX.store(&vx[i]);
+        velocityY.store(&vy[i]);
+        velocityZ.store(&vz[i]);
+        (float4::load(&age[i]) + dt4).store(&age[i]);
+    }
+}
+
+void ParticleSystem::removeDead()
+{
+    std::size_t i = 0;
+    while (i < count)
+    {
+        if (age[i] < lifetime[i])
+        {
+            i++;
+            continue;
+        }
+        // The last particle is checked again once it has been moved here
+        std::size_t last = --count;
+        x[i] = x[last];
+        y[i] = y[last];
+        z[i] = z[last];
+        vx[i] = vx[last];
+        vy[i] = vy[last];
+        vz[i] = vz[last];
+        age[i] = age[last];
+        lifetime[i] = lifetime[last];
+        weight[i] = weight[last];
+        emitterOf[i] = emitterOf[last];
+    }
+}
+
+void ParticleSystem::writeInstances(std::size_t block, float *instances) const
+{
+    std::size_t end = std::min(count, (block + 1) * blockSize);
+    for (std::size_t i = block * blockSize; i < end; i++)
+    {
+        const ParticleEmitter &emitter = emitters[emitterOf[i]];
+        float remaining = 1.0f - std::min(age[i] / lifetime[i], 1.0f);
+
+        float *instance = instances + i * floatsPerInstance;
+        instance[0] = x[i];
+        instance[1] = y[i];
+        instance[2] = z[i];
+        instance[3] = emitter.size * remaining;
+        instance[4] = emitter.color.r;
+        instance[5] = emitter.color.g;
+        instance[6] = emitter.color.b;
+        instance[7] = emitter.color.a * remaining;
+    }
+}
+
+void ParticleSystem::render(const glm::mat4 &viewProjection, const glm::mat4 &view, GLuint sceneDepth)
+{
+    stats.uploadSeconds = 0;
+    auto start = std::chrono::steady_clock::now();
+    // The buffer has room for a full pool every frame, so this only fails if mapping the buffer failed
+    GpuRingBuffer::Allocation allocation =
+        instanceBuffer.allocate(GLsizeiptr(count * floatsPerInstance * sizeof(float)), storageAlignment);
+    if (allocation)
+    {
+        float *instances = static_cast<float *>(allocation.pointer);
+        std::size_t blockCount = (count + blockSize - 1) / blockSize;
+        pool->parallelFor(blockCount, [&](std::size_t block) { writeInstances(block, instances); });
+        stats.uploadSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        shader->activate();
+        // The rows of the camera rotation are the world space directions of the screen axes
+        glm::vec3 cameraRight(view[0][0], view[1][0], view[2][0]);
+        glm::vec3 cameraUp(view[0][1], view[1][1], view[2][1]);
+        glUniformMatrix4fv(shader->getUniformFromName("VP"), 1, GL_FALSE, glm::value_ptr(viewProjection));
+        glUniform3fv(shader->getUniformFromName("cameraRight"), 1, glm::value_ptr(cameraRight));
+        glUniform3fv(shader->getUniformFromName("cameraUp"), 1, glm::value_ptr(cameraUp));
+        glUniform1i(shader->getUniformFromName("useSceneDepth"), sceneDepth != 0);
+        if (sceneDepth != 0)
+        {
+            glBindTextureUnit(0, sceneDepth);
+            glDisable(GL_DEPTH_TEST);
+        }
+        instanceBuffer.bindRange(GL_SHADER_STORAGE_BUFFER, 0, allocation);
+        glBindVertexArray(emptyVertexArray.id());
+
+        glDepthMask(GL_FALSE);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE);
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, GLsizei(count));
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glDisable(GL_BLEND);
+        glDepthMask(GL_TRUE);
+        glEnable(GL_DEPTH_TEST);
+    }
+
+    instanceBuffer.endFrame();
+}
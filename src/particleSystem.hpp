@@ -0,0 +1,134 @@
+#pragma once
+
+#include "sceneGraph.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <random>
+#include <utilities/gpuResource.h>
+#include <utilities/gpuRingBuffer.h>
+#include <utilities/shader.hpp>
+#include <utilities/threadPool.h>
+#include <vector>
+
+// Where and how an emitter spawns particles. Particles start at the world position of the node plus the offset.
+struct ParticleEmitter
+{
+    SceneNodeHandle node;
+    glm::vec3 offset = glm::vec3(0);
+    // Particles per second, emitted continuously on top of any bursts
+    float rate = 0;
+    // Starting velocity is direction * speed, plus a random velocity of up to spread along every axis
+    glm::vec3 direction = glm::vec3(0, 1, 0);
+    float speed = 10;
+    float spread = 5;
+    // Random between minLifetime and maxLifetime seconds
+    float minLifetime = 0.5f;
+    float maxLifetime = 1.0f;
+    // Particles shrink and fade out over their lifetime
+    float size = 1;
+    glm::vec4 color = glm::vec4(1);
+    // 0 for particles that float
+    float gravityScale = 1;
+};
+
+// Particle effects, drawn with a single instanced draw call of camera facing quads. The particles of all emitters
+// share one fixed size pool, kept as separate arrays per component and simulated four at a time on the threads of a
+// pool. A dead particle is replaced by the last live one, so the live particles are always at the start of the arrays.
+// Instances are written straight into a persistently mapped buffer.
+class ParticleSystem
+{
+  public:
+    struct Statistics
+    {
+        std::size_t liveParticles = 0;
+        // Particles that were not emitted because the pool was full, since init()
+        std::size_t droppedParticles = 0;
+        double updateSeconds = 0;
+        double uploadSeconds = 0;
+    };
+
+    ParticleSystem() = default;
+    ~ParticleSystem();
+
+    // Needs an OpenGL context, for the instance buffer and the shader
+    void init(ThreadPool &pool, std::size_t capacity);
+
+    // Returns the index burst() and emitter() take
+    std::size_t addEmitter(const ParticleEmitter &emitter);
+    ParticleEmitter &emitter(std::size_t index)
+    {
+        return emitters[index];
+    }
+    // Emits count particles at the next update()
+    void burst(std::size_t emitter, std::size_t count);
+    // Same, but from the given world position plus the offset of the emitter instead of from its node. For events that
+    // happened during the frame, at a place the node has moved on from by the time the particles are emitted.
+    void burstAt(std::size_t emitter, std::size_t count, glm::vec3 position);
+
+    // Particles bounce off this height instead of falling through the floor
+    void setFloor(float height)
+    {
+        floorHeight = height;
+    }
+
+    // Emits, moves and ages the particles. Emitters follow their node, so the node transformations have to be
+    // up to date.
+    void update(float deltaSeconds);
+
+    // Draws the live particles blended on top of what is in the framebuffer, without writing depth. Depth is tested
+    // against sceneDepth instead of the bound depth buffer if it is given, for when the scene was drawn elsewhere.
+    void render(const glm::mat4 &viewProjection, const glm::mat4 &view, GLuint sceneDepth = 0);
+
+    std::size_t size() const
+    {
+        return count;
+    }
+    const Statistics &statistics() const
+    {
+        return stats;
+    }
+
+  private:
+    ParticleSystem(ParticleSystem const &) = delete;
+    ParticleSystem &operator=(ParticleSystem const &) = delete;
+
+    void emit(std::size_t emitterIndex, std::size_t emitCount, glm::vec3 origin);
+    void integrate(std::size_t block, float dt);
+    void removeDead();
+    void writeInstances(std::size_t block, float *instances) const;
+
+    ThreadPool *pool = nullptr;
+    std::size_t capacity = 0;
+    std::size_t count = 0;
+
+    // Padded to a multiple of four particles
+    std::vector<float> x, y, z;
+    std::vector<float> vx, vy, vz;
+    std::vector<float> age, lifetime;
+    // Acceleration due to gravity, scaled by the emitter
+    std::vector<float> weight;
+    std::vector<std::uint16_t> emitterOf;
+
+    std::vector<ParticleEmitter> emitters;
+    // Fractions of a particle left over from the continuous rate, and bursts waiting for the next update()
+    std::vector<float> pendingEmission;
+    std::vector<std::size_t> pendingBursts;
+    struct PositionedBurst
+    {
+        std::size_t emitter;
+        std::size_t count;
+        glm::vec3 position;
+    };
+    std::vector<PositionedBurst> pendingPositionedBursts;
+    std::mt19937 random;
+    float floorHeight = -1e30f;
+
+    Gloom::Shader *shader = nullptr;
+    GpuRingBuffer instanceBuffer;
+    GLVertexArray emptyVertexArray;
+    GLint storageAlignment = 16;
+
+    Statistics stats;
+};
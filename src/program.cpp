@@ -10,6 +10,7 @@
 #include <glm/gtc/type_ptr.hpp>
 #include <iostream>
 #include <utilities/glutils.h>
+#include <utilities/gpuResource.h>
 #include <utilities/shader.hpp>
 #include <utilities/shapes.h>
 #include <utilities/timeutils.h>
@@ -26,8 +27,8 @@ void runProgram(GLFWwindow *window, CommandLineOptions options)
     // Disable built-in dithering
     glDisable(GL_DITHER);
 
-    // Enable transparency
-    glEnable(GL_BLEND);
+    // Transparency is only enabled by the passes that need it, opaque geometry is drawn without blending
+    glDisable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
     // Set default colour after clearing the colour buffer
@@ -38,19 +39,27 @@ void runProgram(GLFWwindow *window, CommandLineOptions options)
     // Rendering Loop
     while (!glfwWindowShouldClose(window))
     {
+        // The frame limiter waits before reading input rather than before swapping, so the wait does not add to the
+        // input latency
+        waitForNextFrame();
+
+        // Handle events right before the update reads them, so input waits as little as possible for the screen
+        glfwPollEvents();
+        handleKeyboardInput(window);
+
         // Clear colour and depth buffers
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
         updateFrame(window);
         renderFrame(window);
 
-        // Handle other events
-        glfwPollEvents();
-        handleKeyboardInput(window);
-
         // Flip buffers
         glfwSwapBuffers(window);
+        frameSwapped();
     }
+
+    shutdownGame();
+    gpuResources().reportLeaks(std::cerr);
 }
 
 void handleKeyboardInput(GLFWwindow *window)
@@ -0,0 +1,464 @@
+#include "sceneFile.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <fmt/format.h>
+#include <fstream>
+#include <glad/glad.h>
+#include <iostream>
+#include <unordered_map>
+#include <utilities/imageLoader.hpp>
+
+static_assert(sizeof(SceneFileHeader) == 56, "Scene file layout changed");
+static_assert(sizeof(SceneFileNode) == 112, "Scene file layout changed");
+static_assert(sizeof(SceneFileMesh) == 24, "Scene file layout changed");
+static_assert(sizeof(SceneFileVertex) == 56, "Scene file layout changed");
+static_assert(sizeof(SceneFileMaterial) == 12, "Scene file layout changed");
+
+static const uint64_t sectionAlignment = 16;
+
+static uint64_t alignSection(uint64_t offset)
+{
+    return (offset + sectionAlignment - 1) & ~(sectionAlignment - 1);
+}
+
+// Whether count elements of the given size fit in the file at offset, which has to be aligned
+static bool isValidSection(const MappedFile &file, uint64_t offset, uint64_t count, std::size_t size)
+{
+    return offset % sectionAlignment == 0 && offset <= file.size() && count <= (file.size() - offset) / size;
+}
+
+static glm::vec3 loadVector(const float (&source)[3])
+{
+    return glm::vec3(source[0], source[1], source[2]);
+}
+
+static void storeVector(float (&target)[3], glm::vec3 source)
+{
+    target[0] = source.x;
+    target[1] = source.y;
+    target[2] = source.z;
+}
+
+bool SceneFile::load(const std::string &fileName)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    MappedFile mapped;
+    if (!mapped.open(fileName))
+    {
+        std::cerr << "Could not open scene file " << fileName << std::endl;
+        return false;
+    }
+
+    SceneFileHeader header;
+    if (mapped.size() < sizeof(header))
+    {
+        std::cerr << "Scene file " << fileName << " is truncated" << std::endl;
+        return false;
+    }
+    std::memcpy(&header, mapped.data(), sizeof(header));
+
+    if (std::memcmp(header.magic, sceneFileMagic, sizeof(sceneFileMagic)) != 0 || header.version != sceneFileVersion)
+    {
+        std::cerr << fileName << " is not a supported scene file" << std::endl;
+        return false;
+    }
+
+    if (header.nodeCount == 0 || !isValidSection(mapped, header.nodesOffset, header.nodeCount, sizeof(SceneFileNode)) ||
+        !isValidSection(mapped, header.meshesOffset, header.meshCount, sizeof(SceneFileMesh)) ||
+        !isValidSection(mapped, header.materialsOffset, header.materialCount, sizeof(SceneFileMaterial)) ||
+        !isValidSection(mapped, header.stringsOffset, header.stringsSize, 1))
+    {
+        std::cerr << "Scene file " << fileName << " is truncated" << std::endl;
+        return false;
+    }
+
+    const SceneFileNode *fileNodes = reinterpret_cast<const SceneFileNode *>(mapped.data() + header.nodesOffset);
+    const SceneFileMesh *fileMeshes = reinterpret_cast<const SceneFileMesh *>(mapped.data() + header.meshesOffset);
+    const SceneFileMaterial *fileMaterials =
+        reinterpret_cast<const SceneFileMaterial *>(mapped.data() + header.materialsOffset);
+    const char *strings = reinterpret_cast<const char *>(mapped.data() + header.stringsOffset);
+
+    // Checks every reference once, so the rest of loading can trust the file
+    auto isValidString = [&](int32_t offset) {
+        return offset == sceneFileNone || (offset >= 0 && uint32_t(offset) < header.stringsSize);
+    };
+    bool isValid = header.stringsSize == 0 || strings[header.stringsSize - 1] == '\0';
+    for (uint32_t i = 0; i < header.meshCount && isValid; i++)
+    {
+        const SceneFileMesh &mesh = fileMeshes[i];
+        isValid = isValidSection(mapped, mesh.verticesOffset, mesh.vertexCount, sizeof(SceneFileVertex)) &&
+                  isValidSection(mapped, mesh.indicesOffset, mesh.indexCount, sizeof(uint32_t));
+        // The GPU would read past the vertex buffer, and the culler past the occluder vertices
+        for (uint32_t index = 0; index < mesh.indexCount && isValid; index++)
+        {
+            const uint32_t *indices = reinterpret_cast<const uint32_t *>(mapped.data() + mesh.indicesOffset);
+            isValid = indices[index] < mesh.vertexCount;
+        }
+    }
+    for (uint32_t i = 0; i < header.materialCount && isValid; i++)
+    {
+        const SceneFileMaterial &material = fileMaterials[i];
+        isValid = isValidString(material.diffuse) && isValidString(material.normalMap) &&
+                  isValidString(material.roughnessMap);
+    }
+    for (uint32_t i = 0; i < header.nodeCount && isValid; i++)
+    {
+        const SceneFileNode &node = fileNodes[i];
+        isValid = (i == 0 ? node.parent == sceneFileNone : node.parent >= 0 && uint32_t(node.parent) < i) &&
+                  node.type <= SPOT_LIGHT && node.name < header.stringsSize &&
+                  node.mesh >= sceneFileNone && node.mesh < int32_t(header.meshCount) &&
+                  node.occluderMesh >= sceneFileNone && node.occluderMesh < int32_t(header.meshCount) &&
+                  node.material >= sceneFileNone && node.material < int32_t(header.materialCount);
+    }
+    if (!isValid)
+    {
+        std::cerr << "Scene file " << fileName << " is corrupt" << std::endl;
+        return false;
+    }
+
+    // The culler reads the occluder meshes on the CPU
+    std::vector<int> occluderIndices(header.meshCount, -1);
+    std::size_t occluderCount = 0;
+    for (uint32_t i = 0; i < header.nodeCount; i++)
+    {
+        int32_t mesh = fileNodes[i].occluderMesh;
+        if (mesh != sceneFileNone && occluderIndices[mesh] == -1)
+        {
+            occluderIndices[mesh] = int(occluderCount++);
+        }
+    }
+
+    file = std::move(mapped);
+
+    // Materials share textures by file name
+    std::unordered_map<std::string, GLuint> texturesByFile;
+    auto loadTexture = [&](int32_t name, std::string &materialFile) -> GLuint {
+        if (name == sceneFileNone)
+        {
+            return 0;
+        }
+        materialFile = strings + name;
+        auto found = texturesByFile.find(materialFile);
+        if (found != texturesByFile.end())
+        {
+            return found->second;
+        }
+        textures.push_back(genTexture(loadPNGFile(materialFile), materialFile, GPU_HERE));
+        texturesByFile[materialFile] = textures.back().id();
+        return textures.back().id();
+    };
+    struct MaterialTextures
+    {
+        GLuint diffuse, normalMap, roughnessMap;
+    };
+    std::vector<MaterialTextures> materialTextures(header.materialCount);
+    materials.resize(header.materialCount);
+    for (uint32_t i = 0; i < header.materialCount; i++)
+    {
+        materialTextures[i].diffuse = loadTexture(fileMaterials[i].diffuse, materials[i].diffuseFile);
+        materialTextures[i].normalMap = loadTexture(fileMaterials[i].normalMap, materials[i].normalMapFile);
+        materialTextures[i].roughnessMap = loadTexture(fileMaterials[i].roughnessMap, materials[i].roughnessMapFile);
+    }
+
+    meshes.resize(header.meshCount);
+    occluders.resize(occluderCount);
+    for (uint32_t i = 0; i < header.meshCount; i++)
+    {
+        const SceneFileMesh &fileMesh = fileMeshes[i];
+        const unsigned char *vertices = file.data() + fileMesh.verticesOffset;
+        const unsigned char *indices = file.data() + fileMesh.indicesOffset;
+        std::size_t verticesSize = std::size_t(fileMesh.vertexCount) * sizeof(SceneFileVertex);
+        std::size_t indicesSize = std::size_t(fileMesh.indexCount) * sizeof(uint32_t);
+
+        MeshBuffers &buffers = meshes[i];
+        buffers.vertexArray = GLVertexArray(fileName, GPU_HERE);
+        glBindVertexArray(buffers.vertexArray.id());
+
+        GLBuffer vertexBuffer(fileName, GPU_HERE);
+        glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer.id());
+        glBufferData(GL_ARRAY_BUFFER, verticesSize, vertices, GL_STATIC_DRAW);
+        vertexBuffer.setBytes(verticesSize);
+
+        // Same attribute locations as generateBuffer()
+        const GLsizei stride = sizeof(SceneFileVertex);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void *)offsetof(SceneFileVertex, position));
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_TRUE, stride, (void *)offsetof(SceneFileVertex, normal));
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void *)offsetof(SceneFileVertex, textureCoordinates));
+        glVertexAttribPointer(3, 3, GL_FLOAT, GL_TRUE, stride, (void *)offsetof(SceneFileVertex, tangent));
+        glVertexAttribPointer(4, 3, GL_FLOAT, GL_TRUE, stride, (void *)offsetof(SceneFileVertex, bitangent));
+        for (GLuint attribute = 0; attribute < 5; attribute++)
+        {
+            glEnableVertexAttribArray(attribute);
+        }
+
+        GLBuffer indexBuffer(fileName, GPU_HERE);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer.id());
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indicesSize, indices, GL_STATIC_DRAW);
+        indexBuffer.setBytes(indicesSize);
+
+        buffers.buffers.push_back(std::move(vertexBuffer));
+        buffers.buffers.push_back(std::move(indexBuffer));
+        buffers.indexCount = fileMesh.indexCount;
+        glBindVertexArray(0);
+
+        if (occluderIndices[i] != -1)
+        {
+            Mesh &occluder = occluders[occluderIndices[i]];
+            const SceneFileVertex *fileVertices = reinterpret_cast<const SceneFileVertex *>(vertices);
+            occluder.vertices.reserve(fileMesh.vertexCount);
+            for (uint32_t vertex = 0; vertex < fileMesh.vertexCount; vertex++)
+            {
+                occluder.vertices.push_back(loadVector(fileVertices[vertex].position));
+            }
+            const uint32_t *fileIndices = reinterpret_cast<const uint32_t *>(indices);
+            occluder.indices.assign(fileIndices, fileIndices + fileMesh.indexCount);
+        }
+    }
+
+    nodes.resize(header.nodeCount);
+    for (uint32_t i = 0; i < header.nodeCount; i++)
+    {
+        const SceneFileNode &fileNode = fileNodes[i];
+        SceneNodeHandle handle = fileNode.type == POINT_LIGHT ? createLightSceneNode() : createSceneNode();
+        nodes[i] = handle;
+
+        SceneNode *node = handle.get();
+        node->nodeType = SceneNodeType(fileNode.type);
+        node->name = strings + fileNode.name;
+        node->position = loadVector(fileNode.position);
+        node->rotation = loadVector(fileNode.rotation);
+        node->scale = loadVector(fileNode.scale);
+        node->referencePoint = loadVector(fileNode.referencePoint);
+        node->lightColor = loadVector(fileNode.lightColor);
+        node->isStatic = (fileNode.flags & SCENE_FILE_STATIC) != 0;
+        node->castsShadows = (fileNode.flags & SCENE_FILE_CASTS_SHADOWS) != 0;
+        node->hasBounds = (fileNode.flags & SCENE_FILE_HAS_BOUNDS) != 0;
+        node->boundsMin = loadVector(fileNode.boundsMin);
+        node->boundsMax = loadVector(fileNode.boundsMax);
+
+        if (fileNode.mesh != sceneFileNone)
+        {
+            node->vertexArrayObjectID = meshes[fileNode.mesh].vertexArray.id();
+            node->VAOIndexCount = meshes[fileNode.mesh].indexCount;
+        }
+        if (fileNode.occluderMesh != sceneFileNone)
+        {
+            node->occluderMesh = &occluders[occluderIndices[fileNode.occluderMesh]];
+        }
+        if (fileNode.material != sceneFileNone)
+        {
+            node->material = &materials[fileNode.material];
+            node->textureID = materialTextures[fileNode.material].diffuse;
+            node->normalMapTextureID = materialTextures[fileNode.material].normalMap;
+            node->roughnessMapTextureID = materialTextures[fileNode.material].roughnessMap;
+        }
+
+        if (fileNode.parent != sceneFileNone)
+        {
+            addChild(nodes[fileNode.parent], handle);
+        }
+    }
+    rootNode = nodes[0];
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << fmt::format("Loaded {} nodes and {} meshes from {} in {:.1f} ms", header.nodeCount, header.meshCount,
+                             fileName, seconds * 1000.0)
+              << std::endl;
+    return true;
+}
+
+SceneNodeHandle SceneFile::findNode(const char *name) const
+{
+    for (SceneNodeHandle node : nodes)
+    {
+        if (node.isAlive() && std::strcmp(node->name, name) == 0)
+        {
+            return node;
+        }
+    }
+    return SceneNodeHandle();
+}
+
+// Everything needed for writing a scene file, gathered from the scene graph
+struct SceneExport
+{
+    std::vector<SceneFileNode> nodes;
+    std::vector<const Mesh *> meshes;
+    std::vector<const Material *> materials;
+    std::string strings;
+    bool missedGeometry = false;
+
+    int32_t addString(const std::string &text)
+    {
+        int32_t offset = int32_t(strings.size());
+        strings += text;
+        strings.push_back('\0');
+        return offset;
+    }
+
+    template <class T> static int32_t indexOf(std::vector<const T *> &list, const T *item)
+    {
+        if (item == nullptr)
+        {
+            return sceneFileNone;
+        }
+        auto found = std::find(list.begin(), list.end(), item);
+        if (found != list.end())
+        {
+            return int32_t(found - list.begin());
+        }
+        list.push_back(item);
+        return int32_t(list.size() - 1);
+    }
+
+    void addNode(const SceneNode *node, int32_t parent)
+    {
+        SceneFileNode fileNode = {};
+        fileNode.parent = parent;
+        fileNode.type = node->nodeType;
+        fileNode.name = uint32_t(addString(node->name));
+        fileNode.mesh = indexOf(meshes, node->mesh);
+        fileNode.occluderMesh = indexOf(meshes, node->occluderMesh);
+        fileNode.material = indexOf(materials, node->material);
+        fileNode.flags = (node->isStatic ? uint32_t(SCENE_FILE_STATIC) : 0) |
+                         (node->castsShadows ? uint32_t(SCENE_FILE_CASTS_SHADOWS) : 0) |
+                         (node->hasBounds ? uint32_t(SCENE_FILE_HAS_BOUNDS) : 0);
+        storeVector(fileNode.position, node->position);
+        storeVector(fileNode.rotation, node->rotation);
+        storeVector(fileNode.scale, node->scale);
+        storeVector(fileNode.referencePoint, node->referencePoint);
+        storeVector(fileNode.boundsMin, node->boundsMin);
+        storeVector(fileNode.boundsMax, node->boundsMax);
+        storeVector(fileNode.lightColor, node->lightColor);
+        missedGeometry = missedGeometry || (node->vertexArrayObjectID != -1 && node->mesh == nullptr);
+
+        int32_t index = int32_t(nodes.size());
+        nodes.push_back(fileNode);
+        for (SceneNodeHandle child : node->children)
+        {
+            addNode(child.get(), index);
+        }
+    }
+};
+
+// Interleaves the vertices and computes the tangents per triangle, like generateBuffer() does
+static std::vector<SceneFileVertex> interleaveVertices(const Mesh &mesh)
+{
+    bool hasNormals = mesh.normals.size() == mesh.vertices.size();
+    bool hasTextureCoordinates = mesh.textureCoordinates.size() == mesh.vertices.size();
+
+    std::vector<SceneFileVertex> vertices(mesh.vertices.size(), SceneFileVertex());
+    for (std::size_t i = 0; i < mesh.vertices.size(); i++)
+    {
+        SceneFileVertex &vertex = vertices[i];
+        storeVector(vertex.position, mesh.vertices[i]);
+        if (hasNormals)
+        {
+            storeVector(vertex.normal, mesh.normals[i]);
+        }
+        if (hasTextureCoordinates)
+        {
+            vertex.textureCoordinates[0] = mesh.textureCoordinates[i].x;
+            vertex.textureCoordinates[1] = mesh.textureCoordinates[i].y;
+        }
+    }
+
+    if (hasNormals && hasTextureCoordinates)
+    {
+        for (std::size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+        {
+            const unsigned int *index = &mesh.indices[i];
+            glm::vec3 deltaPos1 = mesh.vertices[index[1]] - mesh.vertices[index[0]];
+            glm::vec3 deltaPos2 = mesh.vertices[index[2]] - mesh.vertices[index[0]];
+            glm::vec2 deltaUV1 = mesh.textureCoordinates[index[1]] - mesh.textureCoordinates[index[0]];
+            glm::vec2 deltaUV2 = mesh.textureCoordinates[index[2]] - mesh.textureCoordinates[index[0]];
+
+            float r = 1.0f / (deltaUV1.x * deltaUV2.y - deltaUV1.y * deltaUV2.x);
+            glm::vec3 tangent = (deltaPos1 * deltaUV2.y - deltaPos2 * deltaUV1.y) * r;
+            glm::vec3 bitangent = (deltaPos2 * deltaUV1.x - deltaPos1 * deltaUV2.x) * r;
+            for (int corner = 0; corner < 3; corner++)
+            {
+                storeVector(vertices[index[corner]].tangent, tangent);
+                storeVector(vertices[index[corner]].bitangent, bitangent);
+            }
+        }
+    }
+    return vertices;
+}
+
+bool exportScene(const std::string &fileName, SceneNodeHandle root)
+{
+    SceneExport scene;
+    scene.addNode(root.get(), sceneFileNone);
+    if (scene.missedGeometry)
+    {
+        std::cerr << "Some nodes have no CPU side mesh, and are exported without geometry" << std::endl;
+    }
+
+    std::vector<SceneFileMaterial> materials;
+    for (const Material *material : scene.materials)
+    {
+        auto addFile = [&](const std::string &file) {
+            return file.empty() ? sceneFileNone : scene.addString(file);
+        };
+        materials.push_back({addFile(material->diffuseFile), addFile(material->normalMapFile),
+                             addFile(material->roughnessMapFile)});
+    }
+
+    SceneFileHeader header = {};
+    std::memcpy(header.magic, sceneFileMagic, sizeof(sceneFileMagic));
+    header.version = sceneFileVersion;
+    header.nodeCount = uint32_t(scene.nodes.size());
+    header.meshCount = uint32_t(scene.meshes.size());
+    header.materialCount = uint32_t(materials.size());
+    header.stringsSize = uint32_t(scene.strings.size());
+
+    header.nodesOffset = alignSection(sizeof(header));
+    header.meshesOffset = alignSection(header.nodesOffset + scene.nodes.size() * sizeof(SceneFileNode));
+    header.materialsOffset = alignSection(header.meshesOffset + scene.meshes.size() * sizeof(SceneFileMesh));
+    header.stringsOffset = alignSection(header.materialsOffset + materials.size() * sizeof(SceneFileMaterial));
+
+    std::vector<SceneFileMesh> meshes;
+    uint64_t offset = header.stringsOffset + scene.strings.size();
+    for (const Mesh *mesh : scene.meshes)
+    {
+        SceneFileMesh fileMesh;
+        fileMesh.vertexCount = uint32_t(mesh->vertices.size());
+        fileMesh.indexCount = uint32_t(mesh->indices.size());
+        fileMesh.verticesOffset = alignSection(offset);
+        fileMesh.indicesOffset = alignSection(fileMesh.verticesOffset + fileMesh.vertexCount * sizeof(SceneFileVertex));
+        offset = fileMesh.indicesOffset + fileMesh.indexCount * sizeof(uint32_t);
+        meshes.push_back(fileMesh);
+    }
+
+    std::ofstream out(fileName, std::ios::binary);
+    if (!out)
+    {
+        std::cerr << "Could not open " << fileName << " for writing" << std::endl;
+        return false;
+    }
+
+    uint64_t written = 0;
+    auto writeAt = [&](uint64_t position, const void *data, std::size_t size) {
+        static const char padding[sectionAlignment] = {};
+        out.write(padding, std::streamsize(position - written));
+        out.write(reinterpret_cast<const char *>(data), std::streamsize(size));
+        written = position + size;
+    };
+
+    writeAt(0, &header, sizeof(header));
+    writeAt(header.nodesOffset, scene.nodes.data(), scene.nodes.size() * sizeof(SceneFileNode));
+    writeAt(header.meshesOffset, meshes.data(), meshes.size() * sizeof(SceneFileMesh));
+    writeAt(header.materialsOffset, materials.data(), materials.size() * sizeof(SceneFileMaterial));
+    writeAt(header.stringsOffset, scene.strings.data(), scene.strings.size());
+    for (std::size_t i = 0; i < scene.meshes.size(); i++)
+    {
+        std::vector<SceneFileVertex> vertices = interleaveVertices(*scene.meshes[i]);
+        writeAt(meshes[i].verticesOffset, vertices.data(), vertices.size() * sizeof(SceneFileVertex));
+        writeAt(meshes[i].indicesOffset, scene.meshes[i]->indices.data(), meshes[i].indexCount * sizeof(uint32_t));
+    }
+    return bool(out);
+}
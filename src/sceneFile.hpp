@@ -0,0 +1,124 @@
+#pragma once
+
+#include "sceneGraph.hpp"
+#include <cstdint>
+#include <string>
+#include <utilities/glutils.h>
+#include <utilities/gpuResource.h>
+#include <utilities/mappedFile.h>
+#include <utilities/mesh.h>
+#include <vector>
+
+// Binary scene layout (little endian). All offsets are from the start of the file, and every section starts on a 16
+// byte boundary, so the file can be memory mapped and used without parsing:
+//
+//   SceneFileHeader
+//   SceneFileNode     nodes[nodeCount]          parents come before their children
+//   SceneFileMesh     meshes[meshCount]
+//   SceneFileMaterial materials[materialCount]
+//   char              strings[stringsSize]      zero terminated, referred to by their offset in this table
+//   for every mesh:   SceneFileVertex vertices[vertexCount], uint32_t indices[indexCount]
+struct SceneFileHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t nodeCount;
+    uint32_t meshCount;
+    uint32_t materialCount;
+    uint32_t stringsSize;
+    uint64_t nodesOffset;
+    uint64_t meshesOffset;
+    uint64_t materialsOffset;
+    uint64_t stringsOffset;
+};
+
+const char sceneFileMagic[4] = {'G', 'S', 'C', 'N'};
+const uint32_t sceneFileVersion = 1;
+const int32_t sceneFileNone = -1;
+
+enum SceneFileNodeFlags : uint32_t
+{
+    SCENE_FILE_STATIC = 1,
+    SCENE_FILE_CASTS_SHADOWS = 2,
+    SCENE_FILE_HAS_BOUNDS = 4
+};
+
+struct SceneFileNode
+{
+    int32_t parent;
+    uint32_t type;
+    uint32_t name;
+    int32_t mesh;
+    int32_t occluderMesh;
+    int32_t material;
+    uint32_t flags;
+    float position[3];
+    float rotation[3];
+    float scale[3];
+    float referencePoint[3];
+    float boundsMin[3];
+    float boundsMax[3];
+    float lightColor[3];
+};
+
+struct SceneFileMesh
+{
+    uint64_t verticesOffset;
+    uint64_t indicesOffset;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+};
+
+// Vertices are stored interleaved, with the tangents already computed
+struct SceneFileVertex
+{
+    float position[3];
+    float normal[3];
+    float textureCoordinates[2];
+    float tangent[3];
+    float bitangent[3];
+};
+
+// Texture file names, or sceneFileNone
+struct SceneFileMaterial
+{
+    int32_t diffuse;
+    int32_t normalMap;
+    int32_t roughnessMap;
+};
+
+// A scene loaded from a scene file. Owns the GPU objects and materials its nodes refer to, and keeps the file mapped,
+// since node names point into it. The nodes themselves belong to the scene graph.
+class SceneFile
+{
+  public:
+    SceneFile() = default;
+
+    // Creates the nodes, with the first node in the file as the root, and uploads the meshes straight from the mapped
+    // file. Nothing is created if the file is invalid.
+    bool load(const std::string &fileName);
+
+    SceneNodeHandle root() const
+    {
+        return rootNode;
+    }
+    // The first node with the given name, or the default handle
+    SceneNodeHandle findNode(const char *name) const;
+
+  private:
+    SceneFile(SceneFile const &) = delete;
+    SceneFile &operator=(SceneFile const &) = delete;
+
+    MappedFile file;
+    SceneNodeHandle rootNode;
+    std::vector<SceneNodeHandle> nodes;
+
+    std::vector<MeshBuffers> meshes;
+    // Only the meshes used as occluders are copied to the CPU
+    std::vector<Mesh> occluders;
+    std::vector<Material> materials;
+    std::vector<GLTexture> textures;
+};
+
+// Writes the tree below root to a scene file. Only nodes with a CPU side mesh keep their geometry.
+bool exportScene(const std::string &fileName, SceneNodeHandle root);
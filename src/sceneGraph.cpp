@@ -1,30 +1,145 @@
 #include "sceneGraph.hpp"
+#include <algorithm>
 
-SceneNode *createSceneNode()
+SceneNodePool sceneNodePool;
+
+SceneNodeHandle SceneNodePool::create()
+{
+    if (firstFree == noFreeSlot)
+    {
+        // Only happens when more nodes are alive than ever before
+        assert(slotCount + chunkSize <= SceneNodeHandle::indexMask + 1 && "Too many scene nodes");
+        chunks.emplace_back(new Slot[chunkSize]);
+        for (std::uint32_t i = 0; i < chunkSize; i++)
+        {
+            chunks.back()[i].nextFree = i + 1 < chunkSize ? slotCount + i + 1 : noFreeSlot;
+        }
+        firstFree = slotCount;
+        slotCount += chunkSize;
+    }
+
+    std::uint32_t index = firstFree;
+    Slot &slot = chunks[index >> chunkBits][index & (chunkSize - 1)];
+    firstFree = slot.nextFree;
+
+    // Start from a fresh node, but hold on to the memory of the child list
+    std::vector<SceneNodeHandle> children = std::move(slot.node.children);
+    children.clear();
+    slot.node = SceneNode();
+    slot.node.children = std::move(children);
+    slot.isAlive = true;
+    liveNodes++;
+
+    SceneNodeHandle handle;
+    handle.value = (slot.generation << SceneNodeHandle::indexBits) | index;
+    return handle;
+}
+
+void SceneNodePool::destroy(SceneNodeHandle handle)
+{
+    if (get(handle) == nullptr)
+    {
+        return;
+    }
+
+    std::uint32_t index = handle.index();
+    Slot &slot = chunks[index >> chunkBits][index & (chunkSize - 1)];
+    slot.isAlive = false;
+    // Generation 0 is never used, so a handle can not have a value of 0 by accident
+    slot.generation = (slot.generation + 1) & SceneNodeHandle::generationMask;
+    if (slot.generation == 0)
+    {
+        slot.generation = 1;
+    }
+    slot.nextFree = firstFree;
+    firstFree = index;
+    liveNodes--;
+}
+
+void SceneNodePool::addLight(SceneNodeHandle light)
+{
+    light->lightIndex = int(lights.size());
+    lights.push_back(light);
+}
+
+void SceneNodePool::removeLight(SceneNodeHandle light)
+{
+    // Move the last light into the freed index
+    int index = light->lightIndex;
+    lights[index] = lights.back();
+    lights[index]->lightIndex = index;
+    lights.pop_back();
+    light->lightIndex = -1;
+}
+
+SceneNodeHandle createSceneNode()
 {
-    return new SceneNode();
+    return sceneNodePool.create();
 }
 
-int SceneNode::lightsCount = 0;
-SceneNode *createLightSceneNode()
+SceneNodeHandle createLightSceneNode()
 {
-    SceneNode *light = new SceneNode();
+    SceneNodeHandle light = sceneNodePool.create();
     light->nodeType = SceneNodeType::POINT_LIGHT;
-    light->lightIndex = SceneNode::lightsCount;
-    SceneNode::lightsCount++;
+    sceneNodePool.addLight(light);
     return light;
 }
 
+static void destroySubtree(SceneNodeHandle handle)
+{
+    SceneNode *node = handle.get();
+    if (node == nullptr)
+    {
+        return;
+    }
+    for (SceneNodeHandle child : node->children)
+    {
+        destroySubtree(child);
+    }
+    if (node->lightIndex != -1)
+    {
+        sceneNodePool.removeLight(handle);
+    }
+    sceneNodePool.destroy(handle);
+}
+
+void destroySceneNode(SceneNodeHandle node)
+{
+    if (!node.isAlive())
+    {
+        return;
+    }
+    if (node->parent.isAlive())
+    {
+        removeChild(node->parent, node);
+    }
+    destroySubtree(node);
+}
+
 // Add a child node to its parent's list of children
-void addChild(SceneNode *parent, SceneNode *child)
+void addChild(SceneNodeHandle parent, SceneNodeHandle child)
 {
     parent->children.push_back(child);
+    child->parent = parent;
+}
+
+// The order of the children does not matter, so the last child takes the place of the removed one
+void removeChild(SceneNodeHandle parent, SceneNodeHandle child)
+{
+    std::vector<SceneNodeHandle> &children = parent->children;
+    auto position = std::find(children.begin(), children.end(), child);
+    if (position != children.end())
+    {
+        *position = children.back();
+        children.pop_back();
+        child->parent = SceneNodeHandle();
+    }
 }
 
-int totalChildren(SceneNode *parent)
+int totalChildren(SceneNodeHandle parent)
 {
     int count = parent->children.size();
-    for (SceneNode *child : parent->children)
+    for (SceneNodeHandle child : parent->children)
     {
         count += totalChildren(child);
     }
@@ -32,7 +147,7 @@ int totalChildren(SceneNode *parent)
 }
 
 // Pretty prints the current values of a SceneNode instance to stdout
-void printNode(SceneNode *node)
+void printNode(SceneNodeHandle node)
 {
     printf("SceneNode {\n"
            "    Child count: %i\n"
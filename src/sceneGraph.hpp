@@ -3,14 +3,20 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/mat4x4.hpp>
+#include <utilities/imageLoader.hpp>
+#include <utilities/mesh.h>
 
+#include <cassert>
 #include <chrono>
+#include <cstdint>
 #include <cstdio>
 #include <cstdlib>
 #include <ctime>
 #include <fstream>
+#include <memory>
 #include <stack>
 #include <stdbool.h>
+#include <string>
 #include <vector>
 
 enum SceneNodeType
@@ -22,6 +28,63 @@ enum SceneNodeType
     SPOT_LIGHT
 };
 
+struct SceneNode;
+
+// Where a node's textures come from, so the scene can be written to a scene file
+struct Material
+{
+    std::string diffuseFile;
+    std::string normalMapFile;
+    std::string roughnessMapFile;
+};
+
+// Refers to a node in the scene node pool. The lower bits are the slot index and the upper bits the generation of the
+// slot, so a handle to a destroyed node is detected instead of silently pointing at whatever reused its slot. The
+// default handle refers to nothing.
+struct SceneNodeHandle
+{
+    static const unsigned int indexBits = 20;
+    static const std::uint32_t indexMask = (1u << indexBits) - 1;
+    static const std::uint32_t generationMask = (1u << (32 - indexBits)) - 1;
+
+    std::uint32_t value = 0;
+
+    std::uint32_t index() const
+    {
+        return value & indexMask;
+    }
+    std::uint32_t generation() const
+    {
+        return value >> indexBits;
+    }
+
+    // The node, or nullptr if it has been destroyed
+    SceneNode *get() const;
+    SceneNode *operator->() const
+    {
+        SceneNode *node = get();
+        assert(node != nullptr && "Use of a destroyed scene node");
+        return node;
+    }
+    bool isAlive() const
+    {
+        return get() != nullptr;
+    }
+    explicit operator bool() const
+    {
+        return value != 0;
+    }
+
+    bool operator==(SceneNodeHandle other) const
+    {
+        return value == other.value;
+    }
+    bool operator!=(SceneNodeHandle other) const
+    {
+        return value != other.value;
+    }
+};
+
 struct SceneNode
 {
     SceneNode()
@@ -41,7 +104,8 @@ struct SceneNode
     // A list of all children that belong to this node.
     // For instance, in case of the scene graph of a human body shown in the assignment text, the "Upper Torso" node
     // would contain the "Left Arm", "Right Arm", "Head" and "Lower Torso" nodes in its list of children.
-    std::vector<SceneNode *> children;
+    std::vector<SceneNodeHandle> children;
+    SceneNodeHandle parent;
 
     // The node's position and rotation relative to its parent
     glm::vec3 position;
@@ -65,21 +129,113 @@ struct SceneNode
     // Node type is used to determine how to handle the contents of a node
     SceneNodeType nodeType;
 
+    // For finding nodes in a loaded scene. Not owned, usually a string literal or a string in the scene file.
+    const char *name = "";
+
+    // Static nodes are expected to rarely move, which lets their shadows be cached
+    bool isStatic = false;
+    bool castsShadows = true;
+
+    // Bounds of the node's own geometry in model space, for occlusion culling. Nodes without bounds are always drawn.
+    bool hasBounds = false;
+    glm::vec3 boundsMin;
+    glm::vec3 boundsMax;
+    // Simplified, closed version of the node's geometry that hides what is behind it, or nullptr. Owned elsewhere.
+    const Mesh *occluderMesh = nullptr;
+
     // Textures
     unsigned int textureID;
     unsigned int normalMapTextureID;
     unsigned int roughnessMapTextureID;
 
-    // Light logic
-    static int lightsCount;
+    // CPU side copies of the geometry and textures, for the software renderer. Owned elsewhere.
+    const Mesh *mesh = nullptr;
+    const PNGImage *diffuseImage = nullptr;
+    const PNGImage *normalMapImage = nullptr;
+    const PNGImage *roughnessMapImage = nullptr;
+    const Material *material = nullptr;
+
+    // Light logic. Light indices are always in the range [0, number of lights).
     int lightIndex;
     glm::vec3 lightColor;
 };
 
-SceneNode *createSceneNode();
-SceneNode *createLightSceneNode();
-void addChild(SceneNode *parent, SceneNode *child);
-void printNode(SceneNode *node);
-int totalChildren(SceneNode *parent);
+// Fixed size chunks of nodes with a free list threaded through the unused slots. Creating and destroying nodes is
+// O(1), and once the pool has grown to the largest number of nodes alive at the same time, it does not touch the heap
+// anymore. Freed nodes keep the capacity of their child list for the next node using the slot.
+class SceneNodePool
+{
+  public:
+    SceneNodeHandle create();
+    void destroy(SceneNodeHandle handle);
+
+    SceneNode *get(SceneNodeHandle handle)
+    {
+        std::uint32_t index = handle.index();
+        if (index >= slotCount)
+        {
+            return nullptr;
+        }
+        Slot &slot = chunks[index >> chunkBits][index & (chunkSize - 1)];
+        return slot.generation == handle.generation() && slot.isAlive ? &slot.node : nullptr;
+    }
+
+    std::size_t liveCount() const
+    {
+        return liveNodes;
+    }
+    std::size_t capacity() const
+    {
+        return slotCount;
+    }
+
+    // Lights are kept in a dense array, so the shader only loops over live lights
+    void addLight(SceneNodeHandle light);
+    void removeLight(SceneNodeHandle light);
+    int lightCount() const
+    {
+        return int(lights.size());
+    }
+    SceneNodeHandle light(int index) const
+    {
+        return lights[index];
+    }
+
+  private:
+    static const unsigned int chunkBits = 8;
+    static const unsigned int chunkSize = 1u << chunkBits;
+    static const std::uint32_t noFreeSlot = ~0u;
+
+    struct Slot
+    {
+        SceneNode node;
+        std::uint32_t generation = 1;
+        std::uint32_t nextFree = noFreeSlot;
+        bool isAlive = false;
+    };
+
+    std::vector<std::unique_ptr<Slot[]>> chunks;
+    std::uint32_t slotCount = 0;
+    std::uint32_t firstFree = noFreeSlot;
+    std::size_t liveNodes = 0;
+
+    std::vector<SceneNodeHandle> lights;
+};
+
+extern SceneNodePool sceneNodePool;
+
+inline SceneNode *SceneNodeHandle::get() const
+{
+    return sceneNodePool.get(*this);
+}
+
+SceneNodeHandle createSceneNode();
+SceneNodeHandle createLightSceneNode();
+// Destroys the node along with all of its children, and detaches it from its parent
+void destroySceneNode(SceneNodeHandle node);
+void addChild(SceneNodeHandle parent, SceneNodeHandle child);
+void removeChild(SceneNodeHandle parent, SceneNodeHandle child);
+void printNode(SceneNodeHandle node);
+int totalChildren(SceneNodeHandle parent);
 
 // For more details, see SceneGraph.cpp.
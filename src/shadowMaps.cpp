@@ -0,0 +1,191 @@
+#include "shadowMaps.hpp"
+#include <algorithm>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+// Distance the light has to move before its cached static map is re-rendered, in world units
+static const float lightMoveThreshold = 0.01f;
+
+PointShadowMaps::~PointShadowMaps()
+{
+    delete shader;
+}
+
+void PointShadowMaps::init(int mapResolution, int lightCount)
+{
+    resolution = mapResolution;
+    maxLights = lightCount;
+    cachedMaps.assign(maxLights, CachedMap());
+
+    shader = new Gloom::Shader(GPU_HERE);
+    shader->attach("../res/shaders/shadow.vert");
+    shader->attach("../res/shaders/shadow.geom");
+    shader->attach("../res/shaders/shadow.frag");
+    shader->link();
+    gpuResources().setTag(GpuResourceType::Program, shader->get(), "shadow.vert");
+
+    // The maps store the distance to the light divided by the range, so they can be sampled with a plain direction
+    staticMaps = GLTexture("static shadow maps", GPU_HERE);
+    shadowMaps = GLTexture("shadow maps", GPU_HERE);
+    for (const GLTexture *maps : {&staticMaps, &shadowMaps})
+    {
+        glBindTexture(GL_TEXTURE_CUBE_MAP_ARRAY, maps->id());
+        glTexStorage3D(GL_TEXTURE_CUBE_MAP_ARRAY, 1, GL_DEPTH_COMPONENT32F, resolution, resolution, 6 * maxLights);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        maps->setBytes(std::size_t(resolution) * resolution * 4 * 6 * maxLights);
+    }
+    glBindTexture(GL_TEXTURE_CUBE_MAP_ARRAY, 0);
+
+    framebuffer = GLFramebuffer("shadow maps", GPU_HERE);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer.id());
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void PointShadowMaps::collectCasters(SceneNodeHandle handle)
+{
+    SceneNode *node = handle.get();
+    bool isGeometry = node->nodeType == GEOMETRY || node->nodeType == NORMAL_MAPPED_GEOMETRY;
+    if (isGeometry && node->castsShadows && node->vertexArrayObjectID != -1)
+    {
+        Caster caster{handle, node->currentTransformationMatrix, GLuint(node->vertexArrayObjectID),
+                      node->VAOIndexCount};
+        (node->isStatic ? staticCasters : dynamicCasters).push_back(caster);
+    }
+    for (SceneNodeHandle child : node->children)
+    {
+        collectCasters(child);
+    }
+}
+
+bool PointShadowMaps::staticCastersMoved()
+{
+    if (staticCasters.size() != previousStaticCasters.size())
+    {
+        return true;
+    }
+    for (std::size_t i = 0; i < staticCasters.size(); i++)
+    {
+        const Caster &current = staticCasters[i];
+        const Caster &previous = previousStaticCasters[i];
+        if (current.node != previous.node || current.transformation != previous.transformation ||
+            current.vertexArrayID != previous.vertexArrayID)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+unsigned int PointShadowMaps::drawCasters(const std::vector<Caster> &casters, SceneNodeHandle exclude)
+{
+    unsigned int drawn = 0;
+    for (const Caster &caster : casters)
+    {
+        // A light does not cast the shadow of the object it is attached to, as it would be inside of it
+        if (caster.node == exclude)
+        {
+            continue;
+        }
+        glUniformMatrix4fv(shader->getUniformFromName("M"), 1, GL_FALSE, glm::value_ptr(caster.transformation));
+        glBindVertexArray(caster.vertexArrayID);
+        glDrawElements(GL_TRIANGLES, caster.indexCount, GL_UNSIGNED_INT, nullptr);
+        drawn++;
+    }
+    return drawn;
+}
+
+void PointShadowMaps::render(SceneNodeHandle root)
+{
+    stats = Statistics();
+
+    staticCasters.clear();
+    dynamicCasters.clear();
+    collectCasters(root);
+    if (staticCastersMoved())
+    {
+        staticGeneration++;
+    }
+    std::swap(staticCasters, previousStaticCasters);
+    const std::vector<Caster> &currentStaticCasters = previousStaticCasters;
+
+    // The six cube faces, in the order of the cube map layers
+    const glm::vec3 faceDirections[6] = {{1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}};
+    const glm::vec3 faceUps[6] = {{0, -1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}, {0, -1, 0}, {0, -1, 0}};
+    const glm::mat4 projection = glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, lightRange);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer.id());
+    glViewport(0, 0, resolution, resolution);
+    glDisable(GL_CULL_FACE);
+    shader->activate();
+    glUniform1f(shader->getUniformFromName("farPlane"), lightRange);
+
+    const float clearDepth = 1.0f;
+    int lights = std::min(sceneNodePool.lightCount(), maxLights);
+    for (int light = 0; light < lights; light++)
+    {
+        SceneNodeHandle lightNode = sceneNodePool.light(light);
+        glm::vec3 lightPosition(lightNode->currentTransformationMatrix[3]);
+
+        glm::mat4 faceTransformations[6];
+        for (int face = 0; face < 6; face++)
+        {
+            faceTransformations[face] =
+                projection * glm::lookAt(lightPosition, lightPosition + faceDirections[face], faceUps[face]);
+        }
+        glUniformMatrix4fv(shader->getUniformFromName("faceVP"), 6, GL_FALSE, glm::value_ptr(faceTransformations[0]));
+        glUniform3fv(shader->getUniformFromName("lightPos"), 1, glm::value_ptr(lightPosition));
+        glUniform1i(shader->getUniformFromName("layerOffset"), light * 6);
+
+        CachedMap &cached = cachedMaps[light];
+        bool lightMoved =
+            cached.light != lightNode || glm::length(cached.lightPosition - lightPosition) >= lightMoveThreshold;
+        if (lightMoved)
+        {
+            // A cache would be out of date again by the next frame, so everything goes straight into the map used for
+            // shading. The cache is only built once the light stays put.
+            cached.isValid = false;
+            cached.light = lightNode;
+            cached.lightPosition = lightPosition;
+
+            glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, shadowMaps.id(), 0);
+            glClearTexSubImage(shadowMaps.id(), 0, 0, 0, light * 6, resolution, resolution, 6, GL_DEPTH_COMPONENT,
+                               GL_FLOAT, &clearDepth);
+            drawCasters(currentStaticCasters, lightNode->parent);
+            stats.dynamicCastersDrawn += drawCasters(dynamicCasters, lightNode->parent);
+            stats.uncachedMapsRendered++;
+            continue;
+        }
+
+        if (!cached.isValid || cached.staticGeneration != staticGeneration)
+        {
+            glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, staticMaps.id(), 0);
+            glClearTexSubImage(staticMaps.id(), 0, 0, 0, light * 6, resolution, resolution, 6, GL_DEPTH_COMPONENT,
+                               GL_FLOAT, &clearDepth);
+            drawCasters(currentStaticCasters, lightNode->parent);
+
+            cached.isValid = true;
+            cached.staticGeneration = staticGeneration;
+            stats.staticMapsRendered++;
+        }
+
+        // Start from the static casters, and add the dynamic ones on top
+        glCopyImageSubData(staticMaps.id(), GL_TEXTURE_CUBE_MAP_ARRAY, 0, 0, 0, light * 6, shadowMaps.id(),
+                           GL_TEXTURE_CUBE_MAP_ARRAY, 0, 0, 0, light * 6, resolution, resolution, 6);
+        glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, shadowMaps.id(), 0);
+        stats.dynamicCastersDrawn += drawCasters(dynamicCasters, lightNode->parent);
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glEnable(GL_CULL_FACE);
+}
+
+void PointShadowMaps::bind(GLuint textureUnit) const
+{
+    glBindTextureUnit(textureUnit, shadowMaps.id());
+}
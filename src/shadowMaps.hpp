@@ -0,0 +1,90 @@
+#pragma once
+
+#include "sceneGraph.hpp"
+#include <cstdint>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <utilities/gpuResource.h>
+#include <utilities/shader.hpp>
+#include <vector>
+
+// Cube shadow maps for the point lights in the scene, all six faces rendered in one pass with layered rendering. Each
+// light that stays put has a cached map with only the static casters, which is re-rendered when a static caster moved.
+// Every frame the cached map is copied into the map used for shading, and the dynamic casters are drawn on top. Lights
+// that moved since the last frame skip the cache and have all casters drawn straight into the map used for shading.
+class PointShadowMaps
+{
+  public:
+    struct Statistics
+    {
+        // Per frame
+        unsigned int staticMapsRendered = 0;
+        // Maps of lights that moved, rendered without the cache
+        unsigned int uncachedMapsRendered = 0;
+        unsigned int dynamicCastersDrawn = 0;
+    };
+
+    PointShadowMaps() = default;
+    ~PointShadowMaps();
+
+    void init(int resolution, int maxLights);
+
+    // Renders the shadow maps of every light below root. Leaves the default framebuffer bound.
+    void render(SceneNodeHandle root);
+
+    void bind(GLuint textureUnit) const;
+    float farPlane() const
+    {
+        return lightRange;
+    }
+    int lightCapacity() const
+    {
+        return maxLights;
+    }
+    const Statistics &statistics() const
+    {
+        return stats;
+    }
+
+  private:
+    PointShadowMaps(PointShadowMaps const &) = delete;
+    PointShadowMaps &operator=(PointShadowMaps const &) = delete;
+
+    struct Caster
+    {
+        SceneNodeHandle node;
+        glm::mat4 transformation;
+        GLuint vertexArrayID;
+        unsigned int indexCount;
+    };
+
+    void collectCasters(SceneNodeHandle handle);
+    bool staticCastersMoved();
+    unsigned int drawCasters(const std::vector<Caster> &casters, SceneNodeHandle exclude);
+
+    Gloom::Shader *shader = nullptr;
+    GLTexture staticMaps;
+    GLTexture shadowMaps;
+    GLFramebuffer framebuffer;
+    int resolution = 0;
+    int maxLights = 0;
+    float lightRange = 300.0f;
+
+    std::vector<Caster> staticCasters;
+    std::vector<Caster> dynamicCasters;
+    std::vector<Caster> previousStaticCasters;
+    // Bumped whenever a static caster moves, appears or disappears
+    std::uint64_t staticGeneration = 0;
+
+    struct CachedMap
+    {
+        bool isValid = false;
+        // Where the light was when its map was last rendered, with or without the cache
+        glm::vec3 lightPosition;
+        SceneNodeHandle light;
+        std::uint64_t staticGeneration = 0;
+    };
+    std::vector<CachedMap> cachedMaps;
+
+    Statistics stats;
+};
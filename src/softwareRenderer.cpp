@@ -0,0 +1,408 @@
+#include "softwareRenderer.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <utilities/simd.h>
+
+// Constants from simple.frag
+static const glm::vec3 ambientColor(0.1f);
+static const float attenuationConstant = 1.0f;
+static const float attenuationLinear = 0.01009f;
+static const float attenuationQuadratic = 0.00107f;
+static const float softShadowRadius = 1.0f;
+
+// Bilinear filtering with repeating texture coordinates, like the OpenGL textures without their mipmaps
+static glm::vec4 sampleImage(const PNGImage &image, glm::vec2 textureCoordinates)
+{
+    int imageWidth = int(image.width);
+    int imageHeight = int(image.height);
+    float x = textureCoordinates.x * imageWidth - 0.5f;
+    float y = textureCoordinates.y * imageHeight - 0.5f;
+    float floorX = std::floor(x);
+    float floorY = std::floor(y);
+    float fractionX = x - floorX;
+    float fractionY = y - floorY;
+
+    int x0 = ((int(floorX) % imageWidth) + imageWidth) % imageWidth;
+    int y0 = ((int(floorY) % imageHeight) + imageHeight) % imageHeight;
+    int x1 = (x0 + 1) % imageWidth;
+    int y1 = (y0 + 1) % imageHeight;
+
+    auto texel = [&](int texelX, int texelY) {
+        const unsigned char *pixel = &image.pixels[(std::size_t(texelY) * imageWidth + texelX) * 4];
+        return glm::vec4(pixel[0], pixel[1], pixel[2], pixel[3]) / 255.0f;
+    };
+    glm::vec4 bottom = texel(x0, y0) * (1 - fractionX) + texel(x1, y0) * fractionX;
+    glm::vec4 top = texel(x0, y1) * (1 - fractionX) + texel(x1, y1) * fractionX;
+    return bottom * (1 - fractionY) + top * fractionY;
+}
+
+// rand() and dither() from simple.frag
+static float dither(glm::vec2 textureCoordinates)
+{
+    float random = std::sin(glm::dot(textureCoordinates, glm::vec2(12.9898f, 78.233f))) * 43758.5453f;
+    random -= std::floor(random);
+    return (random * 2.0f - 1.0f) / 256.0f;
+}
+
+static std::uint8_t toUnorm8(float value)
+{
+    return std::uint8_t(std::min(std::max(value, 0.0f), 1.0f) * 255.0f + 0.5f);
+}
+
+void SoftwareRenderer::init(ThreadPool &threadPool)
+{
+    pool = &threadPool;
+}
+
+void SoftwareRenderer::beginFrame(int frameWidth, int frameHeight, const FrameConstants &frameConstants)
+{
+    constants = frameConstants;
+    width = frameWidth;
+    height = frameHeight;
+    tilesX = (width + tileSize - 1) / tileSize;
+    tilesY = (height + tileSize - 1) / tileSize;
+
+    frame.width = unsigned(width);
+    frame.height = unsigned(height);
+    frame.pixels.resize(std::size_t(width) * height * 4);
+    // Rows are padded to whole groups of four pixels, which are always read and written together
+    depthStride = (width + 3) & ~3;
+    depth.resize(std::size_t(depthStride) * height);
+
+    triangles.clear();
+    tileTriangles.resize(tilesX * tilesY);
+    for (std::vector<unsigned int> &tile : tileTriangles)
+    {
+        tile.clear();
+    }
+    tilePixelsShaded.assign(tilesX * tilesY, 0);
+    stats = Statistics();
+}
+
+void SoftwareRenderer::drawNode(const SceneNode *node)
+{
+    if (node->mesh == nullptr || (node->nodeType != GEOMETRY && node->nodeType != NORMAL_MAPPED_GEOMETRY))
+    {
+        return;
+    }
+    auto start = std::chrono::steady_clock::now();
+
+    const Mesh &mesh = *node->mesh;
+    const glm::mat4 &model = node->currentTransformationMatrix;
+    const glm::mat3 &normalMatrix = node->currentNormalMatrix;
+    bool hasNormals = mesh.normals.size() == mesh.vertices.size();
+    bool hasTextureCoordinates = mesh.textureCoordinates.size() == mesh.vertices.size();
+
+    // What simple.vert does
+    vertices.resize(mesh.vertices.size());
+    for (std::size_t i = 0; i < mesh.vertices.size(); i++)
+    {
+        glm::vec4 worldPosition = model * glm::vec4(mesh.vertices[i], 1.0f);
+        vertices[i].worldPosition = glm::vec3(worldPosition);
+        vertices[i].clipPosition = constants.viewProjection * worldPosition;
+        vertices[i].normal = hasNormals ? glm::normalize(normalMatrix * mesh.normals[i]) : glm::vec3(0);
+        vertices[i].textureCoordinates = hasTextureCoordinates ? mesh.textureCoordinates[i] : glm::vec2(0);
+    }
+
+    for (std::size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+    {
+        stats.trianglesSubmitted++;
+        const unsigned int *index = &mesh.indices[i];
+
+        glm::vec3 tangent(0);
+        glm::vec3 bitangent(0);
+        if (node->nodeType == NORMAL_MAPPED_GEOMETRY && hasTextureCoordinates)
+        {
+            glm::vec3 deltaPos1 = mesh.vertices[index[1]] - mesh.vertices[index[0]];
+            glm::vec3 deltaPos2 = mesh.vertices[index[2]] - mesh.vertices[index[0]];
+            glm::vec2 deltaUV1 = mesh.textureCoordinates[index[1]] - mesh.textureCoordinates[index[0]];
+            glm::vec2 deltaUV2 = mesh.textureCoordinates[index[2]] - mesh.textureCoordinates[index[0]];
+
+            float r = 1.0f / (deltaUV1.x * deltaUV2.y - deltaUV1.y * deltaUV2.x);
+            tangent = glm::normalize(normalMatrix * ((deltaPos1 * deltaUV2.y - deltaPos2 * deltaUV1.y) * r));
+            bitangent = glm::normalize(normalMatrix * ((deltaPos2 * deltaUV1.x - deltaPos1 * deltaUV2.x) * r));
+        }
+
+        // Clip against the near plane, where z = -w. The other planes are handled by the screen bounds.
+        const Vertex *corners[3] = {&vertices[index[0]], &vertices[index[1]], &vertices[index[2]]};
+        Vertex clipped[4];
+        int clippedCount = 0;
+        for (int corner = 0; corner < 3; corner++)
+        {
+            const Vertex &from = *corners[corner];
+            const Vertex &to = *corners[(corner + 1) % 3];
+            float fromDistance = from.clipPosition.z + from.clipPosition.w;
+            float toDistance = to.clipPosition.z + to.clipPosition.w;
+            if (fromDistance >= 0)
+            {
+                clipped[clippedCount++] = from;
+            }
+            if ((fromDistance >= 0) != (toDistance >= 0))
+            {
+                float t = fromDistance / (fromDistance - toDistance);
+                Vertex &split = clipped[clippedCount++];
+                split.clipPosition = from.clipPosition + (to.clipPosition - from.clipPosition) * t;
+                split.worldPosition = from.worldPosition + (to.worldPosition - from.worldPosition) * t;
+                split.normal = from.normal + (to.normal - from.normal) * t;
+                split.textureCoordinates =
+                    from.textureCoordinates + (to.textureCoordinates - from.textureCoordinates) * t;
+            }
+        }
+        for (int corner = 2; corner < clippedCount; corner++)
+        {
+            addTriangle(clipped[0], clipped[corner - 1], clipped[corner], tangent, bitangent, node);
+        }
+    }
+
+    stats.binSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void SoftwareRenderer::addTriangle(const Vertex &v0, const Vertex &v1, const Vertex &v2, glm::vec3 tangent,
+                                   glm::vec3 bitangent, const SceneNode *node)
+{
+    const Vertex *corners[3] = {&v0, &v1, &v2};
+    Triangle triangle;
+    glm::vec3 screen[3];
+    for (int corner = 0; corner < 3; corner++)
+    {
+        const Vertex &vertex = *corners[corner];
+        float inverseW = 1.0f / vertex.clipPosition.w;
+        glm::vec3 ndc = glm::vec3(vertex.clipPosition) * inverseW;
+        screen[corner] = glm::vec3((ndc.x * 0.5f + 0.5f) * width, (ndc.y * 0.5f + 0.5f) * height, ndc.z * 0.5f + 0.5f);
+
+        triangle.inverseW[corner] = inverseW;
+        triangle.worldPosition[corner] = vertex.worldPosition;
+        triangle.normal[corner] = vertex.normal;
+        triangle.textureCoordinates[corner] = vertex.textureCoordinates;
+    }
+
+    // Counter clockwise triangles face the camera, the rest is culled like GL_BACK does
+    float area = (screen[1].x - screen[0].x) * (screen[2].y - screen[0].y) -
+                 (screen[2].x - screen[0].x) * (screen[1].y - screen[0].y);
+    if (area <= 0)
+    {
+        return;
+    }
+
+    // Pixels whose center lies within the triangle's bounds
+    float minX = std::min({screen[0].x, screen[1].x, screen[2].x});
+    float maxX = std::max({screen[0].x, screen[1].x, screen[2].x});
+    float minY = std::min({screen[0].y, screen[1].y, screen[2].y});
+    float maxY = std::max({screen[0].y, screen[1].y, screen[2].y});
+    triangle.minX = std::max(0, int(std::ceil(minX - 0.5f)));
+    triangle.maxX = std::min(width - 1, int(std::floor(maxX - 0.5f)));
+    triangle.minY = std::max(0, int(std::ceil(minY - 0.5f)));
+    triangle.maxY = std::min(height - 1, int(std::floor(maxY - 0.5f)));
+    if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+    {
+        return;
+    }
+
+    // Edge i is the one opposite of vertex i
+    triangle.depthA = triangle.depthB = triangle.depthC = 0;
+    for (int edge = 0; edge < 3; edge++)
+    {
+        const glm::vec3 &from = screen[(edge + 1) % 3];
+        const glm::vec3 &to = screen[(edge + 2) % 3];
+        triangle.edgeA[edge] = (from.y - to.y) / area;
+        triangle.edgeB[edge] = (to.x - from.x) / area;
+        triangle.edgeC[edge] = ((to.y - from.y) * from.x - (to.x - from.x) * from.y) / area;
+
+        triangle.depthA += screen[edge].z * triangle.edgeA[edge];
+        triangle.depthB += screen[edge].z * triangle.edgeB[edge];
+        triangle.depthC += screen[edge].z * triangle.edgeC[edge];
+    }
+    triangle.tangent = tangent;
+    triangle.bitangent = bitangent;
+    triangle.node = node;
+
+    unsigned int index = unsigned(triangles.size());
+    triangles.push_back(triangle);
+    for (int tileY = triangle.minY / tileSize; tileY <= triangle.maxY / tileSize; tileY++)
+    {
+        for (int tileX = triangle.minX / tileSize; tileX <= triangle.maxX / tileSize; tileX++)
+        {
+            tileTriangles[tileY * tilesX + tileX].push_back(index);
+        }
+    }
+}
+
+// What simple.frag does with analytic shadows
+glm::vec3 SoftwareRenderer::shade(const Triangle &triangle, const float barycentric[3]) const
+{
+    auto interpolate = [&](const auto &values) {
+        return values[0] * barycentric[0] + values[1] * barycentric[1] + values[2] * barycentric[2];
+    };
+    glm::vec3 fragmentPosition = interpolate(triangle.worldPosition);
+    glm::vec3 interpolatedNormal = interpolate(triangle.normal);
+    glm::vec2 textureCoordinates = interpolate(triangle.textureCoordinates);
+
+    const SceneNode *node = triangle.node;
+    bool useNormalMap = node->nodeType == NORMAL_MAPPED_GEOMETRY && node->diffuseImage != nullptr &&
+                        node->normalMapImage != nullptr && node->roughnessMapImage != nullptr;
+
+    glm::vec3 normal = glm::normalize(interpolatedNormal);
+    float specularIntensity = 0.3f;
+    if (useNormalMap)
+    {
+        glm::vec3 mapped = glm::vec3(sampleImage(*node->normalMapImage, textureCoordinates)) * 2.0f - 1.0f;
+        normal = triangle.tangent * mapped.x + triangle.bitangent * mapped.y + interpolatedNormal * mapped.z;
+
+        float roughness = glm::length(sampleImage(*node->roughnessMapImage, textureCoordinates));
+        specularIntensity = 5.0f / (roughness * roughness);
+    }
+
+    glm::vec3 viewDirection = glm::normalize(constants.cameraPosition - fragmentPosition);
+    glm::vec3 toBall = constants.ballPosition - fragmentPosition;
+    float ballDistance = glm::length(toBall);
+
+    glm::vec3 resultColor(0);
+    for (const Light &light : constants.lights)
+    {
+        glm::vec3 toLight = light.position - fragmentPosition;
+        float lightDistance = glm::length(toLight);
+        glm::vec3 lightDirection = toLight / lightDistance;
+
+        float shadowFactor = 1.0f;
+        glm::vec3 rejected = toBall - toLight * glm::dot(toBall, toLight) / glm::dot(toLight, toLight);
+        float rejection = glm::length(rejected);
+        if (lightDistance > ballDistance && glm::dot(toLight, toBall) > 0.0f &&
+            rejection < constants.ballRadius + softShadowRadius)
+        {
+            shadowFactor =
+                rejection < constants.ballRadius ? 0.0f : (rejection - constants.ballRadius) / softShadowRadius;
+        }
+
+        float diffuse = std::max(glm::dot(normal, lightDirection), 0.0f);
+        glm::vec3 reflection = glm::reflect(-lightDirection, normal);
+        float specular = std::pow(std::max(glm::dot(viewDirection, reflection), 0.0f), 32.0f) * specularIntensity;
+        float attenuation = 1.0f / (attenuationConstant + attenuationLinear * lightDistance +
+                                    attenuationQuadratic * lightDistance * lightDistance);
+
+        resultColor += (diffuse + specular) * light.color * attenuation * shadowFactor;
+    }
+    resultColor += ambientColor;
+
+    if (useNormalMap)
+    {
+        resultColor *= glm::vec3(sampleImage(*node->diffuseImage, textureCoordinates));
+    }
+    return resultColor + dither(textureCoordinates);
+}
+
+void SoftwareRenderer::rasterizeTile(int tile)
+{
+    const int tileMinX = (tile % tilesX) * tileSize;
+    const int tileMinY = (tile / tilesX) * tileSize;
+    const int tileMaxX = std::min(tileMinX + tileSize, width) - 1;
+    const int tileMaxY = std::min(tileMinY + tileSize, height) - 1;
+
+    const std::uint8_t clearColor[4] = {toUnorm8(constants.clearColor.r), toUnorm8(constants.clearColor.g),
+                                        toUnorm8(constants.clearColor.b), toUnorm8(constants.clearColor.a)};
+    for (int y = tileMinY; y <= tileMaxY; y++)
+    {
+        std::fill_n(depth.begin() + std::size_t(y) * depthStride + tileMinX,
+                    std::min(tileMinX + tileSize, depthStride) - tileMinX, 1.0f);
+        for (int x = tileMinX; x <= tileMaxX; x++)
+        {
+            std::memcpy(&frame.pixels[(std::size_t(y) * width + x) * 4], clearColor, 4);
+        }
+    }
+
+    const float4 laneOffsets(0.5f, 1.5f, 2.5f, 3.5f);
+    const float4 zero(0.0f);
+    unsigned long long pixelsShaded = 0;
+
+    for (unsigned int index : tileTriangles[tile])
+    {
+        const Triangle &triangle = triangles[index];
+        // Tiles start at a multiple of four pixels, so aligning down stays inside the tile
+        int minX = std::max(triangle.minX, tileMinX) & ~3;
+        int maxX = std::min(triangle.maxX, tileMaxX);
+        int minY = std::max(triangle.minY, tileMinY);
+        int maxY = std::min(triangle.maxY, tileMaxY);
+
+        const float4 edgeA0(triangle.edgeA[0]), edgeA1(triangle.edgeA[1]), edgeA2(triangle.edgeA[2]);
+        const float4 depthA(triangle.depthA);
+        // Leaves out the padding pixels past the edge of the image, which can still be inside the triangle
+        const float4 columnLimit(float(maxX) + 1.0f);
+
+        for (int y = minY; y <= maxY; y++)
+        {
+            float centerY = y + 0.5f;
+            float4 rowEdge0(triangle.edgeB[0] * centerY + triangle.edgeC[0]);
+            float4 rowEdge1(triangle.edgeB[1] * centerY + triangle.edgeC[1]);
+            float4 rowEdge2(triangle.edgeB[2] * centerY + triangle.edgeC[2]);
+            float4 rowDepth(triangle.depthB * centerY + triangle.depthC);
+
+            float *depthRow = &depth[std::size_t(y) * depthStride];
+            for (int x = minX; x <= maxX; x += 4)
+            {
+                float4 centerX = float4(float(x)) + laneOffsets;
+                float4 edge0 = edgeA0 * centerX + rowEdge0;
+                float4 edge1 = edgeA1 * centerX + rowEdge1;
+                float4 edge2 = edgeA2 * centerX + rowEdge2;
+                float4 previousDepth = float4::load(depthRow + x);
+                float4 fragmentDepth = depthA * centerX + rowDepth;
+                float4 passed = (edge0 >= zero) & (edge1 >= zero) & (edge2 >= zero) & (centerX < columnLimit) &
+                                (fragmentDepth < previousDepth);
+                int lanes = moveMask(passed);
+                if (lanes == 0)
+                {
+                    continue;
+                }
+                select(passed, previousDepth, fragmentDepth).store(depthRow + x);
+
+                float edges[3][4];
+                edge0.store(edges[0]);
+                edge1.store(edges[1]);
+                edge2.store(edges[2]);
+                for (int lane = 0; lane < 4; lane++)
+                {
+                    if ((lanes & (1 << lane)) == 0)
+                    {
+                        continue;
+                    }
+                    // Screen space barycentrics weighted by 1 / w give the perspective correct ones
+                    float barycentric[3];
+                    float sum = 0;
+                    for (int corner = 0; corner < 3; corner++)
+                    {
+                        barycentric[corner] = edges[corner][lane] * triangle.inverseW[corner];
+                        sum += barycentric[corner];
+                    }
+                    for (float &weight : barycentric)
+                    {
+                        weight /= sum;
+                    }
+
+                    glm::vec3 color = shade(triangle, barycentric);
+                    std::uint8_t *pixel = &frame.pixels[(std::size_t(y) * width + x + lane) * 4];
+                    pixel[0] = toUnorm8(color.r);
+                    pixel[1] = toUnorm8(color.g);
+                    pixel[2] = toUnorm8(color.b);
+                    pixel[3] = 255;
+                    pixelsShaded++;
+                }
+            }
+        }
+    }
+
+    tilePixelsShaded[tile] = pixelsShaded;
+}
+
+void SoftwareRenderer::finishFrame()
+{
+    auto start = std::chrono::steady_clock::now();
+
+    pool->parallelFor(tileTriangles.size(), [this](std::size_t tile) { rasterizeTile(int(tile)); });
+
+    stats.trianglesRasterized = unsigned(triangles.size());
+    for (unsigned long long pixels : tilePixelsShaded)
+    {
+        stats.pixelsShaded += pixels;
+    }
+    stats.rasterSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
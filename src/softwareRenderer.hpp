@@ -0,0 +1,119 @@
+#pragma once
+
+#include "sceneGraph.hpp"
+#include <glm/glm.hpp>
+#include <utilities/imageLoader.hpp>
+#include <utilities/mesh.h>
+#include <utilities/threadPool.h>
+#include <vector>
+
+// Renders scene nodes on the CPU, with the lighting model of simple.vert and simple.frag and the analytic ball shadow,
+// into an image in memory. Triangles are transformed, clipped against the near plane and binned into screen tiles as
+// nodes are drawn, and finishFrame() rasterizes the tiles in parallel. Depth and coverage are tested four pixels at a
+// time, and every tile draws its triangles in submission order, so the image does not depend on the thread count.
+//
+// Every frame: beginFrame(), drawNode() for each node, and finishFrame().
+class SoftwareRenderer
+{
+  public:
+    struct Light
+    {
+        glm::vec3 position;
+        glm::vec3 color;
+    };
+
+    // The uniforms simple.frag gets
+    struct FrameConstants
+    {
+        glm::mat4 viewProjection;
+        glm::vec3 cameraPosition;
+        glm::vec3 ballPosition;
+        float ballRadius;
+        std::vector<Light> lights;
+        glm::vec4 clearColor;
+    };
+
+    struct Statistics
+    {
+        // Per frame
+        unsigned int trianglesSubmitted = 0;
+        unsigned int trianglesRasterized = 0;
+        unsigned long long pixelsShaded = 0;
+        double binSeconds = 0;
+        double rasterSeconds = 0;
+    };
+
+    void init(ThreadPool &pool);
+
+    void beginFrame(int width, int height, const FrameConstants &constants);
+    // Counterpart of drawNode() for the OpenGL renderer. Uses the node's mesh and images instead of its vertex array
+    // and textures, and skips nodes without a mesh and 2D geometry.
+    void drawNode(const SceneNode *node);
+    void finishFrame();
+
+    // RGBA with the bottom row first, like the images loadPNGFile() gives
+    const PNGImage &image() const
+    {
+        return frame;
+    }
+    const Statistics &statistics() const
+    {
+        return stats;
+    }
+
+  private:
+    static const int tileSize = 64;
+
+    struct Vertex
+    {
+        glm::vec4 clipPosition;
+        glm::vec3 worldPosition;
+        glm::vec3 normal;
+        glm::vec2 textureCoordinates;
+    };
+
+    // Edge functions and depth are planes in screen space, evaluated as a * x + b * y + c at the pixel centers. The
+    // edge functions are divided by the area, which makes them the screen space barycentric coordinates.
+    struct Triangle
+    {
+        float edgeA[3], edgeB[3], edgeC[3];
+        float depthA, depthB, depthC;
+        int minX, minY, maxX, maxY;
+
+        // Attributes are interpolated perspective correctly, with the inverse w of each vertex
+        float inverseW[3];
+        glm::vec3 worldPosition[3];
+        glm::vec3 normal[3];
+        glm::vec2 textureCoordinates[3];
+
+        // Constant over the triangle, like the tangents generateBuffer() makes
+        glm::vec3 tangent;
+        glm::vec3 bitangent;
+        const SceneNode *node;
+    };
+
+    void addTriangle(const Vertex &v0, const Vertex &v1, const Vertex &v2, glm::vec3 tangent, glm::vec3 bitangent,
+                     const SceneNode *node);
+    void rasterizeTile(int tile);
+    glm::vec3 shade(const Triangle &triangle, const float barycentric[3]) const;
+
+    ThreadPool *pool = nullptr;
+    FrameConstants constants;
+
+    int width = 0;
+    int height = 0;
+    int tilesX = 0;
+    int tilesY = 0;
+
+    // The node being drawn, after the vertex stage
+    std::vector<Vertex> vertices;
+    std::vector<Triangle> triangles;
+    std::vector<std::vector<unsigned int>> tileTriangles;
+    std::vector<unsigned long long> tilePixelsShaded;
+
+    PNGImage frame;
+    std::vector<float> depth;
+    int depthStride = 0;
+
+    Statistics stats;
+};
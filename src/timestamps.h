@@ -1,11 +1,14 @@
 #pragma once
 
+#include "beatmap.hpp"
+#include <array>
+
 // I recommend closing this file right now.
 // You'll only find despair here
 // And cries of "WHY"
 // Proceed at your own risk.
 
-const std::vector<double> keyFrameTimeStamps = {
+constexpr std::array<double, 318> keyFrameTimeStamps = {{
     0,       0.98,
 
     1.570,   2.102, // block 0
@@ -56,14 +59,14 @@ const std::vector<double> keyFrameTimeStamps = {
     128.097, 128.378, 128.714, 128.963, 129.325, 129.569, 129.872, 130.164,
 
     130.667, 130.877, 131.132, 133.654, 133.842, 134.054, 134.568, 134.768, 135.034, 137.468, 137.707,
-    137.939, 138.388, 138.648, 138.902, 139.346, 139.590, 139.908, 139.379, 139.590, 139.871,
+    137.939, 138.388, 138.648, 138.902, 139.379, 139.590, 139.871,
 
     140.098, 140.352, 140.574, 140.850, 141.105, 141.343,
 
     144.286, 144.367, 144.595,
 
-    9999999};
-const std::vector<KeyFrameAction> keyFrameDirections = {
+    endOfSongTimestamp}};
+constexpr std::array<KeyFrameAction, 318> keyFrameDirections = {{
     BOTTOM, TOP,
 
     BOTTOM, TOP, // Block 0
@@ -114,11 +117,16 @@ const std::vector<KeyFrameAction> keyFrameDirections = {
     BOTTOM, TOP,    BOTTOM, TOP,    BOTTOM, TOP,    BOTTOM, TOP,
 
     TOP,    BOTTOM, TOP,    TOP,    BOTTOM, TOP,    TOP,    BOTTOM, TOP,    TOP, BOTTOM,
-    TOP,    TOP,    BOTTOM, TOP,    TOP,    BOTTOM, TOP,    TOP,    BOTTOM, TOP,
+    TOP,    TOP,    BOTTOM, TOP,    TOP,    BOTTOM, TOP,
 
     BOTTOM, TOP,    BOTTOM, TOP,    BOTTOM, TOP,
 
     TOP,    BOTTOM, TOP,
 
     BOTTOM,
-};
\ No newline at end of file
+}};
+
+static_assert(keyFramesAreSorted(keyFrameTimeStamps), "Keyframe timestamps must be sorted");
+
+constexpr std::array<uint8_t, (keyFrameDirections.size() + 7) / 8> keyFrameDirectionBits =
+    packKeyFrameDirections(keyFrameDirections);
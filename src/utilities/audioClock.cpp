@@ -0,0 +1,102 @@
+#include "audioClock.h"
+#include <algorithm>
+#include <cmath>
+
+// Loop filter gains. The phase gain pulls the estimate towards the audio position, and the (much smaller) frequency
+// gain slowly compensates for the audio device running slightly faster or slower than the steady clock.
+static const double phaseGain = 0.1;
+static const double frequencyGain = 0.01;
+static const double maximumRateDeviation = 0.005;
+
+// Errors larger than this mean the audio jumped (seeking, buffer underruns), so the estimate is reset instead of
+// slowly filtered towards the new position
+static const double resynchronizeThreshold = 0.1;
+
+static double secondsBetween(std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to)
+{
+    return std::chrono::duration<double>(to - from).count();
+}
+
+void AudioClock::start(double startTime)
+{
+    isRunning = true;
+    hasAudioPosition = false;
+    baseTime = std::chrono::steady_clock::now();
+    basePosition = startTime;
+    rate = 1;
+    lastAudioPosition = startTime;
+    lastReportedTime = startTime - outputLatency;
+}
+
+void AudioClock::pause()
+{
+    if (!isRunning)
+    {
+        return;
+    }
+    auto currentTime = std::chrono::steady_clock::now();
+    basePosition = estimateAt(currentTime);
+    baseTime = currentTime;
+    isRunning = false;
+}
+
+void AudioClock::resume()
+{
+    if (isRunning)
+    {
+        return;
+    }
+    baseTime = std::chrono::steady_clock::now();
+    isRunning = true;
+}
+
+void AudioClock::synchronize(double audioPosition)
+{
+    // The device reports the same position until the next chunk is consumed, and those repeats carry no information
+    if (!isRunning || (hasAudioPosition && audioPosition == lastAudioPosition))
+    {
+        return;
+    }
+    lastAudioPosition = audioPosition;
+
+    auto currentTime = std::chrono::steady_clock::now();
+    double error = audioPosition - estimateAt(currentTime);
+
+    if (!hasAudioPosition || std::abs(error) > resynchronizeThreshold)
+    {
+        hasAudioPosition = true;
+        basePosition = audioPosition;
+        baseTime = currentTime;
+        rate = 1;
+        return;
+    }
+
+    basePosition = estimateAt(currentTime) + phaseGain * error;
+    baseTime = currentTime;
+    rate = std::min(std::max(rate + frequencyGain * error, 1 - maximumRateDeviation), 1 + maximumRateDeviation);
+}
+
+double AudioClock::estimateAt(std::chrono::steady_clock::time_point time) const
+{
+    if (!isRunning)
+    {
+        return basePosition;
+    }
+    return basePosition + rate * secondsBetween(baseTime, time);
+}
+
+double AudioClock::rawNow() const
+{
+    return estimateAt(std::chrono::steady_clock::now());
+}
+
+double AudioClock::now() const
+{
+    // Phase corrections may pull the estimate back slightly, but game time should never run backwards
+    double time = rawNow() - outputLatency;
+    if (time > lastReportedTime || std::abs(time - lastReportedTime) > resynchronizeThreshold)
+    {
+        lastReportedTime = time;
+    }
+    return lastReportedTime;
+}
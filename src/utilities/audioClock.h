@@ -0,0 +1,47 @@
+#pragma once
+
+#include <chrono>
+
+// Playback time source that follows the audio device instead of summing up frame times. The position reported by
+// the audio device only changes every time a chunk of samples is consumed, so it is tracked by a small phase-locked
+// loop running on a steady clock, which gives a smooth and monotonic time between the updates. Without any audio, the
+// steady clock is used on its own.
+class AudioClock
+{
+  public:
+    void start(double startTime);
+    void pause();
+    void resume();
+
+    // Feeds the most recent playback position reported by the audio device, in seconds
+    void synchronize(double audioPosition);
+
+    // Time of the sample currently reaching the listener, i.e. corrected for the output latency
+    double now() const;
+    // Same as now(), but without the latency correction
+    double rawNow() const;
+
+    void setOutputLatency(double seconds)
+    {
+        outputLatency = seconds;
+    }
+    double getOutputLatency() const
+    {
+        return outputLatency;
+    }
+
+  private:
+    double estimateAt(std::chrono::steady_clock::time_point time) const;
+
+    bool isRunning = false;
+    bool hasAudioPosition = false;
+
+    // The estimated position is basePosition + rate * (wall time - baseTime)
+    std::chrono::steady_clock::time_point baseTime;
+    double basePosition = 0;
+    double rate = 1;
+
+    double lastAudioPosition = 0;
+    double outputLatency = 0;
+    mutable double lastReportedTime = 0;
+};
@@ -0,0 +1,105 @@
+#include "fft.h"
+#include "simd.h"
+#include <cassert>
+#include <cmath>
+#include <utility>
+
+FFT::FFT(unsigned int size) : n(size)
+{
+    assert(size >= 8 && (size & (size - 1)) == 0);
+
+    unsigned int bits = 0;
+    while ((1u << bits) < n)
+    {
+        bits++;
+    }
+
+    bitReversedIndices.resize(n);
+    for (unsigned int i = 0; i < n; i++)
+    {
+        unsigned int reversed = 0;
+        for (unsigned int bit = 0; bit < bits; bit++)
+        {
+            reversed |= ((i >> bit) & 1) << (bits - 1 - bit);
+        }
+        bitReversedIndices[i] = reversed;
+    }
+
+    twiddleReal.resize(n - 1);
+    twiddleImaginary.resize(n - 1);
+    const double pi = 3.14159265358979323846;
+    for (unsigned int span = 1; span < n; span *= 2)
+    {
+        for (unsigned int k = 0; k < span; k++)
+        {
+            double angle = -pi * double(k) / double(span);
+            twiddleReal[span - 1 + k] = float(std::cos(angle));
+            twiddleImaginary[span - 1 + k] = float(std::sin(angle));
+        }
+    }
+}
+
+void FFT::forward(float *real, float *imaginary) const
+{
+    for (unsigned int i = 0; i < n; i++)
+    {
+        unsigned int j = bitReversedIndices[i];
+        if (i < j)
+        {
+            std::swap(real[i], real[j]);
+            std::swap(imaginary[i], imaginary[j]);
+        }
+    }
+
+    // Spans 1 and 2 have trivial twiddle factors (1 and -i), and too few butterflies per block to vectorize
+    for (unsigned int i = 0; i < n; i += 4)
+    {
+        float r0 = real[i] + real[i + 1], i0 = imaginary[i] + imaginary[i + 1];
+        float r1 = real[i] - real[i + 1], i1 = imaginary[i] - imaginary[i + 1];
+        float r2 = real[i + 2] + real[i + 3], i2 = imaginary[i + 2] + imaginary[i + 3];
+        float r3 = real[i + 2] - real[i + 3], i3 = imaginary[i + 2] - imaginary[i + 3];
+
+        real[i] = r0 + r2;
+        imaginary[i] = i0 + i2;
+        real[i + 2] = r0 - r2;
+        imaginary[i + 2] = i0 - i2;
+        // Multiplying (r3 + i3 i) by -i gives (i3 - r3 i)
+        real[i + 1] = r1 + i3;
+        imaginary[i + 1] = i1 - r3;
+        real[i + 3] = r1 - i3;
+        imaginary[i + 3] = i1 + r3;
+    }
+
+    for (unsigned int span = 4; span < n; span *= 2)
+    {
+        const float *spanTwiddleReal = &twiddleReal[span - 1];
+        const float *spanTwiddleImaginary = &twiddleImaginary[span - 1];
+
+        for (unsigned int block = 0; block < n; block += 2 * span)
+        {
+            float *topReal = real + block;
+            float *topImaginary = imaginary + block;
+            float *bottomReal = topReal + span;
+            float *bottomImaginary = topImaginary + span;
+
+            for (unsigned int k = 0; k < span; k += 4)
+            {
+                float4 wr = float4::load(spanTwiddleReal + k);
+                float4 wi = float4::load(spanTwiddleImaginary + k);
+                float4 br = float4::load(bottomReal + k);
+                float4 bi = float4::load(bottomImaginary + k);
+
+                float4 tr = br * wr - bi * wi;
+                float4 ti = br * wi + bi * wr;
+
+                float4 ar = float4::load(topReal + k);
+                float4 ai = float4::load(topImaginary + k);
+
+                (ar + tr).store(topReal + k);
+                (ai + ti).store(topImaginary + k);
+                (ar - tr).store(bottomReal + k);
+                (ai - ti).store(bottomImaginary + k);
+            }
+        }
+    }
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <vector>
+
+// In-place radix-2 complex FFT working on separate real and imaginary arrays. The butterflies of all but the first two
+// stages are computed four at a time with float4.
+class FFT
+{
+  public:
+    // size must be a power of two, and at least 8
+    explicit FFT(unsigned int size);
+
+    void forward(float *real, float *imaginary) const;
+
+    unsigned int size() const
+    {
+        return n;
+    }
+
+  private:
+    unsigned int n;
+    std::vector<unsigned int> bitReversedIndices;
+    // Twiddle factors for the stage with butterfly span h start at index h - 1
+    std::vector<float> twiddleReal;
+    std::vector<float> twiddleImaginary;
+};
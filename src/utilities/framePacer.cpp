@@ -0,0 +1,122 @@
+#include "framePacer.h"
+#include <GLFW/glfw3.h>
+#include <algorithm>
+#include <iostream>
+#include <thread>
+
+// Bounds of the time spent spinning before a deadline. Recent oversleeping raises it, and it slowly decays back down.
+static const double minimumSpinMargin = 0.0002;
+static const double maximumSpinMargin = 0.004;
+static const double spinMarginDecay = 0.99;
+
+static double secondsBetween(std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to)
+{
+    return std::chrono::duration<double>(to - from).count();
+}
+
+bool parseVsyncMode(const std::string &name, VsyncMode &mode)
+{
+    if (name == "off")
+    {
+        mode = VsyncMode::Off;
+    }
+    else if (name == "on")
+    {
+        mode = VsyncMode::On;
+    }
+    else if (name == "adaptive")
+    {
+        mode = VsyncMode::Adaptive;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+const char *vsyncModeName(VsyncMode mode)
+{
+    switch (mode)
+    {
+    case VsyncMode::Off:
+        return "off";
+    case VsyncMode::On:
+        return "on";
+    case VsyncMode::Adaptive:
+        return "adaptive";
+    }
+    return "";
+}
+
+void FramePacer::init(VsyncMode vsyncMode, double frameRateLimit)
+{
+    mode = vsyncMode;
+    if (mode == VsyncMode::Adaptive && !glfwExtensionSupported("WGL_EXT_swap_control_tear") &&
+        !glfwExtensionSupported("GLX_EXT_swap_control_tear"))
+    {
+        std::cerr << "Adaptive vsync is not supported, using regular vsync" << std::endl;
+        mode = VsyncMode::On;
+    }
+    glfwSwapInterval(mode == VsyncMode::Off ? 0 : mode == VsyncMode::On ? 1 : -1);
+
+    limit = std::max(frameRateLimit, 0.0);
+    period = std::chrono::steady_clock::duration(0);
+    if (limit > 0)
+    {
+        period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(1.0 / limit));
+    }
+    deadline = std::chrono::steady_clock::now();
+    hasSwapped = false;
+    stats = Statistics();
+}
+
+void FramePacer::waitForNextFrame()
+{
+    if (period.count() == 0)
+    {
+        return;
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    deadline += period;
+    if (now > deadline)
+    {
+        // Too late to catch up without a burst of short frames, so the schedule starts over from here
+        stats.lateFrames++;
+        deadline = now;
+        return;
+    }
+
+    auto sleepUntil = deadline - std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                     std::chrono::duration<double>(spinMarginSeconds));
+    if (sleepUntil > now)
+    {
+        std::this_thread::sleep_until(sleepUntil);
+        auto woken = std::chrono::steady_clock::now();
+        stats.sleepSeconds += secondsBetween(now, woken);
+        double overslept = secondsBetween(sleepUntil, woken);
+        spinMarginSeconds = std::max(spinMarginSeconds * spinMarginDecay, overslept * 1.25);
+        spinMarginSeconds = std::min(std::max(spinMarginSeconds, minimumSpinMargin), maximumSpinMargin);
+        now = woken;
+    }
+
+    auto spinStart = now;
+    while (now < deadline)
+    {
+        now = std::chrono::steady_clock::now();
+    }
+    stats.spinSeconds += secondsBetween(spinStart, now);
+}
+
+void FramePacer::frameSwapped()
+{
+    auto now = std::chrono::steady_clock::now();
+    if (hasSwapped)
+    {
+        stats.frameTimes.record(secondsBetween(lastSwap, now));
+    }
+    lastSwap = now;
+    hasSwapped = true;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "latencyHistogram.h"
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+enum class VsyncMode
+{
+    Off,
+    On,
+    // Waits for vertical blank like On, but swaps right away when a frame is late, tearing instead of stuttering
+    Adaptive
+};
+
+// Accepts "off", "on" and "adaptive". Returns false for anything else.
+bool parseVsyncMode(const std::string &name, VsyncMode &mode);
+const char *vsyncModeName(VsyncMode mode);
+
+// Sets the swap interval and keeps frames from starting more often than a target rate. Waiting for the next frame
+// sleeps for as long as the system sleeps reliably and spins for the rest, so frames start on time without burning a
+// core the whole wait. The time it spins before a deadline follows how late the sleeps have woken up recently.
+class FramePacer
+{
+  public:
+    struct Statistics
+    {
+        // Time between swaps
+        LatencyHistogram frameTimes;
+        double sleepSeconds = 0;
+        double spinSeconds = 0;
+        // Frames that started after their deadline had passed, as the limiter saw them
+        std::uint64_t lateFrames = 0;
+    };
+
+    // Needs the OpenGL context of the window to be current. A frame rate limit of 0 only sets the swap interval.
+    void init(VsyncMode mode, double frameRateLimit);
+
+    // Waits until the next frame is due
+    void waitForNextFrame();
+    // Call right after the buffers were swapped
+    void frameSwapped();
+
+    // Adaptive falls back to On where the driver does not support it
+    VsyncMode vsyncMode() const
+    {
+        return mode;
+    }
+    double frameRateLimit() const
+    {
+        return limit;
+    }
+    const Statistics &statistics() const
+    {
+        return stats;
+    }
+
+  private:
+    VsyncMode mode = VsyncMode::On;
+    double limit = 0;
+    std::chrono::steady_clock::duration period{0};
+    std::chrono::steady_clock::time_point deadline;
+    std::chrono::steady_clock::time_point lastSwap;
+    bool hasSwapped = false;
+    double spinMarginSeconds = 0.001;
+
+    Statistics stats;
+};
@@ -3,39 +3,44 @@
 #include <program.hpp>
 #include <vector>
 
-template <class T> unsigned int generateAttribute(int id, int elementsPerEntry, std::vector<T> data, bool normalize)
+template <class T>
+GLBuffer generateAttribute(int id, int elementsPerEntry, std::vector<T> data, bool normalize, const std::string &tag,
+                           GpuResourceSite site)
 {
-    unsigned int bufferID;
-    glGenBuffers(1, &bufferID);
-    glBindBuffer(GL_ARRAY_BUFFER, bufferID);
+    GLBuffer buffer(tag, site);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer.id());
     glBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(T), data.data(), GL_STATIC_DRAW);
+    buffer.setBytes(data.size() * sizeof(T));
     glVertexAttribPointer(id, elementsPerEntry, GL_FLOAT, normalize ? GL_TRUE : GL_FALSE, sizeof(T), 0);
     glEnableVertexAttribArray(id);
-    return bufferID;
+    return buffer;
 }
 
-unsigned int generateBuffer(Mesh &mesh)
+MeshBuffers generateBuffer(Mesh &mesh, const std::string &tag, GpuResourceSite site)
 {
-    unsigned int vaoID;
-    glGenVertexArrays(1, &vaoID);
-    glBindVertexArray(vaoID);
+    MeshBuffers meshBuffers;
+    meshBuffers.vertexArray = GLVertexArray(tag, site);
+    glBindVertexArray(meshBuffers.vertexArray.id());
 
-    generateAttribute(0, 3, mesh.vertices, false);
+    meshBuffers.buffers.push_back(generateAttribute(0, 3, mesh.vertices, false, tag, site));
     if (mesh.normals.size() > 0)
     {
-        generateAttribute(1, 3, mesh.normals, true);
+        meshBuffers.buffers.push_back(generateAttribute(1, 3, mesh.normals, true, tag, site));
 
-        std::vector<glm::vec3> tangents;
-        std::vector<glm::vec3> bitangents;
-        for (int i = 0; i < mesh.vertices.size(); i += 3)
+        // Tangents are computed per indexed triangle, so meshes that share vertices between triangles work too. A
+        // shared vertex keeps the tangent of the last triangle using it.
+        std::vector<glm::vec3> tangents(mesh.vertices.size(), glm::vec3(0));
+        std::vector<glm::vec3> bitangents(mesh.vertices.size(), glm::vec3(0));
+        for (std::size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
         {
-            glm::vec3 &v0 = mesh.vertices[i];
-            glm::vec3 &v1 = mesh.vertices[i + 1];
-            glm::vec3 &v2 = mesh.vertices[i + 2];
+            const unsigned int *index = &mesh.indices[i];
+            glm::vec3 &v0 = mesh.vertices[index[0]];
+            glm::vec3 &v1 = mesh.vertices[index[1]];
+            glm::vec3 &v2 = mesh.vertices[index[2]];
 
-            glm::vec2 &uv0 = mesh.textureCoordinates[i];
-            glm::vec2 &uv1 = mesh.textureCoordinates[i + 1];
-            glm::vec2 &uv2 = mesh.textureCoordinates[i + 2];
+            glm::vec2 &uv0 = mesh.textureCoordinates[index[0]];
+            glm::vec2 &uv1 = mesh.textureCoordinates[index[1]];
+            glm::vec2 &uv2 = mesh.textureCoordinates[index[2]];
 
             glm::vec3 deltaPos1 = v1 - v0;
             glm::vec3 deltaPos2 = v2 - v0;
@@ -47,28 +52,42 @@ unsigned int generateBuffer(Mesh &mesh)
             glm::vec3 tangent = (deltaPos1 * deltaUV2.y - deltaPos2 * deltaUV1.y) * r;
             glm::vec3 bitangent = (deltaPos2 * deltaUV1.x - deltaPos1 * deltaUV2.x) * r;
 
-            tangents.push_back(tangent);
-            tangents.push_back(tangent);
-            tangents.push_back(tangent);
-
-            bitangents.push_back(bitangent);
-            bitangents.push_back(bitangent);
-            bitangents.push_back(bitangent);
+            for (int corner = 0; corner < 3; corner++)
+            {
+                tangents[index[corner]] = tangent;
+                bitangents[index[corner]] = bitangent;
+            }
         }
 
-        generateAttribute(3, 3, tangents, true);
-        generateAttribute(4, 3, bitangents, true);
+        meshBuffers.buffers.push_back(generateAttribute(3, 3, tangents, true, tag, site));
+        meshBuffers.buffers.push_back(generateAttribute(4, 3, bitangents, true, tag, site));
     }
     if (mesh.textureCoordinates.size() > 0)
     {
-        generateAttribute(2, 2, mesh.textureCoordinates, false);
+        meshBuffers.buffers.push_back(generateAttribute(2, 2, mesh.textureCoordinates, false, tag, site));
     }
 
-    unsigned int indexBufferID;
-    glGenBuffers(1, &indexBufferID);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBufferID);
+    GLBuffer indexBuffer(tag, site);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer.id());
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.indices.size() * sizeof(unsigned int), mesh.indices.data(),
                  GL_STATIC_DRAW);
+    indexBuffer.setBytes(mesh.indices.size() * sizeof(unsigned int));
+    meshBuffers.buffers.push_back(std::move(indexBuffer));
+    meshBuffers.indexCount = mesh.indices.size();
+
+    glBindVertexArray(0);
+    return meshBuffers;
+}
+
+GLTexture genTexture(const PNGImage &img, const std::string &tag, GpuResourceSite site)
+{
+    GLTexture texture(tag, site);
+    glBindTexture(GL_TEXTURE_2D, texture.id());
 
-    return vaoID;
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, img.width, img.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, img.pixels.data());
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glTexParameteri(GL_TEXTURE_2D, GL_NEAREST_MIPMAP_LINEAR, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    texture.setBytes(textureBytes(img.width, img.height, 4, true));
+    return texture;
 }
@@ -1,5 +1,20 @@
 #pragma once
 
+#include "gpuResource.h"
+#include "imageLoader.hpp"
 #include "mesh.h"
+#include <string>
+#include <vector>
 
-unsigned int generateBuffer(Mesh &mesh);
\ No newline at end of file
+// The GPU side of a mesh. The vertex array and every buffer it reads from are released together.
+struct MeshBuffers
+{
+    GLVertexArray vertexArray;
+    std::vector<GLBuffer> buffers;
+    unsigned int indexCount = 0;
+};
+
+MeshBuffers generateBuffer(Mesh &mesh, const std::string &tag, GpuResourceSite site);
+
+// RGBA texture with mipmaps
+GLTexture genTexture(const PNGImage &img, const std::string &tag, GpuResourceSite site);
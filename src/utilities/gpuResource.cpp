@@ -0,0 +1,222 @@
+#include "gpuResource.h"
+#include <algorithm>
+#include <fmt/format.h>
+#include <map>
+#include <vector>
+
+const char *gpuResourceTypeName(GpuResourceType type)
+{
+    switch (type)
+    {
+    case GpuResourceType::Buffer:
+        return "buffers";
+    case GpuResourceType::VertexArray:
+        return "vertex arrays";
+    case GpuResourceType::Texture:
+        return "textures";
+    case GpuResourceType::Program:
+        return "programs";
+    case GpuResourceType::Framebuffer:
+        return "framebuffers";
+    case GpuResourceType::Query:
+        return "queries";
+    }
+    return "unknown";
+}
+
+static std::string formatBytes(std::size_t bytes)
+{
+    if (bytes >= 1024 * 1024)
+    {
+        return fmt::format("{:.2f} MB", bytes / (1024.0 * 1024.0));
+    }
+    return fmt::format("{:.1f} kB", bytes / 1024.0);
+}
+
+GpuResourceRegistry &gpuResources()
+{
+    static GpuResourceRegistry registry;
+    return registry;
+}
+
+GLuint createGpuObject(GpuResourceType type)
+{
+    GLuint id = 0;
+    switch (type)
+    {
+    case GpuResourceType::Buffer:
+        glGenBuffers(1, &id);
+        break;
+    case GpuResourceType::VertexArray:
+        glGenVertexArrays(1, &id);
+        break;
+    case GpuResourceType::Texture:
+        glGenTextures(1, &id);
+        break;
+    case GpuResourceType::Program:
+        id = glCreateProgram();
+        break;
+    case GpuResourceType::Framebuffer:
+        glGenFramebuffers(1, &id);
+        break;
+    case GpuResourceType::Query:
+        glGenQueries(1, &id);
+        break;
+    }
+    return id;
+}
+
+void deleteGpuObject(GpuResourceType type, GLuint id)
+{
+    switch (type)
+    {
+    case GpuResourceType::Buffer:
+        glDeleteBuffers(1, &id);
+        break;
+    case GpuResourceType::VertexArray:
+        glDeleteVertexArrays(1, &id);
+        break;
+    case GpuResourceType::Texture:
+        glDeleteTextures(1, &id);
+        break;
+    case GpuResourceType::Program:
+        glDeleteProgram(id);
+        break;
+    case GpuResourceType::Framebuffer:
+        glDeleteFramebuffers(1, &id);
+        break;
+    case GpuResourceType::Query:
+        glDeleteQueries(1, &id);
+        break;
+    }
+}
+
+std::size_t textureBytes(int width, int height, int bytesPerPixel, bool hasMipmaps)
+{
+    std::size_t total = 0;
+    do
+    {
+        total += std::size_t(width) * height * bytesPerPixel;
+        width = std::max(width / 2, 1);
+        height = std::max(height / 2, 1);
+    } while (hasMipmaps && (width > 1 || height > 1));
+    if (hasMipmaps)
+    {
+        total += bytesPerPixel;
+    }
+    return total;
+}
+
+void GpuResourceRegistry::add(GpuResourceType type, GLuint id, std::string tag, GpuResourceSite site)
+{
+    if (id == 0)
+    {
+        return;
+    }
+    entries[key(type, id)] = Entry{type, std::move(tag), site, 0};
+    counts[unsigned(type)]++;
+}
+
+void GpuResourceRegistry::remove(GpuResourceType type, GLuint id)
+{
+    auto entry = entries.find(key(type, id));
+    if (entry == entries.end())
+    {
+        return;
+    }
+    counts[unsigned(type)]--;
+    bytes[unsigned(type)] -= entry->second.bytes;
+    entries.erase(entry);
+}
+
+void GpuResourceRegistry::setBytes(GpuResourceType type, GLuint id, std::size_t newBytes)
+{
+    auto entry = entries.find(key(type, id));
+    if (entry == entries.end())
+    {
+        return;
+    }
+    bytes[unsigned(type)] += newBytes - entry->second.bytes;
+    entry->second.bytes = newBytes;
+}
+
+void GpuResourceRegistry::setTag(GpuResourceType type, GLuint id, std::string tag)
+{
+    auto entry = entries.find(key(type, id));
+    if (entry != entries.end())
+    {
+        entry->second.tag = std::move(tag);
+    }
+}
+
+std::size_t GpuResourceRegistry::totalBytes() const
+{
+    std::size_t total = 0;
+    for (std::size_t categoryBytes : bytes)
+    {
+        total += categoryBytes;
+    }
+    return total;
+}
+
+void GpuResourceRegistry::printBreakdown(std::ostream &out) const
+{
+    out << "GPU memory: " << formatBytes(totalBytes()) << " in " << entries.size() << " objects" << std::endl;
+
+    for (unsigned int type = 0; type < gpuResourceTypeCount; type++)
+    {
+        if (counts[type] == 0)
+        {
+            continue;
+        }
+        out << fmt::format("  {:<14} {:>10} in {} objects", gpuResourceTypeName(GpuResourceType(type)),
+                           formatBytes(bytes[type]), counts[type])
+            << std::endl;
+
+        std::map<std::string, std::pair<std::size_t, std::size_t>> tags;
+        for (const auto &entry : entries)
+        {
+            if (unsigned(entry.second.type) == type)
+            {
+                tags[entry.second.tag].first += entry.second.bytes;
+                tags[entry.second.tag].second++;
+            }
+        }
+        std::vector<std::pair<std::string, std::pair<std::size_t, std::size_t>>> sorted(tags.begin(), tags.end());
+        std::sort(sorted.begin(), sorted.end(),
+                  [](const auto &a, const auto &b) { return a.second.first > b.second.first; });
+        for (const auto &tag : sorted)
+        {
+            out << fmt::format("    {:<26} {:>10} in {}", tag.first, formatBytes(tag.second.first), tag.second.second)
+                << std::endl;
+        }
+    }
+}
+
+std::size_t GpuResourceRegistry::reportLeaks(std::ostream &out) const
+{
+    if (entries.empty())
+    {
+        return 0;
+    }
+
+    // Sorted by creation site, so the report is stable between runs
+    std::vector<const Entry *> leaks;
+    for (const auto &entry : entries)
+    {
+        leaks.push_back(&entry.second);
+    }
+    std::sort(leaks.begin(), leaks.end(), [](const Entry *a, const Entry *b) {
+        int order = std::string(a->site.file).compare(b->site.file);
+        return order != 0 ? order < 0 : a->site.line < b->site.line;
+    });
+
+    out << leaks.size() << " GPU objects were not released:" << std::endl;
+    for (const Entry *leak : leaks)
+    {
+        out << fmt::format("  {} \"{}\" ({}) created at {}:{}", gpuResourceTypeName(leak->type), leak->tag,
+                           formatBytes(leak->bytes), leak->site.file, leak->site.line)
+            << std::endl;
+    }
+    return leaks.size();
+}
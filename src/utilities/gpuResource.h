@@ -0,0 +1,154 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <glad/glad.h>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+
+enum class GpuResourceType
+{
+    Buffer,
+    VertexArray,
+    Texture,
+    Program,
+    Framebuffer,
+    Query,
+};
+const unsigned int gpuResourceTypeCount = 6;
+
+const char *gpuResourceTypeName(GpuResourceType type);
+
+// Where a GPU object was created, for leak reports. Use GPU_HERE to fill it in.
+struct GpuResourceSite
+{
+    const char *file;
+    int line;
+};
+#define GPU_HERE (GpuResourceSite{__FILE__, __LINE__})
+
+// Book keeping of every live GPU object created through the handles below. All objects are created and destroyed on
+// the thread owning the OpenGL context, so there is no locking.
+class GpuResourceRegistry
+{
+  public:
+    struct Entry
+    {
+        GpuResourceType type;
+        std::string tag;
+        GpuResourceSite site;
+        std::size_t bytes;
+    };
+
+    void add(GpuResourceType type, GLuint id, std::string tag, GpuResourceSite site);
+    void remove(GpuResourceType type, GLuint id);
+    void setBytes(GpuResourceType type, GLuint id, std::size_t bytes);
+    void setTag(GpuResourceType type, GLuint id, std::string tag);
+
+    std::size_t liveCount(GpuResourceType type) const
+    {
+        return counts[unsigned(type)];
+    }
+    std::size_t liveBytes(GpuResourceType type) const
+    {
+        return bytes[unsigned(type)];
+    }
+    std::size_t totalBytes() const;
+
+    // Memory per category and tag, largest first
+    void printBreakdown(std::ostream &out) const;
+    // Prints every object that is still alive along with where it was created. Returns the number of leaks.
+    std::size_t reportLeaks(std::ostream &out) const;
+
+  private:
+    static std::uint64_t key(GpuResourceType type, GLuint id)
+    {
+        return (std::uint64_t(type) << 32) | id;
+    }
+
+    std::unordered_map<std::uint64_t, Entry> entries;
+    std::size_t counts[gpuResourceTypeCount] = {};
+    std::size_t bytes[gpuResourceTypeCount] = {};
+};
+
+GpuResourceRegistry &gpuResources();
+
+GLuint createGpuObject(GpuResourceType type);
+void deleteGpuObject(GpuResourceType type, GLuint id);
+
+// Move-only owner of one OpenGL object. The object is created and registered by the constructor, and deleted along
+// with the handle. A default constructed handle owns nothing.
+template <GpuResourceType Type> class GpuHandle
+{
+  public:
+    GpuHandle() = default;
+    GpuHandle(std::string tag, GpuResourceSite site) : mID(createGpuObject(Type))
+    {
+        gpuResources().add(Type, mID, std::move(tag), site);
+    }
+    ~GpuHandle()
+    {
+        reset();
+    }
+
+    GpuHandle(GpuHandle &&other) noexcept : mID(other.mID)
+    {
+        other.mID = 0;
+    }
+    GpuHandle &operator=(GpuHandle &&other) noexcept
+    {
+        if (this != &other)
+        {
+            reset();
+            mID = other.mID;
+            other.mID = 0;
+        }
+        return *this;
+    }
+
+    GLuint id() const
+    {
+        return mID;
+    }
+    explicit operator bool() const
+    {
+        return mID != 0;
+    }
+
+    // Records how much GPU memory the object uses, e.g. after uploading data to a buffer or texture
+    void setBytes(std::size_t bytes) const
+    {
+        gpuResources().setBytes(Type, mID, bytes);
+    }
+    void setTag(std::string tag) const
+    {
+        gpuResources().setTag(Type, mID, std::move(tag));
+    }
+
+    void reset()
+    {
+        if (mID != 0)
+        {
+            gpuResources().remove(Type, mID);
+            deleteGpuObject(Type, mID);
+            mID = 0;
+        }
+    }
+
+  private:
+    GpuHandle(GpuHandle const &) = delete;
+    GpuHandle &operator=(GpuHandle const &) = delete;
+
+    GLuint mID = 0;
+};
+
+using GLBuffer = GpuHandle<GpuResourceType::Buffer>;
+using GLVertexArray = GpuHandle<GpuResourceType::VertexArray>;
+using GLTexture = GpuHandle<GpuResourceType::Texture>;
+using GLProgram = GpuHandle<GpuResourceType::Program>;
+using GLFramebuffer = GpuHandle<GpuResourceType::Framebuffer>;
+using GLQuery = GpuHandle<GpuResourceType::Query>;
+
+// Size of a texture with a full mipmap chain, which adds about a third on top of the base level
+std::size_t textureBytes(int width, int height, int bytesPerPixel, bool hasMipmaps);
@@ -0,0 +1,119 @@
+#include "gpuRingBuffer.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+GpuRingBuffer::~GpuRingBuffer()
+{
+    if (!buffer)
+    {
+        return;
+    }
+    for (GLsync &fence : regionFences)
+    {
+        if (fence != nullptr)
+        {
+            glDeleteSync(fence);
+        }
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer.id());
+    glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+}
+
+void GpuRingBuffer::init(GLsizeiptr bytesPerFrame, unsigned int framesInFlight)
+{
+    GLint alignment = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    uniformAlignment = std::max<GLsizeiptr>(alignment, 1);
+
+    // Keep every region start aligned, so the alignment of an allocation does not depend on the region it is in
+    regionSize = (bytesPerFrame + uniformAlignment - 1) / uniformAlignment * uniformAlignment;
+    regionCount = std::min(std::max(framesInFlight, 1u), maxFramesInFlight);
+
+    // Bound to GL_COPY_WRITE_BUFFER only to create it; the buffer can be bound to any target afterwards
+    buffer = GLBuffer("per-frame uploads", GPU_HERE);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer.id());
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glBufferStorage(GL_COPY_WRITE_BUFFER, regionSize * regionCount, nullptr, flags);
+    buffer.setBytes(regionSize * regionCount);
+    mapped = static_cast<unsigned char *>(glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, regionSize * regionCount, flags));
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    if (mapped == nullptr)
+    {
+        std::cerr << "Could not map the per-frame upload buffer" << std::endl;
+    }
+}
+
+GpuRingBuffer::Allocation GpuRingBuffer::allocate(GLsizeiptr size, GLsizeiptr alignment)
+{
+    Allocation allocation;
+    if (mapped == nullptr || size <= 0)
+    {
+        return allocation;
+    }
+
+    GLintptr regionStart = currentRegion * regionSize;
+    GLintptr offset = regionStart + regionUsed;
+    offset = (offset + alignment - 1) / alignment * alignment;
+    if (offset + size > regionStart + regionSize)
+    {
+        stats.failedAllocations++;
+        return allocation;
+    }
+
+    regionUsed = offset + size - regionStart;
+    allocation.pointer = mapped + offset;
+    allocation.offset = offset;
+    allocation.size = size;
+    return allocation;
+}
+
+void GpuRingBuffer::bindRange(GLenum target, GLuint index, const Allocation &allocation) const
+{
+    glBindBufferRange(target, index, buffer.id(), allocation.offset, allocation.size);
+}
+
+void GpuRingBuffer::endFrame()
+{
+    if (mapped == nullptr)
+    {
+        return;
+    }
+
+    stats.frames++;
+    stats.bytesLastFrame = regionUsed;
+    stats.peakBytesPerFrame = std::max(stats.peakBytesPerFrame, regionUsed);
+
+    if (regionFences[currentRegion] != nullptr)
+    {
+        glDeleteSync(regionFences[currentRegion]);
+    }
+    regionFences[currentRegion] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    currentRegion = (currentRegion + 1) % regionCount;
+    regionUsed = 0;
+
+    GLsync &fence = regionFences[currentRegion];
+    if (fence == nullptr)
+    {
+        return;
+    }
+
+    // Usually the GPU finished with the region long ago, and the first check succeeds without blocking
+    GLenum status = glClientWaitSync(fence, 0, 0);
+    if (status == GL_TIMEOUT_EXPIRED)
+    {
+        auto waitStart = std::chrono::steady_clock::now();
+        while (status == GL_TIMEOUT_EXPIRED)
+        {
+            status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+        }
+        double waited = std::chrono::duration<double>(std::chrono::steady_clock::now() - waitStart).count();
+        stats.stalls++;
+        stats.totalStallSeconds += waited;
+        stats.longestStallSeconds = std::max(stats.longestStallSeconds, waited);
+    }
+    glDeleteSync(fence);
+    fence = nullptr;
+}
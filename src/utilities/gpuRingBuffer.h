@@ -0,0 +1,87 @@
+#pragma once
+
+#include "gpuResource.h"
+#include <cstddef>
+#include <cstdint>
+#include <glad/glad.h>
+
+// Allocator for data that is uploaded again every frame (streamed vertices, instance data, uniform blocks). A single
+// buffer is persistently mapped and split into one region per frame in flight. Allocations are carved linearly out of
+// the current region and written with plain memcpys, and a fence per region makes sure the CPU never overwrites data
+// the GPU has not consumed yet. The driver never has to synchronize on buffer updates.
+class GpuRingBuffer
+{
+  public:
+    struct Allocation
+    {
+        // Where to write the data. Only valid until the end of the frame.
+        void *pointer = nullptr;
+        // Offset from the start of the buffer, for binding the range or as a base vertex / instance
+        GLintptr offset = 0;
+        GLsizeiptr size = 0;
+
+        explicit operator bool() const
+        {
+            return pointer != nullptr;
+        }
+    };
+
+    struct Statistics
+    {
+        std::uint64_t frames = 0;
+        // Frames where the next region was still in use by the GPU, and the CPU had to wait for it
+        std::uint64_t stalls = 0;
+        double totalStallSeconds = 0;
+        double longestStallSeconds = 0;
+        // Allocations that did not fit in the remaining space of their region
+        std::uint64_t failedAllocations = 0;
+        GLsizeiptr bytesLastFrame = 0;
+        GLsizeiptr peakBytesPerFrame = 0;
+    };
+
+    GpuRingBuffer() = default;
+    ~GpuRingBuffer();
+
+    void init(GLsizeiptr bytesPerFrame, unsigned int framesInFlight = 3);
+
+    // Returns an empty allocation when the current region is full. alignment does not need to be a power of two, so
+    // the size of a vertex can be used to get an offset that is usable as a base vertex.
+    Allocation allocate(GLsizeiptr size, GLsizeiptr alignment = 16);
+    Allocation allocateUniforms(GLsizeiptr size)
+    {
+        return allocate(size, uniformAlignment);
+    }
+
+    // Binds an allocation to an indexed target, e.g. GL_UNIFORM_BUFFER or GL_SHADER_STORAGE_BUFFER
+    void bindRange(GLenum target, GLuint index, const Allocation &allocation) const;
+
+    // Call once all draw calls reading from this frame's allocations have been issued
+    void endFrame();
+
+    GLuint bufferID() const
+    {
+        return buffer.id();
+    }
+    const Statistics &statistics() const
+    {
+        return stats;
+    }
+
+  private:
+    GpuRingBuffer(GpuRingBuffer const &) = delete;
+    GpuRingBuffer &operator=(GpuRingBuffer const &) = delete;
+
+    static const unsigned int maxFramesInFlight = 4;
+
+    GLBuffer buffer;
+    unsigned char *mapped = nullptr;
+    GLsizeiptr regionSize = 0;
+    unsigned int regionCount = 0;
+    GLsizeiptr uniformAlignment = 256;
+
+    unsigned int currentRegion = 0;
+    GLsizeiptr regionUsed = 0;
+    GLsync regionFences[maxFramesInFlight] = {};
+
+    Statistics stats;
+};
@@ -0,0 +1,58 @@
+#include "gpuTimer.h"
+
+void GpuTimer::init()
+{
+    for (GLQuery &query : queries)
+    {
+        query = GLQuery("GPU timer", GPU_HERE);
+    }
+    firstPending = 0;
+    pendingCount = 0;
+    measuring = false;
+}
+
+void GpuTimer::begin(int tag)
+{
+    if (pendingCount == queryCount)
+    {
+        return;
+    }
+    int next = (firstPending + pendingCount) % queryCount;
+    tags[next] = tag;
+    glBeginQuery(GL_TIME_ELAPSED, queries[next].id());
+    measuring = true;
+}
+
+void GpuTimer::end()
+{
+    if (!measuring)
+    {
+        return;
+    }
+    glEndQuery(GL_TIME_ELAPSED);
+    pendingCount++;
+    measuring = false;
+}
+
+bool GpuTimer::poll(double &seconds, int &tag)
+{
+    if (pendingCount == 0)
+    {
+        return false;
+    }
+    GLuint query = queries[firstPending].id();
+    GLint available = 0;
+    glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available)
+    {
+        return false;
+    }
+    GLuint64 nanoseconds = 0;
+    glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+    seconds = nanoseconds / 1e9;
+    tag = tags[firstPending];
+
+    firstPending = (firstPending + 1) % queryCount;
+    pendingCount--;
+    return true;
+}
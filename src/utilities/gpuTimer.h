@@ -0,0 +1,32 @@
+#pragma once
+
+#include "gpuResource.h"
+#include <glad/glad.h>
+
+// Measures how long the GPU takes for the commands between begin() and end(), without ever waiting for it. Results
+// become available a few frames later, once the GPU has caught up. While every query is still waiting for its result,
+// begin() and end() skip the frame instead of stalling. Only one timer can measure at a time.
+class GpuTimer
+{
+  public:
+    // Needs an OpenGL context
+    void init();
+
+    // The tag comes back with the result, to tell apart what was measured while the result was on its way
+    void begin(int tag = 0);
+    void end();
+
+    // Takes the oldest result that has arrived, along with the tag it was measured with. Returns false if there is
+    // none, so calling it until then takes all of them in order.
+    bool poll(double &seconds, int &tag);
+
+  private:
+    static const int queryCount = 4;
+
+    GLQuery queries[queryCount];
+    int tags[queryCount] = {};
+    // Queries waiting for a result, oldest first starting at firstPending
+    int firstPending = 0;
+    int pendingCount = 0;
+    bool measuring = false;
+};
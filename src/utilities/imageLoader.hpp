@@ -1,14 +1,16 @@
-#pragma once
-
-#include "lodepng.h"
-#include <string>
-#include <vector>
-
-typedef struct PNGImage
-{
-    unsigned int width;
-    unsigned int height;
-    std::vector<unsigned char> pixels;
-} PNGImage;
-
-PNGImage loadPNGFile(std::string fileName);
+#pragma once
+
+#include "lodepng.h"
+#include <string>
+#include <vector>
+
+typedef struct PNGImage
+{
+    unsigned int width;
+    unsigned int height;
+    std::vector<unsigned char> pixels;
+} PNGImage;
+
+PNGImage loadPNGFile(std::string fileName);
+// Expects the bottom row first, like loadPNGFile() gives
+bool savePNGFile(const std::string &fileName, const PNGImage &image);
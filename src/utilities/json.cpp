@@ -0,0 +1,304 @@
+#include "json.h"
+#include <cstdlib>
+#include <cstring>
+
+static const JsonValue nullValue;
+
+// Deeper documents are rejected instead of overflowing the stack. glTF files nest a handful of levels deep.
+static const int maxDepth = 64;
+
+const JsonValue &JsonValue::operator[](std::size_t index) const
+{
+    return valueType == Array && index < elements.size() ? elements[index] : nullValue;
+}
+
+const JsonValue &JsonValue::operator[](const char *key) const
+{
+    if (valueType == Object)
+    {
+        for (std::size_t i = 0; i < keys.size(); i++)
+        {
+            if (keys[i] == key)
+            {
+                return elements[i];
+            }
+        }
+    }
+    return nullValue;
+}
+
+class JsonParser
+{
+  public:
+    explicit JsonParser(const char *text) : position(text)
+    {
+    }
+
+    bool parseDocument(JsonValue &value)
+    {
+        if (!parseValue(value, 0))
+        {
+            return false;
+        }
+        skipWhitespace();
+        return *position == '\0' || fail("Unexpected data after the document");
+    }
+
+    std::string error;
+
+  private:
+    const char *position;
+
+    bool fail(const char *message)
+    {
+        if (error.empty())
+        {
+            error = message;
+        }
+        return false;
+    }
+
+    void skipWhitespace()
+    {
+        while (*position == ' ' || *position == '\t' || *position == '\n' || *position == '\r')
+        {
+            position++;
+        }
+    }
+
+    bool consume(const char *literal)
+    {
+        std::size_t length = std::strlen(literal);
+        if (std::strncmp(position, literal, length) != 0)
+        {
+            return false;
+        }
+        position += length;
+        return true;
+    }
+
+    static void appendUtf8(std::string &text, unsigned int codePoint)
+    {
+        if (codePoint < 0x80)
+        {
+            text.push_back(char(codePoint));
+        }
+        else if (codePoint < 0x800)
+        {
+            text.push_back(char(0xC0 | (codePoint >> 6)));
+            text.push_back(char(0x80 | (codePoint & 0x3F)));
+        }
+        else if (codePoint < 0x10000)
+        {
+            text.push_back(char(0xE0 | (codePoint >> 12)));
+            text.push_back(char(0x80 | ((codePoint >> 6) & 0x3F)));
+            text.push_back(char(0x80 | (codePoint & 0x3F)));
+        }
+        else
+        {
+            text.push_back(char(0xF0 | (codePoint >> 18)));
+            text.push_back(char(0x80 | ((codePoint >> 12) & 0x3F)));
+            text.push_back(char(0x80 | ((codePoint >> 6) & 0x3F)));
+            text.push_back(char(0x80 | (codePoint & 0x3F)));
+        }
+    }
+
+    bool parseHex4(unsigned int &value)
+    {
+        value = 0;
+        for (int i = 0; i < 4; i++)
+        {
+            char digit = *position++;
+            value <<= 4;
+            if (digit >= '0' && digit <= '9')
+                value |= unsigned(digit - '0');
+            else if (digit >= 'a' && digit <= 'f')
+                value |= unsigned(digit - 'a' + 10);
+            else if (digit >= 'A' && digit <= 'F')
+                value |= unsigned(digit - 'A' + 10);
+            else
+                return fail("Invalid unicode escape");
+        }
+        return true;
+    }
+
+    bool parseString(std::string &text)
+    {
+        // The opening quote has been checked by the caller
+        position++;
+        while (*position != '"')
+        {
+            char character = *position++;
+            if (character == '\0')
+            {
+                return fail("Unterminated string");
+            }
+            if (character != '\\')
+            {
+                text.push_back(character);
+                continue;
+            }
+            char escape = *position++;
+            switch (escape)
+            {
+            case '"':
+            case '\\':
+            case '/':
+                text.push_back(escape);
+                break;
+            case 'b':
+                text.push_back('\b');
+                break;
+            case 'f':
+                text.push_back('\f');
+                break;
+            case 'n':
+                text.push_back('\n');
+                break;
+            case 'r':
+                text.push_back('\r');
+                break;
+            case 't':
+                text.push_back('\t');
+                break;
+            case 'u': {
+                unsigned int codePoint;
+                if (!parseHex4(codePoint))
+                {
+                    return false;
+                }
+                // Characters outside the basic plane are written as two surrogates
+                if (codePoint >= 0xD800 && codePoint < 0xDC00 && consume("\\u"))
+                {
+                    unsigned int low;
+                    if (!parseHex4(low))
+                    {
+                        return false;
+                    }
+                    codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+                }
+                appendUtf8(text, codePoint);
+                break;
+            }
+            default:
+                return fail("Invalid escape in string");
+            }
+        }
+        position++;
+        return true;
+    }
+
+    bool parseValue(JsonValue &value, int depth)
+    {
+        if (depth > maxDepth)
+        {
+            return fail("Document is nested too deeply");
+        }
+        skipWhitespace();
+        switch (*position)
+        {
+        case '{':
+            position++;
+            value.valueType = JsonValue::Object;
+            skipWhitespace();
+            if (*position == '}')
+            {
+                position++;
+                return true;
+            }
+            while (true)
+            {
+                skipWhitespace();
+                if (*position != '"')
+                {
+                    return fail("Expected a member name");
+                }
+                value.keys.emplace_back();
+                if (!parseString(value.keys.back()))
+                {
+                    return false;
+                }
+                skipWhitespace();
+                if (*position++ != ':')
+                {
+                    return fail("Expected ':' after a member name");
+                }
+                value.elements.emplace_back();
+                if (!parseValue(value.elements.back(), depth + 1))
+                {
+                    return false;
+                }
+                skipWhitespace();
+                if (*position == '}')
+                {
+                    position++;
+                    return true;
+                }
+                if (*position++ != ',')
+                {
+                    return fail("Expected ',' or '}' in an object");
+                }
+            }
+        case '[':
+            position++;
+            value.valueType = JsonValue::Array;
+            skipWhitespace();
+            if (*position == ']')
+            {
+                position++;
+                return true;
+            }
+            while (true)
+            {
+                value.elements.emplace_back();
+                if (!parseValue(value.elements.back(), depth + 1))
+                {
+                    return false;
+                }
+                skipWhitespace();
+                if (*position == ']')
+                {
+                    position++;
+                    return true;
+                }
+                if (*position++ != ',')
+                {
+                    return fail("Expected ',' or ']' in an array");
+                }
+            }
+        case '"':
+            value.valueType = JsonValue::String;
+            return parseString(value.stringValue);
+        case 't':
+        case 'f':
+            value.valueType = JsonValue::Bool;
+            value.boolValue = *position == 't';
+            return consume(value.boolValue ? "true" : "false") || fail("Invalid literal");
+        case 'n':
+            return consume("null") || fail("Invalid literal");
+        default: {
+            char *numberEnd;
+            value.valueType = JsonValue::Number;
+            value.numberValue = std::strtod(position, &numberEnd);
+            if (numberEnd == position)
+            {
+                return fail("Unexpected character");
+            }
+            position = numberEnd;
+            return true;
+        }
+        }
+    }
+};
+
+bool JsonValue::parse(const std::string &text, JsonValue &value, std::string &error)
+{
+    value = JsonValue();
+    JsonParser parser(text.c_str());
+    if (!parser.parseDocument(value))
+    {
+        error = parser.error;
+        return false;
+    }
+    return true;
+}
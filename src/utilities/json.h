@@ -0,0 +1,72 @@
+#pragma once
+
+#include <climits>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Small JSON reader, enough for glTF files. Numbers are stored as doubles, and object members keep their file order.
+// Looking up a missing member or element gives a null value instead of failing, so optional fields read naturally.
+class JsonValue
+{
+  public:
+    enum Type
+    {
+        Null,
+        Bool,
+        Number,
+        String,
+        Array,
+        Object
+    };
+
+    // Parses a whole document. On failure error describes the problem.
+    static bool parse(const std::string &text, JsonValue &value, std::string &error);
+
+    Type type() const
+    {
+        return valueType;
+    }
+    bool isNull() const
+    {
+        return valueType == Null;
+    }
+
+    double number(double fallback = 0) const
+    {
+        return valueType == Number ? numberValue : fallback;
+    }
+    // Numbers outside the range of int give the fallback too, since converting them would be undefined
+    int integer(int fallback = -1) const
+    {
+        bool inRange = numberValue >= double(INT_MIN) && numberValue <= double(INT_MAX);
+        return valueType == Number && inRange ? int(numberValue) : fallback;
+    }
+    bool boolean(bool fallback = false) const
+    {
+        return valueType == Bool ? boolValue : fallback;
+    }
+    const std::string &string() const
+    {
+        return stringValue;
+    }
+
+    // Number of array elements or object members
+    std::size_t size() const
+    {
+        return elements.size();
+    }
+    const JsonValue &operator[](std::size_t index) const;
+    const JsonValue &operator[](const char *key) const;
+
+  private:
+    friend class JsonParser;
+
+    Type valueType = Null;
+    bool boolValue = false;
+    double numberValue = 0;
+    std::string stringValue;
+    std::vector<JsonValue> elements;
+    // Only for objects, one per element
+    std::vector<std::string> keys;
+};
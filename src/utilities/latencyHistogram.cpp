@@ -0,0 +1,46 @@
+#include "latencyHistogram.h"
+#include <algorithm>
+#include <cmath>
+
+void LatencyHistogram::record(double seconds)
+{
+    double microseconds = seconds * 1e6;
+    int bucket = 0;
+    if (microseconds > 1.0)
+    {
+        bucket = std::min(int(std::log2(microseconds) * bucketsPerOctave), bucketCount - 1);
+    }
+    buckets[bucket]++;
+    sampleCount++;
+    largest = std::max(largest, seconds);
+}
+
+void LatencyHistogram::clear()
+{
+    std::fill(buckets, buckets + bucketCount, 0);
+    sampleCount = 0;
+    largest = 0;
+}
+
+double LatencyHistogram::percentile(double fraction) const
+{
+    if (sampleCount == 0)
+    {
+        return 0;
+    }
+
+    // Rank of the sample the fraction asks for, counting from 1
+    std::uint64_t rank = std::max<std::uint64_t>(std::uint64_t(std::ceil(fraction * sampleCount)), 1);
+    std::uint64_t seen = 0;
+    for (int bucket = 0; bucket < bucketCount; bucket++)
+    {
+        seen += buckets[bucket];
+        if (seen >= rank)
+        {
+            double bucketEnd = std::exp2(double(bucket + 1) / bucketsPerOctave) / 1e6;
+            // Nothing recorded goes past the largest sample
+            return std::min(bucketEnd, largest);
+        }
+    }
+    return largest;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Distribution of durations from a microsecond to about a minute, for percentiles without keeping every sample.
+// Buckets grow by an eighth of a power of two each, so a percentile is accurate to within 9%.
+class LatencyHistogram
+{
+  public:
+    void record(double seconds);
+    void clear();
+
+    // The duration the given fraction of the samples is at or below, rounded up to the end of its bucket. 0 without
+    // any samples.
+    double percentile(double fraction) const;
+
+    std::uint64_t count() const
+    {
+        return sampleCount;
+    }
+    double maximum() const
+    {
+        return largest;
+    }
+
+  private:
+    static const int bucketsPerOctave = 8;
+    static const int bucketCount = 26 * bucketsPerOctave;
+
+    std::uint64_t buckets[bucketCount] = {};
+    std::uint64_t sampleCount = 0;
+    double largest = 0;
+};
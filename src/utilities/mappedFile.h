@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// Read-only memory mapping of a whole file. The mapping is released when the object is destroyed.
+class MappedFile
+{
+  public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(MappedFile &&other) noexcept;
+    MappedFile &operator=(MappedFile &&other) noexcept;
+
+    bool open(const std::string &fileName);
+    void close();
+
+    const unsigned char *data() const
+    {
+        return mData;
+    }
+    std::size_t size() const
+    {
+        return mSize;
+    }
+    bool isOpen() const
+    {
+        return mData != nullptr;
+    }
+
+  private:
+    MappedFile(MappedFile const &) = delete;
+    MappedFile &operator=(MappedFile const &) = delete;
+
+    const unsigned char *mData = nullptr;
+    std::size_t mSize = 0;
+#ifdef _WIN32
+    void *mFileHandle = nullptr;
+    void *mMappingHandle = nullptr;
+#endif
+};
@@ -10,4 +10,16 @@ struct Mesh
     std::vector<glm::vec2> textureCoordinates;
 
     std::vector<unsigned int> indices;
-};
\ No newline at end of file
+};
+
+// Axis aligned bounds of the vertices, both zero for an empty mesh
+inline void meshBounds(const Mesh &mesh, glm::vec3 &boundsMin, glm::vec3 &boundsMax)
+{
+    boundsMin = mesh.vertices.empty() ? glm::vec3(0) : mesh.vertices[0];
+    boundsMax = boundsMin;
+    for (const glm::vec3 &vertex : mesh.vertices)
+    {
+        boundsMin = glm::min(boundsMin, vertex);
+        boundsMax = glm::max(boundsMax, vertex);
+    }
+}
@@ -0,0 +1,93 @@
+#include "meshRegistry.h"
+#include <cstring>
+#include <fmt/format.h>
+
+MeshRegistry &meshRegistry()
+{
+    static MeshRegistry registry;
+    return registry;
+}
+
+// Eight bytes at a time, with a multiply and shift per word to spread every input bit over the whole hash
+static std::uint64_t hashBytes(const void *data, std::size_t size, std::uint64_t hash)
+{
+    const unsigned char *bytes = static_cast<const unsigned char *>(data);
+    const std::uint64_t multiplier = 0x9E3779B97F4A7C15ull;
+    for (; size >= 8; size -= 8, bytes += 8)
+    {
+        std::uint64_t word;
+        std::memcpy(&word, bytes, 8);
+        hash = (hash ^ word) * multiplier;
+        hash ^= hash >> 32;
+    }
+    if (size > 0)
+    {
+        std::uint64_t word = 0;
+        std::memcpy(&word, bytes, size);
+        hash = (hash ^ word) * multiplier;
+        hash ^= hash >> 32;
+    }
+    return hash;
+}
+
+template <class T> static std::uint64_t hashVector(const std::vector<T> &data, std::uint64_t hash)
+{
+    // The length is part of the hash, so moving elements from one vector to the next changes it
+    std::uint64_t length = data.size();
+    hash = hashBytes(&length, sizeof(length), hash);
+    return hashBytes(data.data(), data.size() * sizeof(T), hash);
+}
+
+std::uint64_t meshContentHash(const Mesh &mesh)
+{
+    std::uint64_t hash = 0xCBF29CE484222325ull;
+    hash = hashVector(mesh.vertices, hash);
+    hash = hashVector(mesh.normals, hash);
+    hash = hashVector(mesh.textureCoordinates, hash);
+    return hashVector(mesh.indices, hash);
+}
+
+// What generateBuffer() allocates for the mesh, including the tangents and bitangents it adds to meshes with normals
+static std::size_t meshBufferBytes(const Mesh &mesh)
+{
+    return mesh.vertices.size() * sizeof(glm::vec3) + mesh.normals.size() * 3 * sizeof(glm::vec3) +
+           mesh.textureCoordinates.size() * sizeof(glm::vec2) + mesh.indices.size() * sizeof(unsigned int);
+}
+
+SharedMeshBuffers MeshRegistry::acquire(Mesh &mesh, const std::string &tag, GpuResourceSite site)
+{
+    // With the sizes in the key, only meshes of the same size could collide
+    std::string key = fmt::format("mesh {:016x} {} {}", meshContentHash(mesh), mesh.vertices.size(),
+                                  mesh.indices.size());
+    return acquire(key, mesh, tag, site);
+}
+
+SharedMeshBuffers MeshRegistry::acquire(const std::string &key, Mesh &mesh, const std::string &tag,
+                                        GpuResourceSite site)
+{
+    auto found = entries.find(key);
+    if (found != entries.end())
+    {
+        stats.hits++;
+        stats.bytesSaved += found->second.bytes;
+        return found->second.buffers.lock();
+    }
+
+    stats.misses++;
+    // The entry goes away with the last owner, so the registry never keeps buffers alive by itself
+    SharedMeshBuffers buffers(new MeshBuffers(generateBuffer(mesh, tag, site)), [this, key](const MeshBuffers *dead) {
+        entries.erase(key);
+        delete dead;
+    });
+    entries[key] = Entry{buffers, meshBufferBytes(mesh)};
+    return buffers;
+}
+
+void MeshRegistry::printStatistics(std::ostream &out) const
+{
+    std::size_t lookups = stats.hits + stats.misses;
+    out << fmt::format("Meshes: {} uploaded, {} of {} lookups shared ({:.0f}%), {:.1f} kB saved", entries.size(),
+                       stats.hits, lookups, lookups > 0 ? 100.0 * stats.hits / lookups : 0.0,
+                       stats.bytesSaved / 1024.0)
+        << std::endl;
+}
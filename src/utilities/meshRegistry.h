@@ -0,0 +1,59 @@
+#pragma once
+
+#include "glutils.h"
+#include "gpuResource.h"
+#include "mesh.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+
+// GPU copy of a mesh that may be shared between several owners. The buffers are released with the last copy.
+using SharedMeshBuffers = std::shared_ptr<const MeshBuffers>;
+
+// Uploads every distinct mesh once. Meshes are identified by a hash of their contents, or by a key naming how they
+// were generated, such as cubeKey(), so a hit does not have to hash the mesh. Like the GPU resource registry, this is
+// only used from the thread owning the OpenGL context.
+class MeshRegistry
+{
+  public:
+    struct Statistics
+    {
+        std::size_t hits = 0;
+        std::size_t misses = 0;
+        // GPU memory that would have been allocated again for the hits
+        std::size_t bytesSaved = 0;
+    };
+
+    // The buffers of an identical mesh that is already uploaded, or newly generated ones
+    SharedMeshBuffers acquire(Mesh &mesh, const std::string &tag, GpuResourceSite site);
+    // Same, but identified by key instead of the contents. Different meshes must not use the same key.
+    SharedMeshBuffers acquire(const std::string &key, Mesh &mesh, const std::string &tag, GpuResourceSite site);
+
+    std::size_t liveCount() const
+    {
+        return entries.size();
+    }
+    const Statistics &statistics() const
+    {
+        return stats;
+    }
+    void printStatistics(std::ostream &out) const;
+
+  private:
+    struct Entry
+    {
+        std::weak_ptr<const MeshBuffers> buffers;
+        std::size_t bytes;
+    };
+
+    std::unordered_map<std::string, Entry> entries;
+    Statistics stats;
+};
+
+MeshRegistry &meshRegistry();
+
+// 64 bit hash of the vertex attributes and indices
+std::uint64_t meshContentHash(const Mesh &mesh);
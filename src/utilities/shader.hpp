@@ -5,6 +5,9 @@
 // System headers
 #include <glad/glad.h>
 
+// Local headers
+#include "gpuResource.h"
+
 // Standard headers
 #include <cassert>
 #include <fstream>
@@ -17,20 +20,20 @@ class Shader
 {
   private:
     // Private member variables
-    GLuint mProgram;
+    GLProgram mProgram;
     GLint mStatus;
     GLint mLength;
 
   public:
-    Shader()
+    // Pass GPU_HERE, so the program is attributed to the line that creates it
+    explicit Shader(GpuResourceSite site) : mProgram("shader program", site)
     {
-        mProgram = glCreateProgram();
     }
 
     // Public member functions
     void activate()
     {
-        glUseProgram(mProgram);
+        glUseProgram(mProgram.id());
     }
     void deactivate()
     {
@@ -38,11 +41,11 @@ class Shader
     }
     GLuint get()
     {
-        return mProgram;
+        return mProgram.id();
     }
     void destroy()
     {
-        glDeleteProgram(mProgram);
+        mProgram.reset();
     }
 
     /* Attach a shader to the current shader program */
@@ -79,7 +82,7 @@ class Shader
         assert(mStatus);
 
         // Attach shader and free allocated memory
-        glAttachShader(mProgram, shader);
+        glAttachShader(mProgram.id(), shader);
         glDeleteShader(shader);
     }
 
@@ -87,25 +90,31 @@ class Shader
     void link()
     {
         // Link all attached shaders
-        glLinkProgram(mProgram);
+        glLinkProgram(mProgram.id());
 
         // Display errors
-        glGetProgramiv(mProgram, GL_LINK_STATUS, &mStatus);
+        glGetProgramiv(mProgram.id(), GL_LINK_STATUS, &mStatus);
         if (!mStatus)
         {
-            glGetProgramiv(mProgram, GL_INFO_LOG_LENGTH, &mLength);
+            glGetProgramiv(mProgram.id(), GL_INFO_LOG_LENGTH, &mLength);
             std::unique_ptr<char[]> buffer(new char[mLength]);
-            glGetProgramInfoLog(mProgram, mLength, nullptr, buffer.get());
+            glGetProgramInfoLog(mProgram.id(), mLength, nullptr, buffer.get());
             fprintf(stderr, "%s\n", buffer.get());
         }
 
         assert(mStatus);
+
+        // The size of the program binary is the closest thing to the memory used by the program
+        GLint binaryLength = 0;
+        glGetProgramiv(mProgram.id(), GL_PROGRAM_BINARY_LENGTH, &binaryLength);
+        mProgram.setBytes(binaryLength);
     }
 
     /* Convenience function that attaches and links a vertex and a
        fragment shader in a shader program */
     void makeBasicShader(std::string const &vertexFilename, std::string const &fragmentFilename)
     {
+        mProgram.setTag(vertexFilename.substr(vertexFilename.find_last_of("/\\") + 1));
         attach(vertexFilename);
         attach(fragmentFilename);
         link();
@@ -122,15 +131,15 @@ class Shader
     bool isValid()
     {
         // Validate linked shader program
-        glValidateProgram(mProgram);
+        glValidateProgram(mProgram.id());
 
         // Display errors
-        glGetProgramiv(mProgram, GL_VALIDATE_STATUS, &mStatus);
+        glGetProgramiv(mProgram.id(), GL_VALIDATE_STATUS, &mStatus);
         if (!mStatus)
         {
-            glGetProgramiv(mProgram, GL_INFO_LOG_LENGTH, &mLength);
+            glGetProgramiv(mProgram.id(), GL_INFO_LOG_LENGTH, &mLength);
             std::unique_ptr<char[]> buffer(new char[mLength]);
-            glGetProgramInfoLog(mProgram, mLength, nullptr, buffer.get());
+            glGetProgramInfoLog(mProgram.id(), mLength, nullptr, buffer.get());
             fprintf(stderr, "%s\n", buffer.get());
             return false;
         }
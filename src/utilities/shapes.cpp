@@ -1,4 +1,5 @@
 #include "shapes.h"
+#include <fmt/format.h>
 #include <iostream>
 
 #ifndef M_PI
@@ -202,3 +203,15 @@ Mesh generateSphere(float sphereRadius, int slices, int layers)
     mesh.textureCoordinates = uvs;
     return mesh;
 }
+
+std::string cubeKey(glm::vec3 scale, glm::vec2 textureScale, bool tilingTextures, bool inverted,
+                    glm::vec3 textureScale3d)
+{
+    return fmt::format("cube {} {} {} {} {} {} {} {} {} {}", scale.x, scale.y, scale.z, textureScale.x,
+                       textureScale.y, tilingTextures, inverted, textureScale3d.x, textureScale3d.y, textureScale3d.z);
+}
+
+std::string sphereKey(float radius, int slices, int layers)
+{
+    return fmt::format("sphere {} {} {}", radius, slices, layers);
+}
@@ -1,7 +1,13 @@
 #pragma once
 #include "mesh.h"
+#include <string>
 
 Mesh cube(glm::vec3 scale = glm::vec3(1), glm::vec2 textureScale = glm::vec2(1), bool tilingTextures = false,
           bool inverted = false, glm::vec3 textureScale3d = glm::vec3(1));
 Mesh generateBox(float width, float height, float depth, bool flipFaces = false);
-Mesh generateSphere(float radius, int slices, int layers);
\ No newline at end of file
+Mesh generateSphere(float radius, int slices, int layers);
+
+// Mesh registry keys that are the same for the same generator arguments
+std::string cubeKey(glm::vec3 scale = glm::vec3(1), glm::vec2 textureScale = glm::vec2(1), bool tilingTextures = false,
+                    bool inverted = false, glm::vec3 textureScale3d = glm::vec3(1));
+std::string sphereKey(float radius, int slices, int layers);
@@ -0,0 +1,239 @@
+#pragma once
+
+// Minimal 4-wide float vector. Uses SSE2 when the compiler targets it, and falls back to plain scalar code otherwise,
+// so code written against float4 compiles everywhere.
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GLOWBOX_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#include <cmath>
+#include <cstring>
+
+#ifdef GLOWBOX_SSE2
+struct float4
+{
+    __m128 v;
+
+    float4() = default;
+    float4(__m128 v) : v(v)
+    {
+    }
+    explicit float4(float x) : v(_mm_set1_ps(x))
+    {
+    }
+    float4(float x, float y, float z, float w) : v(_mm_setr_ps(x, y, z, w))
+    {
+    }
+
+    static float4 load(const float *p)
+    {
+        return _mm_loadu_ps(p);
+    }
+    void store(float *p) const
+    {
+        _mm_storeu_ps(p, v);
+    }
+};
+
+inline float4 operator+(float4 a, float4 b)
+{
+    return _mm_add_ps(a.v, b.v);
+}
+inline float4 operator-(float4 a, float4 b)
+{
+    return _mm_sub_ps(a.v, b.v);
+}
+inline float4 operator*(float4 a, float4 b)
+{
+    return _mm_mul_ps(a.v, b.v);
+}
+inline float4 operator/(float4 a, float4 b)
+{
+    return _mm_div_ps(a.v, b.v);
+}
+inline float4 min(float4 a, float4 b)
+{
+    return _mm_min_ps(a.v, b.v);
+}
+inline float4 max(float4 a, float4 b)
+{
+    return _mm_max_ps(a.v, b.v);
+}
+inline float4 sqrt(float4 a)
+{
+    return _mm_sqrt_ps(a.v);
+}
+// Comparisons give a mask with all bits set in the lanes where the comparison holds
+inline float4 operator<(float4 a, float4 b)
+{
+    return _mm_cmplt_ps(a.v, b.v);
+}
+inline float4 operator>(float4 a, float4 b)
+{
+    return _mm_cmpgt_ps(a.v, b.v);
+}
+inline float4 operator<=(float4 a, float4 b)
+{
+    return _mm_cmple_ps(a.v, b.v);
+}
+inline float4 operator>=(float4 a, float4 b)
+{
+    return _mm_cmpge_ps(a.v, b.v);
+}
+inline float4 operator&(float4 a, float4 b)
+{
+    return _mm_and_ps(a.v, b.v);
+}
+inline float4 operator|(float4 a, float4 b)
+{
+    return _mm_or_ps(a.v, b.v);
+}
+// Picks b in the lanes where mask is set, and a elsewhere
+inline float4 select(float4 mask, float4 a, float4 b)
+{
+    return _mm_or_ps(_mm_and_ps(mask.v, b.v), _mm_andnot_ps(mask.v, a.v));
+}
+// One bit per lane, lane 0 in the lowest bit
+inline int moveMask(float4 mask)
+{
+    return _mm_movemask_ps(mask.v);
+}
+inline float horizontalSum(float4 a)
+{
+    __m128 shuffled = _mm_shuffle_ps(a.v, a.v, _MM_SHUFFLE(2, 3, 0, 1));
+    __m128 sums = _mm_add_ps(a.v, shuffled);
+    shuffled = _mm_movehl_ps(shuffled, sums);
+    return _mm_cvtss_f32(_mm_add_ss(sums, shuffled));
+}
+#else
+struct float4
+{
+    float v[4];
+
+    float4() = default;
+    explicit float4(float x) : v{x, x, x, x}
+    {
+    }
+    float4(float x, float y, float z, float w) : v{x, y, z, w}
+    {
+    }
+
+    static float4 load(const float *p)
+    {
+        return float4(p[0], p[1], p[2], p[3]);
+    }
+    void store(float *p) const
+    {
+        for (int i = 0; i < 4; i++)
+            p[i] = v[i];
+    }
+};
+
+#define GLOWBOX_FLOAT4_LANEWISE(expression)                                                                            \
+    float4 result;                                                                                                     \
+    for (int i = 0; i < 4; i++)                                                                                        \
+        result.v[i] = expression;                                                                                      \
+    return result;
+
+inline unsigned int laneBits(float lane)
+{
+    unsigned int bits;
+    std::memcpy(&bits, &lane, sizeof(bits));
+    return bits;
+}
+inline float laneFromBits(unsigned int bits)
+{
+    float lane;
+    std::memcpy(&lane, &bits, sizeof(lane));
+    return lane;
+}
+inline float laneMask(bool condition)
+{
+    return laneFromBits(condition ? 0xFFFFFFFFu : 0u);
+}
+
+inline float4 operator+(float4 a, float4 b)
+{
+    GLOWBOX_FLOAT4_LANEWISE(a.v[i] + b.v[i])
+}
+inline float4 operator-(float4 a, float4 b)
+{
+    GLOWBOX_FLOAT4_LANEWISE(a.v[i] - b.v[i])
+}
+inline float4 operator*(float4 a, float4 b)
+{
+    GLOWBOX_FLOAT4_LANEWISE(a.v[i] * b.v[i])
+}
+inline float4 operator/(float4 a, float4 b)
+{
+    GLOWBOX_FLOAT4_LANEWISE(a.v[i] / b.v[i])
+}
+inline float4 min(float4 a, float4 b)
+{
+    GLOWBOX_FLOAT4_LANEWISE(a.v[i] < b.v[i] ? a.v[i] : b.v[i])
+}
+inline float4 max(float4 a, float4 b)
+{
+    GLOWBOX_FLOAT4_LANEWISE(a.v[i] > b.v[i] ? a.v[i] : b.v[i])
+}
+inline float4 sqrt(float4 a)
+{
+    GLOWBOX_FLOAT4_LANEWISE(std::sqrt(a.v[i]))
+}
+inline float4 operator<(float4 a, float4 b)
+{
+    GLOWBOX_FLOAT4_LANEWISE(laneMask(a.v[i] < b.v[i]))
+}
+inline float4 operator>(float4 a, float4 b)
+{
+    GLOWBOX_FLOAT4_LANEWISE(laneMask(a.v[i] > b.v[i]))
+}
+inline float4 operator<=(float4 a, float4 b)
+{
+    GLOWBOX_FLOAT4_LANEWISE(laneMask(a.v[i] <= b.v[i]))
+}
+inline float4 operator>=(float4 a, float4 b)
+{
+    GLOWBOX_FLOAT4_LANEWISE(laneMask(a.v[i] >= b.v[i]))
+}
+inline float4 operator&(float4 a, float4 b)
+{
+    GLOWBOX_FLOAT4_LANEWISE(laneFromBits(laneBits(a.v[i]) & laneBits(b.v[i])))
+}
+inline float4 operator|(float4 a, float4 b)
+{
+    GLOWBOX_FLOAT4_LANEWISE(laneFromBits(laneBits(a.v[i]) | laneBits(b.v[i])))
+}
+inline float4 select(float4 mask, float4 a, float4 b)
+{
+    GLOWBOX_FLOAT4_LANEWISE(laneBits(mask.v[i]) ? b.v[i] : a.v[i])
+}
+inline int moveMask(float4 mask)
+{
+    int bits = 0;
+    for (int i = 0; i < 4; i++)
+        bits |= (laneBits(mask.v[i]) >> 31) << i;
+    return bits;
+}
+inline float horizontalSum(float4 a)
+{
+    return (a.v[0] + a.v[1]) + (a.v[2] + a.v[3]);
+}
+
+#undef GLOWBOX_FLOAT4_LANEWISE
+#endif
+
+inline float4 operator+=(float4 &a, float4 b)
+{
+    return a = a + b;
+}
+inline float4 operator-=(float4 &a, float4 b)
+{
+    return a = a - b;
+}
+inline float4 operator*=(float4 &a, float4 b)
+{
+    return a = a * b;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+// Fixed size queue between exactly one producing and one consuming thread, without locks. Each side only writes its
+// own index, and the indices sit on separate cache lines so the two threads do not keep stealing each other's line.
+// Capacity has to be a power of two. push() fails instead of blocking when the queue is full.
+template <typename T, std::size_t Capacity> class SpscQueue
+{
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Capacity has to be a power of two");
+
+  public:
+    SpscQueue() = default;
+
+    // Only called from the producing thread
+    bool push(const T &item)
+    {
+        std::size_t writeIndex = tail.load(std::memory_order_relaxed);
+        if (writeIndex - head.load(std::memory_order_acquire) == Capacity)
+        {
+            return false;
+        }
+        items[writeIndex & (Capacity - 1)] = item;
+        tail.store(writeIndex + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Only called from the consuming thread
+    bool pop(T &item)
+    {
+        std::size_t readIndex = head.load(std::memory_order_relaxed);
+        if (readIndex == tail.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+        item = items[readIndex & (Capacity - 1)];
+        head.store(readIndex + 1, std::memory_order_release);
+        return true;
+    }
+
+  private:
+    SpscQueue(SpscQueue const &) = delete;
+    SpscQueue &operator=(SpscQueue const &) = delete;
+
+    // Both only ever grow, and wrap around together with size_t
+    alignas(64) std::atomic<std::size_t> head{0};
+    alignas(64) std::atomic<std::size_t> tail{0};
+    alignas(64) T items[Capacity];
+};
@@ -0,0 +1,317 @@
+#include "textRenderer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <glm/gtc/type_ptr.hpp>
+#include <limits>
+
+static const unsigned int glyphCount = 128;
+static const unsigned int atlasColumns = 16;
+
+// The distance field is computed on the glyphs upsampled by this factor, and stored at half that resolution
+static const int supersampling = 4;
+static const int atlasScale = 2;
+// Distance field padding around each glyph, in atlas texels. This is also the largest distance that is stored.
+static const int atlasPadding = 6;
+
+// Limited by the 16 bit indices
+static const unsigned int maxQuadsPerFrame = 16384;
+static const unsigned int maxLayoutCacheSize = 1024;
+
+// One dimensional squared Euclidean distance transform, from "Distance Transforms of Sampled Functions" by
+// Felzenszwalb and Huttenlocher
+static void distanceTransform(const float *input, float *output, int count, int *parabolas, float *boundaries)
+{
+    const float infinity = std::numeric_limits<float>::max();
+    int k = 0;
+    parabolas[0] = 0;
+    boundaries[0] = -infinity;
+    boundaries[1] = infinity;
+
+    for (int q = 1; q < count; q++)
+    {
+        float s;
+        while (true)
+        {
+            int p = parabolas[k];
+            s = ((input[q] + q * q) - (input[p] + p * p)) / (2.0f * (q - p));
+            if (s > boundaries[k])
+            {
+                break;
+            }
+            k--;
+        }
+        k++;
+        parabolas[k] = q;
+        boundaries[k] = s;
+        boundaries[k + 1] = infinity;
+    }
+
+    k = 0;
+    for (int q = 0; q < count; q++)
+    {
+        while (boundaries[k + 1] < q)
+        {
+            k++;
+        }
+        float offset = float(q - parabolas[k]);
+        output[q] = offset * offset + input[parabolas[k]];
+    }
+}
+
+// Squared distance from every pixel to the nearest pixel where features is true
+static std::vector<float> distanceTransform(const std::vector<bool> &features, int width, int height)
+{
+    // Large enough to act as infinity, small enough to not overflow when squared distances are added to it
+    const float far = 1e20f;
+
+    std::vector<float> distances(width * height);
+    for (int i = 0; i < width * height; i++)
+    {
+        distances[i] = features[i] ? 0.0f : far;
+    }
+
+    int longest = std::max(width, height);
+    std::vector<float> input(longest), output(longest), boundaries(longest + 1);
+    std::vector<int> parabolas(longest);
+
+    for (int x = 0; x < width; x++)
+    {
+        for (int y = 0; y < height; y++)
+            input[y] = distances[y * width + x];
+        distanceTransform(input.data(), output.data(), height, parabolas.data(), boundaries.data());
+        for (int y = 0; y < height; y++)
+            distances[y * width + x] = output[y];
+    }
+    for (int y = 0; y < height; y++)
+    {
+        distanceTransform(&distances[y * width], output.data(), width, parabolas.data(), boundaries.data());
+        std::copy(output.begin(), output.begin() + width, distances.begin() + y * width);
+    }
+    return distances;
+}
+
+void TextRenderer::createAtlas(const PNGImage &charmap)
+{
+    const int glyphWidth = charmap.width / glyphCount;
+    const int glyphHeight = charmap.height;
+    glyphAspect = float(glyphWidth) / float(glyphHeight);
+
+    const int cellWidth = glyphWidth * atlasScale + 2 * atlasPadding;
+    const int cellHeight = glyphHeight * atlasScale + 2 * atlasPadding;
+    const int atlasWidth = cellWidth * atlasColumns;
+    const int atlasHeight = cellHeight * (glyphCount / atlasColumns);
+
+    const int detail = supersampling / atlasScale;
+    const int sampleWidth = cellWidth * detail;
+    const int sampleHeight = cellHeight * detail;
+    const int samplePadding = atlasPadding * detail;
+
+    std::vector<unsigned char> atlas(atlasWidth * atlasHeight, 0);
+    std::vector<bool> inside(sampleWidth * sampleHeight);
+    std::vector<bool> outside(sampleWidth * sampleHeight);
+
+    auto coverage = [&](int glyph, int x, int y) {
+        if (x < 0 || y < 0 || x >= glyphWidth || y >= glyphHeight)
+        {
+            return 0.0f;
+        }
+        return charmap.pixels[4 * (y * charmap.width + glyph * glyphWidth + x) + 3] / 255.0f;
+    };
+
+    for (unsigned int glyph = 0; glyph < glyphCount; glyph++)
+    {
+        // Threshold a bilinear upsampling of the glyph's alpha channel
+        for (int y = 0; y < sampleHeight; y++)
+        {
+            for (int x = 0; x < sampleWidth; x++)
+            {
+                float sourceX = (x - samplePadding + 0.5f) / supersampling - 0.5f;
+                float sourceY = (y - samplePadding + 0.5f) / supersampling - 0.5f;
+                int x0 = int(std::floor(sourceX));
+                int y0 = int(std::floor(sourceY));
+                float fx = sourceX - x0;
+                float fy = sourceY - y0;
+                float alpha = (1 - fy) * ((1 - fx) * coverage(glyph, x0, y0) + fx * coverage(glyph, x0 + 1, y0)) +
+                              fy * ((1 - fx) * coverage(glyph, x0, y0 + 1) + fx * coverage(glyph, x0 + 1, y0 + 1));
+
+                inside[y * sampleWidth + x] = alpha > 0.5f;
+                outside[y * sampleWidth + x] = alpha <= 0.5f;
+            }
+        }
+
+        std::vector<float> toInside = distanceTransform(inside, sampleWidth, sampleHeight);
+        std::vector<float> toOutside = distanceTransform(outside, sampleWidth, sampleHeight);
+
+        // Signed distance in atlas texels, negative inside the glyph. Stored so that the edge ends up at 0.5, with
+        // larger values inside.
+        int cellX = (glyph % atlasColumns) * cellWidth;
+        int cellY = (glyph / atlasColumns) * cellHeight;
+        for (int y = 0; y < cellHeight; y++)
+        {
+            for (int x = 0; x < cellWidth; x++)
+            {
+                int sample = (y * detail + detail / 2) * sampleWidth + x * detail + detail / 2;
+                float distance = (std::sqrt(toInside[sample]) - std::sqrt(toOutside[sample])) / detail;
+                float value = 0.5f - 0.5f * distance / atlasPadding;
+                atlas[(cellY + y) * atlasWidth + cellX + x] =
+                    (unsigned char)(std::min(std::max(value, 0.0f), 1.0f) * 255.0f + 0.5f);
+            }
+        }
+    }
+
+    atlasTexture = GLTexture("text atlas", GPU_HERE);
+    glBindTexture(GL_TEXTURE_2D, atlasTexture.id());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, atlasWidth, atlasHeight, 0, GL_RED, GL_UNSIGNED_BYTE, atlas.data());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    atlasTexture.setBytes(textureBytes(atlasWidth, atlasHeight, 1, false));
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    atlasCellSize = glm::vec2(float(cellWidth) / atlasWidth, float(cellHeight) / atlasHeight);
+    glyphPadding = glm::vec2(float(atlasPadding) / (glyphWidth * atlasScale),
+                             float(atlasPadding) / (glyphHeight * atlasScale));
+}
+
+TextRenderer::~TextRenderer()
+{
+    delete shader;
+}
+
+void TextRenderer::init(const PNGImage &charmap, GpuRingBuffer &uploadBuffer)
+{
+    createAtlas(charmap);
+    uploads = &uploadBuffer;
+
+    shader = new Gloom::Shader(GPU_HERE);
+    shader->makeBasicShader("../res/shaders/text.vert", "../res/shaders/text.frag");
+
+    vertexArray = GLVertexArray("text", GPU_HERE);
+    glBindVertexArray(vertexArray.id());
+
+    // The attributes point at the start of the upload buffer, and each frame's vertices are found with a base vertex
+    glBindBuffer(GL_ARRAY_BUFFER, uploads->bufferID());
+
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(TextVertex), (void *)offsetof(TextVertex, x));
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(TextVertex), (void *)offsetof(TextVertex, u));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(TextVertex), (void *)offsetof(TextVertex, color));
+    glEnableVertexAttribArray(2);
+
+    // Every quad uses the same index pattern, so the indices never change
+    std::vector<GLushort> indices(maxQuadsPerFrame * 6);
+    for (unsigned int quad = 0; quad < maxQuadsPerFrame; quad++)
+    {
+        const GLushort pattern[6] = {0, 1, 2, 0, 2, 3};
+        for (unsigned int i = 0; i < 6; i++)
+        {
+            indices[quad * 6 + i] = GLushort(quad * 4 + pattern[i]);
+        }
+    }
+    indexBuffer = GLBuffer("text quad indices", GPU_HERE);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer.id());
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLushort), indices.data(), GL_STATIC_DRAW);
+    indexBuffer.setBytes(indices.size() * sizeof(GLushort));
+
+    glBindVertexArray(0);
+}
+
+const TextRenderer::TextLayout &TextRenderer::layout(const std::string &text)
+{
+    auto cached = layoutCache.find(text);
+    if (cached != layoutCache.end())
+    {
+        return cached->second;
+    }
+
+    TextLayout &layout = layoutCache[text];
+    layout.corners.reserve(text.length());
+    layout.textureCoordinates.reserve(text.length());
+
+    for (unsigned int i = 0; i < text.length(); i++)
+    {
+        unsigned char character = text[i];
+        if (character >= glyphCount || character == ' ')
+        {
+            continue;
+        }
+
+        float left = i * glyphAspect;
+        layout.corners.emplace_back(left - glyphPadding.x * glyphAspect, -glyphPadding.y,
+                                    left + (1 + glyphPadding.x) * glyphAspect, 1 + glyphPadding.y);
+
+        glm::vec2 cell((character % atlasColumns) * atlasCellSize.x, (character / atlasColumns) * atlasCellSize.y);
+        layout.textureCoordinates.emplace_back(cell, cell + atlasCellSize);
+    }
+    return layout;
+}
+
+float TextRenderer::textWidth(const std::string &text, float height) const
+{
+    return text.length() * glyphAspect * height;
+}
+
+void TextRenderer::addText(const std::string &text, glm::vec2 position, float height, glm::vec4 color)
+{
+    const TextLayout &textLayout = layout(text);
+    if (queuedQuads + textLayout.corners.size() > maxQuadsPerFrame)
+    {
+        return;
+    }
+
+    glm::uvec4 bytes = glm::uvec4(glm::clamp(color, 0.0f, 1.0f) * 255.0f + 0.5f);
+    uint32_t packedColor = bytes.r | (bytes.g << 8) | (bytes.b << 16) | (bytes.a << 24);
+
+    queue.push_back({&textLayout, position, height, packedColor});
+    queuedQuads += textLayout.corners.size();
+}
+
+void TextRenderer::render(const glm::mat4 &projection)
+{
+    // All text is written in one allocation, so the whole frame is a single draw call
+    GpuRingBuffer::Allocation allocation = uploads->allocate(queuedQuads * 4 * sizeof(TextVertex), sizeof(TextVertex));
+    if (allocation)
+    {
+        TextVertex *vertices = static_cast<TextVertex *>(allocation.pointer);
+        for (const QueuedText &text : queue)
+        {
+            for (std::size_t i = 0; i < text.layout->corners.size(); i++)
+            {
+                glm::vec4 corners = glm::vec4(text.position, text.position) + text.layout->corners[i] * text.height;
+                glm::vec4 uv = text.layout->textureCoordinates[i];
+
+                vertices[0] = {corners.x, corners.y, uv.x, uv.y, text.color};
+                vertices[1] = {corners.z, corners.y, uv.z, uv.y, text.color};
+                vertices[2] = {corners.z, corners.w, uv.z, uv.w, text.color};
+                vertices[3] = {corners.x, corners.w, uv.x, uv.w, text.color};
+                vertices += 4;
+            }
+        }
+
+        shader->activate();
+        glUniformMatrix4fv(shader->getUniformFromName("projection"), 1, GL_FALSE, glm::value_ptr(projection));
+        glBindTextureUnit(0, atlasTexture.id());
+        glBindVertexArray(vertexArray.id());
+
+        glDisable(GL_DEPTH_TEST);
+        glEnable(GL_BLEND);
+        glDrawElementsBaseVertex(GL_TRIANGLES, queuedQuads * 6, GL_UNSIGNED_SHORT, nullptr,
+                                 GLint(allocation.offset / sizeof(TextVertex)));
+        glDisable(GL_BLEND);
+        glEnable(GL_DEPTH_TEST);
+    }
+
+    queue.clear();
+    queuedQuads = 0;
+
+    // Layouts are only dropped between frames, as the queue points into the cache
+    if (layoutCache.size() >= maxLayoutCacheSize)
+    {
+        layoutCache.clear();
+    }
+}
\ No newline at end of file
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "gpuResource.h"
+#include "gpuRingBuffer.h"
+#include "imageLoader.hpp"
+#include "shader.hpp"
+#include <cstdint>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Draws all text queued during a frame with a single draw call. Glyphs come from a signed distance field atlas, so the
+// same texture gives sharp edges at any text size. Glyph quads are written straight into the per-frame upload buffer,
+// and the layout of each distinct string is only computed once.
+class TextRenderer
+{
+  public:
+    TextRenderer() = default;
+    ~TextRenderer();
+
+    // Builds the distance field atlas from a bitmap font with 128 equally wide glyphs in a single row, and sets up the
+    // glyph vertices. Vertices are allocated from uploads, so they live until its next endFrame().
+    void init(const PNGImage &charmap, GpuRingBuffer &uploads);
+
+    // Queues a string for this frame. position is the lower left corner and height the glyph height, both in pixels.
+    void addText(const std::string &text, glm::vec2 position, float height, glm::vec4 color = glm::vec4(1));
+    // Width in pixels of a string drawn at the given height
+    float textWidth(const std::string &text, float height) const;
+
+    // Draws and clears everything queued since the previous call
+    void render(const glm::mat4 &projection);
+
+  private:
+    TextRenderer(TextRenderer const &) = delete;
+    TextRenderer &operator=(TextRenderer const &) = delete;
+
+    struct TextVertex
+    {
+        float x, y;
+        float u, v;
+        uint32_t color;
+    };
+
+    // Glyph quads of a string laid out at unit height, with the origin in the lower left corner
+    struct TextLayout
+    {
+        std::vector<glm::vec4> corners;
+        std::vector<glm::vec4> textureCoordinates;
+    };
+
+    struct QueuedText
+    {
+        const TextLayout *layout;
+        glm::vec2 position;
+        float height;
+        uint32_t color;
+    };
+
+    const TextLayout &layout(const std::string &text);
+    void createAtlas(const PNGImage &charmap);
+
+    Gloom::Shader *shader = nullptr;
+    GLTexture atlasTexture;
+    GLVertexArray vertexArray;
+    GLBuffer indexBuffer;
+
+    float glyphAspect = 1;
+    // Size of the distance field padding around each glyph, relative to the glyph
+    glm::vec2 glyphPadding;
+    glm::vec2 atlasCellSize;
+
+    std::unordered_map<std::string, TextLayout> layoutCache;
+
+    GpuRingBuffer *uploads = nullptr;
+    std::vector<QueuedText> queue;
+    unsigned int queuedQuads = 0;
+};
@@ -0,0 +1,109 @@
+#include "threadPool.h"
+#include <algorithm>
+
+unsigned int ThreadPool::defaultWorkerCount()
+{
+    unsigned int cores = std::thread::hardware_concurrency();
+    return cores > 1 ? cores - 1 : 0;
+}
+
+ThreadPool::ThreadPool(unsigned int workerCount)
+{
+    workers.reserve(workerCount);
+    for (unsigned int i = 0; i < workerCount; i++)
+    {
+        workers.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    workAvailable.notify_all();
+    for (std::thread &worker : workers)
+    {
+        worker.join();
+    }
+}
+
+void ThreadPool::runIterations(const std::function<void(std::size_t)> &task, std::size_t count)
+{
+    while (true)
+    {
+        std::size_t i = nextIteration.fetch_add(1);
+        if (i >= count)
+        {
+            return;
+        }
+        task(i);
+    }
+}
+
+void ThreadPool::workerLoop()
+{
+    std::size_t lastJob = 0;
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true)
+    {
+        workAvailable.wait(lock, [&] { return stopping || jobGeneration != lastJob; });
+        if (stopping)
+        {
+            return;
+        }
+        lastJob = jobGeneration;
+        busyWorkers++;
+        const std::function<void(std::size_t)> *task = currentTask;
+        std::size_t count = iterationCount;
+
+        lock.unlock();
+        // A worker that wakes after the job has finished finds every iteration handed out, and never calls the task
+        if (task != nullptr)
+        {
+            runIterations(*task, count);
+        }
+        lock.lock();
+
+        busyWorkers--;
+        if (busyWorkers == 0)
+        {
+            workDone.notify_all();
+        }
+    }
+}
+
+void ThreadPool::parallelFor(std::size_t count, const std::function<void(std::size_t)> &task)
+{
+    if (count == 0)
+    {
+        return;
+    }
+    if (workers.empty() || count == 1)
+    {
+        for (std::size_t i = 0; i < count; i++)
+        {
+            task(i);
+        }
+        return;
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        // A worker that woke up late for the previous job may still be looking at its iteration counter
+        workDone.wait(lock, [&] { return busyWorkers == 0; });
+        currentTask = &task;
+        iterationCount = count;
+        nextIteration = 0;
+        jobGeneration++;
+    }
+    workAvailable.notify_all();
+
+    runIterations(task, count);
+
+    // Every iteration has been handed out, but workers may still be running theirs
+    std::unique_lock<std::mutex> lock(mutex);
+    workDone.wait(lock, [&] { return busyWorkers == 0; });
+    currentTask = nullptr;
+}
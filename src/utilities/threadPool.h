@@ -0,0 +1,52 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads for splitting a loop over many cores. parallelFor() blocks until every iteration has
+// run, and the calling thread works on iterations too, so a pool without workers simply runs the loop serially.
+class ThreadPool
+{
+  public:
+    // By default one worker per core, minus the calling thread
+    explicit ThreadPool(unsigned int workerCount = defaultWorkerCount());
+    ~ThreadPool();
+
+    // Runs task(i) for every i in [0, count). Iterations are handed out one at a time, so they may run in any order.
+    void parallelFor(std::size_t count, const std::function<void(std::size_t)> &task);
+
+    unsigned int threadCount() const
+    {
+        return unsigned(workers.size()) + 1;
+    }
+
+    static unsigned int defaultWorkerCount();
+
+  private:
+    ThreadPool(ThreadPool const &) = delete;
+    ThreadPool &operator=(ThreadPool const &) = delete;
+
+    void workerLoop();
+    void runIterations(const std::function<void(std::size_t)> &task, std::size_t count);
+
+    std::vector<std::thread> workers;
+
+    std::mutex mutex;
+    std::condition_variable workAvailable;
+    std::condition_variable workDone;
+    bool stopping = false;
+    // Incremented for every parallelFor(), so workers can tell a new job from the one they just finished
+    std::size_t jobGeneration = 0;
+    unsigned int busyWorkers = 0;
+
+    // Only written while no worker is busy, and workers copy them under the mutex before they start claiming
+    // iterations, so a worker that wakes late can never claim iterations of the next job with the previous task
+    const std::function<void(std::size_t)> *currentTask = nullptr;
+    std::size_t iterationCount = 0;
+    std::atomic<std::size_t> nextIteration{0};
+};
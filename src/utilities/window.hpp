@@ -3,6 +3,9 @@
 // System Headers
 #include <glad/glad.h>
 
+// Local headers
+#include "framePacer.h"
+
 // Standard headers
 #include <string>
 
@@ -11,10 +14,27 @@ const int windowWidth = 1366;
 const int windowHeight = 768;
 const std::string windowTitle = "Glowbox";
 const GLint windowResizable = GL_FALSE;
-const int windowSamples = 4;
 
 struct CommandLineOptions
 {
     bool enableMusic;
     bool enableAutoplay;
+    std::string beatmapFile;
+    std::string trackFile;
+    bool generateBeatmap;
+    int audioLatencyMs;
+    bool calibrate;
+    bool analyticShadows;
+    bool deferredShading;
+    std::string sceneFile;
+    std::string modelFile;
+    int ballCount;
+    std::string recordFile;
+    VsyncMode vsyncMode;
+    // Frames per second, 0 for no limit
+    int frameRateLimit;
+    // GPU time per frame the scene resolution is adjusted to, 0 to always render at the window size
+    int gpuBudgetMs;
+    // Name of the anti-aliasing mode to start in, checked with parseAntiAliasingMode()
+    std::string antiAliasing;
 };
\ No newline at end of file